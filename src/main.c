@@ -32,11 +32,22 @@
 #include <errno.h>
 #endif
 
+#include <signal.h>
+
+#include <glib-unix.h>
 #include <gtk/gtk.h>
 
 #include "xvd_data_types.h"
+#include "xvd_dbus.h"
+#include "xvd_instance.h"
 #include "xvd_keys.h"
 #include "xvd_pulse.h"
+#include "xvd_record.h"
+#include "xvd_stats.h"
+#include "xvd_trace.h"
+#include "xvd_watchdog.h"
+#include "xvd_window.h"
+#include "xvd_work.h"
 #include "xvd_xfconf.h"
 
 #ifdef HAVE_LIBNOTIFY
@@ -45,13 +56,31 @@
 
 
 static XvdInstance *Inst = NULL;
+static gboolean     started = FALSE;
+static gint         exit_status = EXIT_SUCCESS;
 
 static gboolean opt_version = FALSE;
 static gboolean opt_no_daemon = FALSE;
+static gboolean opt_stats = FALSE;
+static gint     opt_stall_threshold = 0;
+static gboolean opt_pa_thread = FALSE;
+static gint     opt_count_wakeups = 0;
+static gboolean opt_replace = FALSE;
+static gchar   *opt_record = NULL;
+static gchar   *opt_replay = NULL;
+static gboolean opt_replay_realtime = FALSE;
 static GOptionEntry option_entries[] =
 {
     { "version", 'v', 0, G_OPTION_ARG_NONE, &opt_version, "Version information", NULL },
     { "no-daemon", 0, 0, G_OPTION_ARG_NONE, &opt_no_daemon, "Do not fork to the background", NULL },
+    { "stats", 0, 0, G_OPTION_ARG_NONE, &opt_stats, "Print the statistics of the running instance", NULL },
+    { "stall-threshold", 0, 0, G_OPTION_ARG_INT, &opt_stall_threshold, "Report main loop stalls longer than MS milliseconds", "MS" },
+    { "replace", 0, 0, G_OPTION_ARG_NONE, &opt_replace, "Replace the running instance", NULL },
+    { "pa-thread", 0, 0, G_OPTION_ARG_NONE, &opt_pa_thread, "Run the PulseAudio connection in a dedicated thread", NULL },
+    { "record", 0, 0, G_OPTION_ARG_FILENAME, &opt_record, "Record the PulseAudio events to FILE", "FILE" },
+    { "replay", 0, 0, G_OPTION_ARG_FILENAME, &opt_replay, "Replay the events recorded in FILE, report their cost, then quit", "FILE" },
+    { "replay-realtime", 0, 0, G_OPTION_ARG_NONE, &opt_replay_realtime, "Replay the events with their original timing", NULL },
+    { "count-wakeups", 0, 0, G_OPTION_ARG_INT, &opt_count_wakeups, "Count the main loop wakeups over S idle seconds, then quit, failing if there were any", "S" },
     { NULL }
 };
 
@@ -80,35 +109,121 @@ xvd_daemonize(void)
 #endif
 }
 
+static gboolean
+xvd_stats_signal(gpointer data)
+{
+	xvd_work_queue ((XvdInstance *) data, XVD_WORK_STATS, xvd_stats_log);
+	return G_SOURCE_CONTINUE;
+}
+
+static gboolean
+xvd_trace_signal(gpointer data)
+{
+	if (!xvd_trace_dump ())
+		g_warning ("Failed to write the trace: %s", g_strerror (errno));
+	return G_SOURCE_CONTINUE;
+}
+
 static void
 xvd_shutdown(void)
 {
-	xvd_close_pulse (Inst);
+	/* first, an instance replacing us waits for the keys */
+	if (started)
+		xvd_keys_release (Inst);
 
-	#ifdef HAVE_LIBNOTIFY
-	xvd_notify_uninit (Inst);
-	#endif
+	xvd_watchdog_stop (Inst);
+	xvd_work_cancel_all (Inst);
+	xvd_dbus_shutdown (Inst);
+
+	/* a duplicate instance never touched the server nor the state file */
+	if (started)
+	{
+		xvd_close_pulse (Inst);
+		xvd_record_stop ();
+
+		#ifdef HAVE_LIBNOTIFY
+		xvd_notify_uninit (Inst);
+		#endif
 
-	xvd_keys_release (Inst);
+		xvd_window_shutdown (Inst);
+	}
 	xvd_xfconf_shutdown (Inst);
 
 	g_free (Inst);
 }
 
+/**
+ * Brings the daemon up, from xvd_dbus_init() once we know we are alone.
+ */
 static void
-xvd_instance_init(XvdInstance *i)
+xvd_start(XvdInstance *i)
 {
-	i->pa_main_loop = NULL;
-	i->pulse_context = NULL;
-	i->sink_index = -1;
-	i->source_index = -1;
-	i->settings = NULL;
-	i->loop = NULL;
+	started = TRUE;
+
+	/* Optionally record the server, or replay a recording instead of
+	   talking to it; both from the first reply on */
+	if ((opt_record && !xvd_record_start (opt_record))
+	    || (opt_replay && !xvd_replay_start (i, opt_replay, opt_replay_realtime)))
+	{
+		exit_status = EXIT_FAILURE;
+		g_main_loop_quit (i->loop);
+		return;
+	}
+
+	/* A replay takes no key and follows no focus */
+	if (!opt_replay)
+	{
+		/* Grab the keys */
+		xvd_keys_init (i);
+
+		/* Follow the focus for the stream keys */
+		xvd_window_init (i);
+	}
+
+	/* Pulse init */
+	i->pa_use_thread = opt_pa_thread;
+	if (!xvd_open_pulse (i))
+	{
+		g_warning ("Unable to initialize pulseaudio support, quitting");
+		exit_status = EXIT_FAILURE;
+		g_main_loop_quit (i->loop);
+		return;
+	}
+
+	xvd_xfconf_get_vol_step (i);
+	xvd_xfconf_get_vol_step_accel (i);
+	xvd_xfconf_get_vol_ramp (i);
+	xvd_xfconf_get_sink_groups (i);
+
+	/* The mute-all and push-to-talk keys are settings */
+	if (!opt_replay)
+	{
+		xvd_keys_bind_mute_all (i);
+		xvd_keys_bind_push_to_talk (i);
+	}
+
+	/* Libnotify init */
 	#ifdef HAVE_LIBNOTIFY
-	i->gauge_notifications = FALSE;
-	i->notification	= NULL;
-	i->notification_mic	= NULL;
+	xvd_notify_init (i, XVD_APPNAME);
 	#endif
+
+	/* Optionally watch for callbacks blocking the main loop */
+	if (opt_stall_threshold > 0)
+		xvd_watchdog_start (i, opt_stall_threshold);
+
+	/* Optionally check that an idle daemon never wakes up */
+	if (opt_count_wakeups > 0)
+		xvd_watchdog_count_wakeups (i, opt_count_wakeups);
+}
+
+/**
+ * A replay runs next to the real daemon, it doesn't claim the bus name.
+ */
+static gboolean
+xvd_start_idle(gpointer data)
+{
+	xvd_start ((XvdInstance *) data);
+	return G_SOURCE_REMOVE;
 }
 
 gint
@@ -145,6 +260,16 @@ main(gint argc, gchar **argv)
 		return EXIT_SUCCESS;
 	}
 
+	if (opt_record && opt_replay)
+	{
+		g_print ("%s: --record and --replay don't go together.\n", G_LOG_DOMAIN);
+		return EXIT_FAILURE;
+	}
+
+	/* query the running instance */
+	if (opt_stats)
+		return xvd_dbus_print_stats () ? EXIT_SUCCESS : EXIT_FAILURE;
+
 	Inst = g_new0 (XvdInstance, 1);
 	xvd_instance_init (Inst);
 
@@ -160,9 +285,6 @@ main(gint argc, gchar **argv)
 
         gtk_init (&argc, &argv);
 
-	/* Grab the keys */
-	xvd_keys_init (Inst);
-
 	/* Xfconf init */
 	if (!xvd_xfconf_init (Inst))
 	{
@@ -170,25 +292,32 @@ main(gint argc, gchar **argv)
 		return EXIT_FAILURE;
 	}
 
-	/* Pulse init */
-	if (!xvd_open_pulse (Inst))
-	{
-		g_warning ("Unable to initialize pulseaudio support, quitting");
-		xvd_shutdown ();
-		return EXIT_FAILURE;
-	}
+	g_set_application_name (XVD_APPNAME);
+	Inst->loop = g_main_loop_new (NULL, FALSE);
 
-	xvd_xfconf_get_vol_step (Inst);
+	/* Make sure we are alone before grabbing the keys or connecting to
+	   the server, then start from xvd_start(); also exposes the runtime
+	   counters */
+	Inst->dbus_replace = opt_replace;
+	if (opt_replay)
+		g_idle_add (xvd_start_idle, Inst);
+	else
+		xvd_dbus_init (Inst, xvd_start);
+	g_unix_signal_add (SIGUSR1, xvd_stats_signal, Inst);
 
-	/* Libnotify init and idle till ready for the main loop */
-	g_set_application_name (XVD_APPNAME);
-	#ifdef HAVE_LIBNOTIFY
-	xvd_notify_init (Inst, XVD_APPNAME);
-	#endif
+	/* Keep a trace of the recent events, dumped on SIGUSR2 or a crash */
+	xvd_trace_init ();
+	g_unix_signal_add (SIGUSR2, xvd_trace_signal, Inst);
 
-	Inst->loop = g_main_loop_new (NULL, FALSE);
 	g_main_loop_run (Inst->loop);
 
 	xvd_shutdown ();
-	return 0;
+	if (opt_count_wakeups > 0 && xvd_watchdog_get_wakeups () < 0)
+	{
+		g_warning ("The wakeups were never counted");
+		return EXIT_FAILURE;
+	}
+	if (opt_count_wakeups > 0 && xvd_watchdog_get_wakeups () != 0)
+		return EXIT_FAILURE;
+	return exit_status;
 }
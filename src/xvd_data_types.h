@@ -26,16 +26,40 @@
 #include <xfconf/xfconf.h>
 
 #include <pulse/glib-mainloop.h>
+#include <pulse/thread-mainloop.h>
 #include <pulse/context.h>
+#include <pulse/operation.h>
 #include <pulse/volume.h>
 
 #ifdef HAVE_LIBNOTIFY
+#include <gio/gio.h>
 #include <libnotify/notification.h>
 #endif
 
 #define XFCONF_VOLUMED_PULSE_CHANNEL_NAME "xfce4-volumed-pulse"
 #define XFCONF_MIXER_VOL_STEP_PROP "/volume-step-size"
 #define VOL_STEP_DEFAULT_VAL 5
+#define XFCONF_VOL_STEP_ACCEL_PROP "/volume-step-acceleration"
+#define VOL_STEP_ACCEL_DEFAULT_VAL 4
+#define XFCONF_VOL_STEP_ACCEL_DELAY_PROP "/volume-step-acceleration-delay"
+#define VOL_STEP_ACCEL_DELAY_DEFAULT_VAL 500
+#define XFCONF_VOL_STEP_ACCEL_RAMP_PROP "/volume-step-acceleration-ramp"
+#define VOL_STEP_ACCEL_RAMP_DEFAULT_VAL 1500
+#define XFCONF_VOL_RAMP_DURATION_PROP "/volume-ramp-duration"
+#define VOL_RAMP_DURATION_DEFAULT_VAL 0
+#define XFCONF_SHOW_LEVEL_METER_PROP "/show-level-meter"
+#define XFCONF_HOTPLUG_POLICY_PROP "/hotplug-policy"
+#define HOTPLUG_POLICY_NONE 0
+#define HOTPLUG_POLICY_PREFER_USB 1
+#define HOTPLUG_POLICY_PREFER_NEW 2
+#define XFCONF_SINK_GROUPS_PROP "/sink-groups"
+#define XFCONF_MUTE_ALL_SOURCES_PROP "/mute-all-sources"
+#define XFCONF_MUTE_ALL_KEY_PROP "/mute-all-key"
+#define XFCONF_PUSH_TO_TALK_KEY_PROP "/push-to-talk-key"
+#define XFCONF_FULLSCREEN_NOTIFICATIONS_PROP "/fullscreen-notifications"
+#define FULLSCREEN_NOTIFICATIONS_ALL 0
+#define FULLSCREEN_NOTIFICATIONS_MUTE 1
+#define FULLSCREEN_NOTIFICATIONS_NONE 2
 #define XFCONF_ICON_STYLE_PROP "/icon-style"
 #define ICONS_STYLE_NORMAL 0
 #define ICONS_STYLE_SYMBOLIC 1
@@ -50,6 +74,7 @@
 #define ICON_AUDIO_VOLUME_HIGH		"audio-volume-high"
 #define ICON_MICROPHONE_MUTED		"microphone-sensitivity-muted"
 #define ICON_MICROPHONE_HIGH		"microphone-sensitivity-high"
+#define ICON_AUDIO_CARD				"audio-card"
 
 typedef enum _XvdVolStepDirection
 {
@@ -57,31 +82,191 @@ typedef enum _XvdVolStepDirection
   XVD_DOWN
 } XvdVolStepDirection;
 
+/* Flavours of the volume notification */
+typedef enum _XvdVolumeOsd
+{
+  XVD_OSD_VOLUME,
+  XVD_OSD_OVERSHOOT,
+  XVD_OSD_UNDERSHOOT
+} XvdVolumeOsd;
+
+/* Commands posted by the key handlers to the PulseAudio thread */
+typedef enum _XvdCommand
+{
+  XVD_CMD_SET_VOLUME, /* absolute volume in percent, plus one (runs first) */
+  XVD_CMD_VOLUME,   /* volume delta, in percent */
+  XVD_CMD_MUTE,     /* number of sink mute toggles */
+  XVD_CMD_MIC_MUTE, /* number of source mute toggles */
+  XVD_CMD_STREAM_VOLUME, /* volume delta of the current stream, in percent */
+  XVD_CMD_METER,    /* level meter wanted (1) or not (2), last one wins */
+  XVD_CMD_MUTE_ALL, /* number of sink and source mute toggles */
+  XVD_CMD_PUSH_TO_TALK, /* push-to-talk key down (1) or up (2), last one wins */
+  XVD_CMD_N
+} XvdCommand;
+
+/* What the notifications show, copied from the PA state */
+typedef struct {
+	pa_cvolume   volume;
+	int          mute;
+	int          mic_mute;
+	XvdVolumeOsd kind;
+	gint         level;       /* sink peak in percent, -1 without meter */
+	pa_cvolume   stream_volume;
+	gchar        stream_name[64];
+	gchar        device_name[128];
+} XvdOsdState;
+
+#ifdef HAVE_LIBNOTIFY
+/* A notification, and what it last showed while it may still be on screen */
+typedef struct {
+	NotifyNotification *notification;
+	gchar              *title;
+	gchar              *icon;
+	gint                value;
+	gint64              until;      /* monotonic time, 0 once closed */
+} XvdPopup;
+#endif
+
+/* Kinds of write operations sent to PulseAudio */
+typedef enum _XvdOpType
+{
+  XVD_OP_SINK_VOLUME,
+  XVD_OP_SINK_MUTE,
+  XVD_OP_SOURCE_MUTE,
+  XVD_OP_STREAM_VOLUME,
+  XVD_OP_N
+} XvdOpType;
+
+/* Facilities of the subscription events we account for */
+typedef enum _XvdFacility
+{
+  XVD_FACILITY_SINK,
+  XVD_FACILITY_SOURCE,
+  XVD_FACILITY_SERVER,
+  XVD_FACILITY_SINK_INPUT,
+  XVD_FACILITY_CARD,
+  XVD_FACILITY_OTHER,
+  XVD_FACILITY_N
+} XvdFacility;
+
+/* A write operation in flight for one target */
+typedef struct {
+	gpointer      op;	/* a pa_operation, or a XvdReplayOp in a replay */
+	gboolean      superseded;
+} XvdPendingOp;
+
+/* Runtime counters, see xvd_stats.h */
+typedef struct {
+	guint64 ops_issued[XVD_OP_N];
+	guint64 ops_failed[XVD_OP_N];
+	guint64 events[XVD_FACILITY_N];
+	guint64 introspections;
+	guint64 notifications_sent;
+	guint64 notifications_failed;
+	guint64 notifications_fullscreen;
+	guint64 notifications_saved;
+	guint64 reconnects;
+	gint64  disconnected_time;
+	gint64  disconnected_since;
+	gint    stalls; /* updated by the watchdog thread */
+	gint64  connect_started;
+	gint64  connect_latency;
+} XvdStats;
+
 typedef struct {
 	/* PA data */
+	gboolean          pa_use_thread;
+	gboolean          pa_replay;
+	gboolean          pa_replay_ready;
 	pa_glib_mainloop *pa_main_loop;
+	pa_threaded_mainloop *pa_threaded_loop;
+	pa_mainloop_api  *pa_api;
+	pa_io_event      *pa_command_event;
+	gint              pa_command_pipe[2];
+	gint              pa_commands[XVD_CMD_N];
 	pa_context       *pulse_context;
+	XvdPendingOp      pending[XVD_OP_N];
 	guint32           sink_index;
 	guint32           source_index;
 	pa_cvolume        volume;
 	int               mute;
 	int               mic_mute;
 	guint             reconnect_id;
+	pa_time_event    *ramp_event;
+	pa_cvolume        ramp_from;
+	pa_cvolume        ramp_to;
+	pa_usec_t         ramp_start;
+	GHashTable       *streams;
+	guint32           stream_index;
+	pa_cvolume        stream_volume;
+	gchar             stream_name[64];
+	gchar            *sink_monitor;
+	GHashTable       *cards;
+	GHashTable       *sinks;
+	gchar             device_name[128];
+	guint             group_acks;
+	gboolean          group_notify;
+	guint             mute_all_acks;
+	gboolean          mute_all_failed;
+	gboolean          ptt_active;
+	gchar             sink_name[128];
+	gboolean          state_cached;
+	gint              early_volume;
+	guint             early_mute;
+	gint64            early_time;
+	gboolean          had_sink;
+	gboolean          sink_list_pending;
+	gboolean          source_list_pending;
 
 	/* Xfconf vars */
 	XfconfChannel       *settings;
 	guint               icon_style;
 	guint				vol_step;
+	guint				vol_step_accel;
+	guint				vol_step_accel_delay;
+	guint				vol_step_accel_ramp;
+	guint				vol_ramp_duration;
+	gboolean			show_level_meter;
+	guint				hotplug_policy;
+	GPtrArray			*sink_groups;
+	gboolean			mute_all_sources;
+	guint				fullscreen_notifications;
 
   #ifdef HAVE_LIBNOTIFY
     /* Libnotify vars */
 	gboolean			gauge_notifications;
-	NotifyNotification* notification;
-	NotifyNotification* notification_mic;
+	gboolean			notify_caps_known;
+	guint				notify_watch_id;
+	GCancellable		*notify_caps_cancellable;
+	XvdVolumeOsd		volume_osd;
+	XvdOsdState			osd;
+	XvdPopup			popup;
+	XvdPopup			popup_mic;
+	XvdPopup			popup_device;
+	XvdPopup			popup_mute_all;
+	gboolean			notified_mute;
+	pa_stream			*meter_stream;
+	gint				meter_level;
+	gint				meter_peak;			/* since meter_update_time */
+	gint64				meter_update_time;
+	guint				meter_timeout_id;
 	#endif
 
+	/* D-Bus vars */
+	guint				dbus_owner_id;
+	guint				dbus_object_id;
+	gboolean			dbus_name_owned;
+	gboolean			dbus_replace;
+	guint				dbus_regrab_id;
+	guint				dbus_regrab_tries;
+
+	/* X vars */
+	gint				focused_pid;
+	gint				focused_fullscreen;
+
 	/* Other Xvd vars */
 	GMainLoop			*loop;
+	XvdStats			stats;
 } XvdInstance;
 
 #endif
@@ -0,0 +1,329 @@
+/*
+ *  xfce4-volumed-pulse - Volume management daemon for XFCE 4 (Pulseaudio variant)
+ *
+ *  Copyright © 2026 The Xfce Development Team
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <gio/gio.h>
+
+#include "xvd_dbus.h"
+#include "xvd_keys.h"
+#include "xvd_pulse.h"
+#include "xvd_stats.h"
+#include "xvd_watchdog.h"
+
+
+static const gchar xvd_dbus_introspection_xml[] =
+  "<node>"
+  "  <interface name='" XVD_DBUS_INTERFACE "'>"
+  "    <method name='SetVolume'>"
+  "      <arg name='percent' type='u' direction='in'/>"
+  "    </method>"
+  "    <method name='StepStreamVolume'>"
+  "      <arg name='percent' type='i' direction='in'/>"
+  "    </method>"
+  "    <property name='Stats' type='a{st}' access='read'/>"
+  "  </interface>"
+  "</node>";
+
+/* after a --replace, the previous instance gets this long (in ms) to
+   release the keys, this many times */
+#define XVD_DBUS_REGRAB_DELAY 250
+#define XVD_DBUS_REGRAB_TRIES 8
+
+static GDBusNodeInfo    *xvd_dbus_node_info = NULL;
+static XvdDbusStartFunc  xvd_dbus_start_func = NULL;
+static GDBusConnection  *xvd_dbus_connection = NULL;
+
+
+static void
+xvd_dbus_method_call (GDBusConnection       *connection,
+                      const gchar           *sender,
+                      const gchar           *object_path,
+                      const gchar           *interface_name,
+                      const gchar           *method_name,
+                      GVariant              *parameters,
+                      GDBusMethodInvocation *invocation,
+                      gpointer               userdata)
+{
+  XvdInstance *i = (XvdInstance *) userdata;
+
+  XVD_DISPATCH_TAG ();
+
+  if (g_strcmp0 (method_name, "SetVolume") == 0)
+    {
+      guint percent;
+
+      g_variant_get (parameters, "(u)", &percent);
+      xvd_set_volume (i, percent);
+      g_dbus_method_invocation_return_value (invocation, NULL);
+      return;
+    }
+
+  if (g_strcmp0 (method_name, "StepStreamVolume") == 0)
+    {
+      gint percent;
+
+      g_variant_get (parameters, "(i)", &percent);
+      if (percent >= 0)
+        xvd_update_stream_volume (i, XVD_UP, MIN (percent, 100));
+      else
+        xvd_update_stream_volume (i, XVD_DOWN, MIN (-percent, 100));
+      g_dbus_method_invocation_return_value (invocation, NULL);
+      return;
+    }
+
+  g_dbus_method_invocation_return_error (invocation,
+                                         G_DBUS_ERROR,
+                                         G_DBUS_ERROR_UNKNOWN_METHOD,
+                                         "Unknown method %s",
+                                         method_name);
+}
+
+
+static GVariant *
+xvd_dbus_get_property (GDBusConnection *connection,
+                       const gchar     *sender,
+                       const gchar     *object_path,
+                       const gchar     *interface_name,
+                       const gchar     *property_name,
+                       GError         **error,
+                       gpointer         userdata)
+{
+  XvdInstance *i = (XvdInstance *) userdata;
+
+  if (g_strcmp0 (property_name, "Stats") == 0)
+    return xvd_stats_to_variant (i);
+
+  return NULL;
+}
+
+
+static const GDBusInterfaceVTable xvd_dbus_vtable =
+{
+  xvd_dbus_method_call,
+  xvd_dbus_get_property,
+  NULL,
+};
+
+
+static void
+xvd_dbus_bus_acquired (GDBusConnection *connection,
+                       const gchar     *name,
+                       gpointer         userdata)
+{
+  XvdInstance *i = (XvdInstance *) userdata;
+  GError      *error = NULL;
+
+  i->dbus_object_id = g_dbus_connection_register_object (connection,
+                                                         XVD_DBUS_PATH,
+                                                         xvd_dbus_node_info->interfaces[0],
+                                                         &xvd_dbus_vtable,
+                                                         i,
+                                                         NULL,
+                                                         &error);
+  if (i->dbus_object_id == 0)
+    {
+      g_warning ("xvd_dbus_bus_acquired: failed to register object: %s", error->message);
+      g_error_free (error);
+      return;
+    }
+
+  /* to unregister the object on shutdown */
+  xvd_dbus_connection = g_object_ref (connection);
+}
+
+
+static gboolean
+xvd_dbus_regrab_keys (gpointer data)
+{
+  XvdInstance *i = (XvdInstance *) data;
+
+  XVD_DISPATCH_TAG ();
+
+  if (xvd_keys_regrab (i) || ++i->dbus_regrab_tries == XVD_DBUS_REGRAB_TRIES)
+    {
+      if (i->dbus_regrab_tries == XVD_DBUS_REGRAB_TRIES)
+        g_warning ("xvd_dbus_regrab_keys: the keys are still grabbed by another client");
+      i->dbus_regrab_id = 0;
+      return G_SOURCE_REMOVE;
+    }
+
+  return G_SOURCE_CONTINUE;
+}
+
+
+/**
+ * Runs the start function, once.
+ */
+static void
+xvd_dbus_start (XvdInstance *i)
+{
+  XvdDbusStartFunc start = xvd_dbus_start_func;
+
+  xvd_dbus_start_func = NULL;
+  if (start)
+    start (i);
+}
+
+
+static void
+xvd_dbus_name_acquired (GDBusConnection *connection,
+                        const gchar     *name,
+                        gpointer         userdata)
+{
+  XvdInstance *i = (XvdInstance *) userdata;
+
+  XVD_DISPATCH_TAG ();
+
+  i->dbus_name_owned = TRUE;
+  xvd_dbus_start (i);
+
+  /* the instance we replace held the keys when we tried to grab them */
+  if (i->dbus_replace && i->dbus_regrab_id == 0)
+    i->dbus_regrab_id = g_timeout_add (XVD_DBUS_REGRAB_DELAY, xvd_dbus_regrab_keys, i);
+}
+
+
+static void
+xvd_dbus_name_lost (GDBusConnection *connection,
+                    const gchar     *name,
+                    gpointer         userdata)
+{
+  XvdInstance *i = (XvdInstance *) userdata;
+
+  XVD_DISPATCH_TAG ();
+
+  /* no session bus, nothing tells us about other instances */
+  if (connection == NULL)
+    {
+      i->dbus_object_id = 0;
+      g_debug ("xvd_dbus_name_lost: no session bus, can't check for another instance");
+      xvd_dbus_start (i);
+      return;
+    }
+
+  /* a second instance would double every step and every OSD */
+  if (i->dbus_name_owned)
+    g_message ("Replaced by another instance, quitting");
+  else
+    g_message ("Another instance owns %s, quitting (use --replace to take over)", name);
+
+  i->dbus_name_owned = FALSE;
+  if (i->loop)
+    g_main_loop_quit (i->loop);
+}
+
+
+void
+xvd_dbus_init (XvdInstance      *i,
+               XvdDbusStartFunc  start)
+{
+  xvd_dbus_start_func = start;
+
+  xvd_dbus_node_info = g_dbus_node_info_new_for_xml (xvd_dbus_introspection_xml, NULL);
+  g_assert (xvd_dbus_node_info);
+
+  /* asynchronous, a duplicate instance quits from xvd_dbus_name_lost() */
+  i->dbus_owner_id = g_bus_own_name (G_BUS_TYPE_SESSION,
+                                     XVD_DBUS_NAME,
+                                     G_BUS_NAME_OWNER_FLAGS_ALLOW_REPLACEMENT
+                                     | G_BUS_NAME_OWNER_FLAGS_DO_NOT_QUEUE
+                                     | (i->dbus_replace ? G_BUS_NAME_OWNER_FLAGS_REPLACE : 0),
+                                     xvd_dbus_bus_acquired,
+                                     xvd_dbus_name_acquired,
+                                     xvd_dbus_name_lost,
+                                     i,
+                                     NULL);
+}
+
+
+void
+xvd_dbus_shutdown (XvdInstance *i)
+{
+  if (i->dbus_regrab_id != 0)
+    {
+      g_source_remove (i->dbus_regrab_id);
+      i->dbus_regrab_id = 0;
+    }
+
+  /* no more calls on an instance going away, then release the name */
+  if (i->dbus_object_id != 0 && xvd_dbus_connection)
+    g_dbus_connection_unregister_object (xvd_dbus_connection, i->dbus_object_id);
+  i->dbus_object_id = 0;
+  g_clear_object (&xvd_dbus_connection);
+
+  if (i->dbus_owner_id != 0)
+    {
+      g_bus_unown_name (i->dbus_owner_id);
+      i->dbus_owner_id = 0;
+    }
+
+  if (xvd_dbus_node_info)
+    {
+      g_dbus_node_info_unref (xvd_dbus_node_info);
+      xvd_dbus_node_info = NULL;
+    }
+}
+
+
+gboolean
+xvd_dbus_print_stats (void)
+{
+  GDBusConnection *connection;
+  GError          *error = NULL;
+  GVariant        *reply;
+  GVariant        *stats;
+  gchar           *dump;
+
+  connection = g_bus_get_sync (G_BUS_TYPE_SESSION, NULL, &error);
+  if (!connection)
+    {
+      g_printerr ("Unable to connect to the session bus: %s\n", error->message);
+      g_error_free (error);
+      return FALSE;
+    }
+
+  reply = g_dbus_connection_call_sync (connection,
+                                       XVD_DBUS_NAME,
+                                       XVD_DBUS_PATH,
+                                       "org.freedesktop.DBus.Properties",
+                                       "Get",
+                                       g_variant_new ("(ss)", XVD_DBUS_INTERFACE, "Stats"),
+                                       G_VARIANT_TYPE ("(v)"),
+                                       G_DBUS_CALL_FLAGS_NONE,
+                                       -1,
+                                       NULL,
+                                       &error);
+  g_object_unref (connection);
+
+  if (!reply)
+    {
+      g_printerr ("Unable to query the running instance: %s\n", error->message);
+      g_error_free (error);
+      return FALSE;
+    }
+
+  g_variant_get (reply, "(v)", &stats);
+  dump = xvd_stats_format (stats);
+  g_print ("%s", dump);
+
+  g_free (dump);
+  g_variant_unref (stats);
+  g_variant_unref (reply);
+
+  return TRUE;
+}
@@ -0,0 +1,54 @@
+/*
+ *  xfce4-volumed-pulse - Volume management daemon for XFCE 4 (Pulseaudio variant)
+ *
+ *  Copyright © 2026 The Xfce Development Team
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _XVD_DBUS_H
+#define _XVD_DBUS_H
+
+#include "xvd_data_types.h"
+
+
+#define XVD_DBUS_NAME      "org.xfce.VolumedPulse"
+#define XVD_DBUS_PATH      "/org/xfce/VolumedPulse"
+#define XVD_DBUS_INTERFACE "org.xfce.VolumedPulse"
+
+
+/**
+ * Brings the daemon up, once it is known to be the only instance.
+ */
+typedef void (*XvdDbusStartFunc) (XvdInstance *i);
+
+/**
+ * Publishes the daemon on the session bus. @start runs once the name is
+ * ours, or if there is no session bus to check for another instance; a
+ * duplicate instance quits without running it.
+ */
+void     xvd_dbus_init        (XvdInstance      *i,
+                               XvdDbusStartFunc  start);
+
+/**
+ * Withdraws the daemon from the session bus.
+ */
+void     xvd_dbus_shutdown    (XvdInstance *i);
+
+/**
+ * Asks the running instance for its statistics and prints them.
+ */
+gboolean xvd_dbus_print_stats (void);
+
+#endif
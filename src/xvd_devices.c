@@ -0,0 +1,199 @@
+/*
+ *  xfce4-volumed-pulse - Volume management daemon for XFCE 4 (Pulseaudio variant)
+ *
+ *  Copyright © 2026 The Xfce Development Team
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "xvd_devices.h"
+
+
+static void
+xvd_port_free (gpointer data)
+{
+  XvdPort *port = (XvdPort *) data;
+
+  g_free (port->name);
+  g_free (port->description);
+  g_free (port);
+}
+
+
+static void
+xvd_card_free (gpointer data)
+{
+  XvdCard *card = (XvdCard *) data;
+
+  g_free (card->name);
+  g_free (card->bus);
+  g_free (card->active_profile);
+  g_ptr_array_unref (card->ports);
+  g_free (card);
+}
+
+
+static void
+xvd_sink_free (gpointer data)
+{
+  XvdSink *sink = (XvdSink *) data;
+
+  g_free (sink->name);
+  g_free (sink->description);
+  g_free (sink->bus);
+  g_free (sink);
+}
+
+
+GHashTable *
+xvd_devices_new_cards (void)
+{
+  return g_hash_table_new_full (g_direct_hash,
+                                g_direct_equal,
+                                NULL,
+                                xvd_card_free);
+}
+
+
+GHashTable *
+xvd_devices_new_sinks (void)
+{
+  return g_hash_table_new_full (g_direct_hash,
+                                g_direct_equal,
+                                NULL,
+                                xvd_sink_free);
+}
+
+
+/**
+ * Finds a port of @card by name.
+ */
+static XvdPort *
+xvd_card_get_port (XvdCard     *card,
+                   const gchar *name)
+{
+  guint n;
+
+  for (n = 0; n < card->ports->len; n++)
+    {
+      XvdPort *port = g_ptr_array_index (card->ports, n);
+
+      if (g_strcmp0 (port->name, name) == 0)
+        return port;
+    }
+
+  return NULL;
+}
+
+
+XvdPort *
+xvd_devices_update_card (GHashTable         *cards,
+                         const pa_card_info *info)
+{
+  XvdCard *card;
+  XvdPort *plugged = NULL;
+  gboolean known = TRUE;
+  guint32  n;
+
+  card = g_hash_table_lookup (cards, GUINT_TO_POINTER (info->index));
+  if (!card)
+    {
+      card = g_new0 (XvdCard, 1);
+      card->index = info->index;
+      card->name = g_strdup (info->name);
+      card->bus = g_strdup (pa_proplist_gets (info->proplist, PA_PROP_DEVICE_BUS));
+      card->ports = g_ptr_array_new_with_free_func (xvd_port_free);
+      g_hash_table_insert (cards, GUINT_TO_POINTER (info->index), card);
+      known = FALSE;
+    }
+
+  g_free (card->active_profile);
+  card->active_profile = g_strdup (info->active_profile ? info->active_profile->name : NULL);
+
+  for (n = 0; n < info->n_ports; n++)
+    {
+      XvdPort *port = xvd_card_get_port (card, info->ports[n]->name);
+      gboolean available = (info->ports[n]->available == PA_PORT_AVAILABLE_YES);
+
+      if (!port)
+        {
+          port = g_new0 (XvdPort, 1);
+          port->name = g_strdup (info->ports[n]->name);
+          port->description = g_strdup (info->ports[n]->description);
+          g_ptr_array_add (card->ports, port);
+        }
+      else if (known && available && !port->available)
+        plugged = port;
+
+      port->available = available;
+    }
+
+  return plugged;
+}
+
+
+XvdSink *
+xvd_devices_update_sink (GHashTable         *sinks,
+                         const pa_sink_info *info)
+{
+  XvdSink *sink;
+
+  sink = g_hash_table_lookup (sinks, GUINT_TO_POINTER (info->index));
+  if (!sink)
+    {
+      sink = g_new0 (XvdSink, 1);
+      sink->index = info->index;
+      sink->name = g_strdup (info->name);
+      sink->bus = g_strdup (pa_proplist_gets (info->proplist, PA_PROP_DEVICE_BUS));
+      g_hash_table_insert (sinks, GUINT_TO_POINTER (info->index), sink);
+    }
+
+  if (g_strcmp0 (sink->description, info->description) != 0)
+    {
+      g_free (sink->description);
+      sink->description = g_strdup (info->description);
+    }
+  sink->card = info->card;
+  sink->volume = info->volume;
+
+  return sink;
+}
+
+
+XvdSink *
+xvd_devices_find_sink (GHashTable  *sinks,
+                       const gchar *name)
+{
+  GHashTableIter iter;
+  gpointer       value;
+
+  g_hash_table_iter_init (&iter, sinks);
+  while (g_hash_table_iter_next (&iter, NULL, &value))
+    {
+      XvdSink *sink = (XvdSink *) value;
+
+      if (g_strcmp0 (sink->name, name) == 0)
+        return sink;
+    }
+
+  return NULL;
+}
+
+
+void
+xvd_devices_remove (GHashTable *devices,
+                    guint32     index)
+{
+  g_hash_table_remove (devices, GUINT_TO_POINTER (index));
+}
@@ -0,0 +1,97 @@
+/*
+ *  xfce4-volumed-pulse - Volume management daemon for XFCE 4 (Pulseaudio variant)
+ *
+ *  Copyright © 2026 The Xfce Development Team
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _XVD_DEVICES_H
+#define _XVD_DEVICES_H
+
+#include <pulse/introspect.h>
+
+#include "xvd_data_types.h"
+
+
+/**
+ * Ports of a card, as last reported.
+ */
+typedef struct {
+  gchar    *name;
+  gchar    *description;
+  gboolean  available;
+} XvdPort;
+
+/**
+ * What we know about a card, kept up to date from the subscription events
+ * so that plugging a device needs no list query.
+ */
+typedef struct {
+  guint32    index;
+  gchar     *name;
+  gchar     *bus;            /* "usb", "pci", "bluetooth"..., or NULL */
+  gchar     *active_profile;
+  GPtrArray *ports;          /* of XvdPort */
+} XvdCard;
+
+/**
+ * What we know about a sink.
+ */
+typedef struct {
+  guint32    index;
+  gchar     *name;
+  gchar     *description;
+  gchar     *bus;
+  guint32    card;
+  pa_cvolume volume;
+} XvdSink;
+
+
+/**
+ * Creates an empty table of cards, by index.
+ */
+GHashTable *xvd_devices_new_cards   (void);
+
+/**
+ * Creates an empty table of sinks, by index.
+ */
+GHashTable *xvd_devices_new_sinks   (void);
+
+/**
+ * Adds or refreshes a card from its infos. Returns the port that just
+ * became available on a known card, if any.
+ */
+XvdPort    *xvd_devices_update_card (GHashTable         *cards,
+                                     const pa_card_info *info);
+
+/**
+ * Adds or refreshes a sink from its infos.
+ */
+XvdSink    *xvd_devices_update_sink (GHashTable         *sinks,
+                                     const pa_sink_info *info);
+
+/**
+ * Finds a sink by name.
+ */
+XvdSink    *xvd_devices_find_sink   (GHashTable         *sinks,
+                                     const gchar        *name);
+
+/**
+ * Forgets a card or a sink, if known.
+ */
+void        xvd_devices_remove      (GHashTable         *devices,
+                                     guint32             index);
+
+#endif
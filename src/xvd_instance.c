@@ -0,0 +1,64 @@
+/*
+ *  xfce4-volumed-pulse - Volume management daemon for XFCE 4 (Pulseaudio variant)
+ *
+ *  Copyright © 2026 The Xfce Development Team
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+
+#include "xvd_instance.h"
+#include "xvd_stats.h"
+
+
+void
+xvd_instance_init(XvdInstance *i)
+{
+	i->pa_use_thread = FALSE;
+	i->pa_main_loop = NULL;
+	i->pa_threaded_loop = NULL;
+	i->pa_api = NULL;
+	i->pa_command_event = NULL;
+	i->pa_command_pipe[0] = i->pa_command_pipe[1] = -1;
+	i->pulse_context = NULL;
+	i->sink_index = -1;
+	i->source_index = -1;
+	i->settings = NULL;
+	i->loop = NULL;
+	i->dbus_owner_id = 0;
+	i->dbus_object_id = 0;
+	i->dbus_name_owned = FALSE;
+	i->dbus_replace = FALSE;
+	i->dbus_regrab_id = 0;
+	i->dbus_regrab_tries = 0;
+	xvd_stats_init (i);
+	#ifdef HAVE_LIBNOTIFY
+	i->gauge_notifications = FALSE;
+	i->notify_caps_known = FALSE;
+	i->notify_watch_id = 0;
+	i->notify_caps_cancellable = NULL;
+	memset (&i->popup, 0, sizeof (i->popup));
+	memset (&i->popup_mic, 0, sizeof (i->popup_mic));
+	memset (&i->popup_device, 0, sizeof (i->popup_device));
+	memset (&i->popup_mute_all, 0, sizeof (i->popup_mute_all));
+	i->notified_mute = FALSE;
+	i->meter_stream = NULL;
+	i->meter_level = -1;
+	i->meter_peak = 0;
+	i->meter_update_time = 0;
+	i->meter_timeout_id = 0;
+	i->osd.level = -1;
+	#endif
+}
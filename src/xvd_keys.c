@@ -18,21 +18,108 @@
  *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <string.h>
+
+#include <gdk/gdk.h>
+#include <gdk/gdkx.h>
+#include <X11/XF86keysym.h>
+#include <X11/XKBlib.h>
 #include <keybinder.h>
 
 #include "xvd_keys.h"
+#include "xvd_probes.h"
 #include "xvd_pulse.h"
+#include "xvd_trace.h"
+#include "xvd_watchdog.h"
+
+/* Without detectable autorepeat, a held key sends its presses one
+   autorepeat interval apart: presses closer than the interval plus this
+   slack (in ms) come from a held key, slower ones are new presses. The
+   interval is the X server default until the keyboard tells better. */
+#define XVD_KEY_REPEAT_INTERVAL 40
+#define XVD_KEY_REPEAT_SLACK    20
+
+
+/* X server times, wrapping around: unsigned differences don't mind */
+static guint32             xvd_last_press_time = 0;
+static guint32             xvd_hold_start_time = 0;
+static gboolean            xvd_holding = FALSE;
+static XvdVolStepDirection xvd_last_direction = XVD_UP;
+static guint               xvd_repeat_gap = XVD_KEY_REPEAT_INTERVAL + XVD_KEY_REPEAT_SLACK;
+
+/* with detectable autorepeat, a held key sends a single release at the
+   end: a release since the last press ends the hold */
+static gboolean            xvd_detectable_repeat = FALSE;
+static gboolean            xvd_volume_released = FALSE;
+static KeyCode             xvd_raise_keycode = 0;
+static KeyCode             xvd_lower_keycode = 0;
+
+/* the keys below come from the settings, once xvd_keys_init() ran */
+static gboolean            xvd_keys_ready = FALSE;
+
+static gchar              *xvd_mute_all_key = NULL;
+static gboolean            xvd_mute_all_grabbed = FALSE;
+
+static gchar              *xvd_ptt_key = NULL;
+static KeyCode             xvd_ptt_keycode = 0;
+static gboolean            xvd_ptt_grabbed = FALSE;
+
 
+/**
+ * Returns the volume step for a press, growing with the time the key has
+ * been held: plain vol_step until the acceleration delay, then up to
+ * vol_step_accel times that over the acceleration ramp. Without
+ * detectable autorepeat the hold counts from the first repeated press.
+ */
+static guint
+xvd_accelerated_step (XvdInstance        *Inst,
+                      XvdVolStepDirection d)
+{
+  guint32 now = keybinder_get_current_event_time ();
+  guint32 held;
+  guint   factor = 1;
+
+  /* a press without a server time can't be placed in a hold: a plain
+     step, and the next press starts a new hold */
+  if (now == 0)
+    {
+      xvd_holding = FALSE;
+      return Inst->vol_step;
+    }
+
+  if (!xvd_holding
+      || d != xvd_last_direction
+      || (xvd_detectable_repeat && xvd_volume_released)
+      || (!xvd_detectable_repeat && now - xvd_last_press_time > xvd_repeat_gap))
+    xvd_hold_start_time = now;
+  xvd_holding = TRUE;
+  xvd_last_press_time = now;
+  xvd_last_direction = d;
+  xvd_volume_released = FALSE;
+
+  held = now - xvd_hold_start_time;
+  if (Inst->vol_step_accel > 1 && held > Inst->vol_step_accel_delay)
+    {
+      factor = 1 + (Inst->vol_step_accel - 1) * (held - Inst->vol_step_accel_delay)
+                   / Inst->vol_step_accel_ramp;
+      factor = MIN (factor, Inst->vol_step_accel);
+    }
+
+  return Inst->vol_step * factor;
+}
 
 static
 void xvd_raise_handler (const char *keystring, void *Inst)
 {
   XvdInstance *xvd_inst = (XvdInstance *) Inst;
 
-  g_debug ("The RaiseVolume key was pressed.");
+  XVD_DISPATCH_TAG ();
+  XVD_TRACE (KEY_RAISE, 0, keybinder_get_current_event_time ());
+  XVD_PROBE1 (key_press, keystring);
 
   xvd_update_volume (xvd_inst,
-                     XVD_UP);
+                     XVD_UP,
+                     xvd_accelerated_step (xvd_inst, XVD_UP));
 }
 
 static
@@ -40,10 +127,41 @@ void xvd_lower_handler (const char *keystring, void *Inst)
 {
   XvdInstance *xvd_inst = (XvdInstance *) Inst;
 
-  g_debug ("The LowerVolume key was pressed.");
+  XVD_DISPATCH_TAG ();
+  XVD_TRACE (KEY_LOWER, 0, keybinder_get_current_event_time ());
+  XVD_PROBE1 (key_press, keystring);
 
   xvd_update_volume (xvd_inst,
-                     XVD_DOWN);
+                     XVD_DOWN,
+                     xvd_accelerated_step (xvd_inst, XVD_DOWN));
+}
+
+static
+void xvd_raise_stream_handler (const char *keystring, void *Inst)
+{
+  XvdInstance *xvd_inst = (XvdInstance *) Inst;
+
+  XVD_DISPATCH_TAG ();
+  XVD_TRACE (KEY_STREAM_RAISE, 0, keybinder_get_current_event_time ());
+  XVD_PROBE1 (key_press, keystring);
+
+  xvd_update_stream_volume (xvd_inst,
+                            XVD_UP,
+                            xvd_accelerated_step (xvd_inst, XVD_UP));
+}
+
+static
+void xvd_lower_stream_handler (const char *keystring, void *Inst)
+{
+  XvdInstance *xvd_inst = (XvdInstance *) Inst;
+
+  XVD_DISPATCH_TAG ();
+  XVD_TRACE (KEY_STREAM_LOWER, 0, keybinder_get_current_event_time ());
+  XVD_PROBE1 (key_press, keystring);
+
+  xvd_update_stream_volume (xvd_inst,
+                            XVD_DOWN,
+                            xvd_accelerated_step (xvd_inst, XVD_DOWN));
 }
 
 static
@@ -51,7 +169,9 @@ void xvd_mute_handler (const char *keystring, void *Inst)
 {
   XvdInstance *xvd_inst = (XvdInstance *) Inst;
 
-  g_debug ("The Mute key was pressed.");
+  XVD_DISPATCH_TAG ();
+  XVD_TRACE (KEY_MUTE, 0, keybinder_get_current_event_time ());
+  XVD_PROBE1 (key_press, keystring);
 
   xvd_toggle_mute (xvd_inst);
 }
@@ -61,18 +181,272 @@ void xvd_mic_mute_handler (const char *keystring, void *Inst)
 {
   XvdInstance *xvd_inst = (XvdInstance *) Inst;
 
-  g_debug ("The MicMute key was pressed.");
+  XVD_DISPATCH_TAG ();
+  XVD_TRACE (KEY_MIC_MUTE, 0, keybinder_get_current_event_time ());
+  XVD_PROBE1 (key_press, keystring);
 
   xvd_toggle_mic_mute (xvd_inst);
 }
 
+static
+void xvd_mute_all_handler (const char *keystring, void *Inst)
+{
+  XvdInstance *xvd_inst = (XvdInstance *) Inst;
+
+  XVD_DISPATCH_TAG ();
+  XVD_TRACE (KEY_MUTE_ALL, 0, keybinder_get_current_event_time ());
+  XVD_PROBE1 (key_press, keystring);
+
+  xvd_toggle_mute_all (xvd_inst);
+}
+
+static
+void xvd_ptt_press_handler (const char *keystring, void *Inst)
+{
+  XvdInstance *xvd_inst = (XvdInstance *) Inst;
+
+  XVD_DISPATCH_TAG ();
+  XVD_TRACE (KEY_PTT_DOWN, 0, keybinder_get_current_event_time ());
+  XVD_PROBE1 (key_press, keystring);
+
+  /* presses from autorepeat are ignored further down */
+  xvd_push_to_talk (xvd_inst, TRUE);
+}
+
+/**
+ * keybinder only reports presses. Its grab also brings the release to the
+ * root window, where it is caught here.
+ */
+static GdkFilterReturn
+xvd_ptt_filter (GdkXEvent *gdk_xevent,
+                GdkEvent  *event,
+                gpointer   userdata)
+{
+  XEvent *xevent = (XEvent *) gdk_xevent;
+
+  if (xevent->type == KeyRelease && xevent->xkey.keycode == xvd_ptt_keycode)
+    {
+      XVD_DISPATCH_TAG ();
+      XVD_TRACE (KEY_PTT_UP, 0, xevent->xkey.time);
+      XVD_PROBE1 (key_release, xvd_ptt_key);
+
+      xvd_push_to_talk ((XvdInstance *) userdata, FALSE);
+    }
+
+  return GDK_FILTER_CONTINUE;
+}
+
+/**
+ * Catches the releases of the volume keys, the grab brings them to the
+ * root window like the push-to-talk one.
+ */
+static GdkFilterReturn
+xvd_volume_filter (GdkXEvent *gdk_xevent,
+                   GdkEvent  *event,
+                   gpointer   userdata)
+{
+  XEvent *xevent = (XEvent *) gdk_xevent;
+
+  if (xevent->type == KeyRelease
+      && (xevent->xkey.keycode == xvd_raise_keycode || xevent->xkey.keycode == xvd_lower_keycode))
+    xvd_volume_released = TRUE;
+
+  return GDK_FILTER_CONTINUE;
+}
+
+/**
+ * Tells a held volume key from repeated presses: by its release when the
+ * server reports autorepeat without fake releases, by the autorepeat
+ * interval of the keyboard otherwise.
+ */
+static void
+xvd_keys_watch_repeat (XvdInstance *Inst)
+{
+  GdkDisplay *display = gdk_display_get_default ();
+  Display    *xdisplay;
+  guint       delay, interval;
+  Bool        supported = False;
+
+  if (!display || !GDK_IS_X11_DISPLAY (display))
+    return;
+  xdisplay = gdk_x11_display_get_xdisplay (display);
+
+  if (XkbGetAutoRepeatRate (xdisplay, XkbUseCoreKbd, &delay, &interval))
+    xvd_repeat_gap = interval + XVD_KEY_REPEAT_SLACK;
+
+  XkbSetDetectableAutoRepeat (xdisplay, True, &supported);
+  xvd_detectable_repeat = supported;
+  if (!xvd_detectable_repeat)
+    return;
+
+  xvd_raise_keycode = XKeysymToKeycode (xdisplay, XF86XK_AudioRaiseVolume);
+  xvd_lower_keycode = XKeysymToKeycode (xdisplay, XF86XK_AudioLowerVolume);
+  gdk_window_add_filter (gdk_get_default_root_window (), xvd_volume_filter, Inst);
+}
+
+/**
+ * Grabs the mute-all key, again if it was. Returns FALSE if another client
+ * holds it.
+ */
+static gboolean
+xvd_keys_grab_mute_all(XvdInstance *Inst)
+{
+  if (xvd_mute_all_grabbed)
+    keybinder_unbind (xvd_mute_all_key, xvd_mute_all_handler);
+
+  xvd_mute_all_grabbed = keybinder_bind (xvd_mute_all_key, xvd_mute_all_handler, Inst);
+  return xvd_mute_all_grabbed;
+}
+
+static void
+xvd_keys_unset_mute_all(void)
+{
+  if (!xvd_mute_all_key)
+    return;
+
+  if (xvd_mute_all_grabbed)
+    keybinder_unbind (xvd_mute_all_key, xvd_mute_all_handler);
+  xvd_mute_all_grabbed = FALSE;
+  g_free (xvd_mute_all_key);
+  xvd_mute_all_key = NULL;
+}
+
 void
-xvd_keys_init(XvdInstance *Inst)
+xvd_keys_bind_mute_all(XvdInstance *Inst)
 {
-    keybinder_init();
+  gchar *key;
+
+  if (!xvd_keys_ready)
+    return;
+
+  xvd_keys_unset_mute_all ();
+
+  key = xfconf_channel_get_string (Inst->settings, XFCONF_MUTE_ALL_KEY_PROP, NULL);
+  if (!key || *key == '\0')
+    {
+      g_free (key);
+      return;
+    }
+
+  /* kept even if the grab fails, xvd_keys_regrab() tries again once the
+     instance we replace lets go of it */
+  xvd_mute_all_key = key;
+
+  if (!xvd_keys_grab_mute_all (Inst))
+    g_warning ("xvd_keys_bind_mute_all: can't grab %s", key);
+}
+
+/**
+ * Grabs the push-to-talk key, again if it was. Returns FALSE if another
+ * client holds it.
+ */
+static gboolean
+xvd_keys_grab_push_to_talk(XvdInstance *Inst)
+{
+  if (xvd_ptt_grabbed)
+    keybinder_unbind (xvd_ptt_key, xvd_ptt_press_handler);
+
+  xvd_ptt_grabbed = keybinder_bind (xvd_ptt_key, xvd_ptt_press_handler, Inst);
+  return xvd_ptt_grabbed;
+}
+
+/**
+ * Lets go of the push-to-talk key, if one is bound.
+ */
+static void
+xvd_keys_unset_push_to_talk(XvdInstance *Inst)
+{
+  if (!xvd_ptt_key)
+    return;
+
+  if (xvd_ptt_grabbed)
+    keybinder_unbind (xvd_ptt_key, xvd_ptt_press_handler);
+  xvd_ptt_grabbed = FALSE;
+  gdk_window_remove_filter (gdk_get_default_root_window (), xvd_ptt_filter, Inst);
+  g_free (xvd_ptt_key);
+  xvd_ptt_key = NULL;
+  xvd_ptt_keycode = 0;
+}
+
+void
+xvd_keys_bind_push_to_talk(XvdInstance *Inst)
+{
+  gchar *key;
+
+  if (!xvd_keys_ready)
+    return;
+
+  /* the release of the old key won't be caught any more, a held one
+     ends here (nothing happens if it isn't) */
+  if (xvd_ptt_key)
+    {
+      xvd_push_to_talk (Inst, FALSE);
+      xvd_keys_unset_push_to_talk (Inst);
+    }
+
+  key = xfconf_channel_get_string (Inst->settings, XFCONF_PUSH_TO_TALK_KEY_PROP, NULL);
+  if (key && *key != '\0')
+    xvd_keys_set_push_to_talk (Inst, key);
+  g_free (key);
+}
+
+void
+xvd_keys_set_push_to_talk(XvdInstance *Inst,
+                          const gchar *accelerator)
+{
+  GdkDisplay  *display = gdk_display_get_default ();
+  Display     *xdisplay;
+  gchar       *key;
+  const gchar *name;
+  KeySym       keysym;
+
+  xvd_keys_unset_push_to_talk (Inst);
+
+  if (!display || !GDK_IS_X11_DISPLAY (display))
+    {
+      g_warning ("xvd_keys_set_push_to_talk: key releases need X11");
+      return;
+    }
+  key = g_strdup (accelerator);
+  xdisplay = gdk_x11_display_get_xdisplay (display);
 
-    keybinder_bind ("XF86AudioRaiseVolume", xvd_raise_handler, Inst);
-    keybinder_bind ("<Ctrl>XF86AudioRaiseVolume", xvd_raise_handler, Inst);
+  /* the key name comes after the modifiers */
+  name = strrchr (key, '>');
+  name = (name) ? name + 1 : key;
+  keysym = XStringToKeysym (name);
+  if (keysym != NoSymbol)
+    xvd_ptt_keycode = XKeysymToKeycode (xdisplay, keysym);
+
+  if (xvd_ptt_keycode == 0)
+    {
+      g_warning ("xvd_keys_set_push_to_talk: unknown key %s", key);
+      g_free (key);
+      return;
+    }
+
+  /* kept even if the grab fails below, xvd_keys_regrab() tries again once
+     the instance we replace lets go of it */
+  xvd_ptt_key = key;
+
+  /* a held key must not look like a stream of presses and releases */
+  XkbSetDetectableAutoRepeat (xdisplay, True, NULL);
+
+  gdk_window_add_filter (gdk_get_default_root_window (), xvd_ptt_filter, Inst);
+
+  if (!xvd_keys_grab_push_to_talk (Inst))
+    g_warning ("xvd_keys_set_push_to_talk: can't grab %s", key);
+}
+
+/**
+ * Grabs the volume keys, returns FALSE if another client holds them.
+ */
+static gboolean
+xvd_keys_bind_all(XvdInstance *Inst)
+{
+    gboolean ret;
+
+    ret = keybinder_bind ("XF86AudioRaiseVolume", xvd_raise_handler, Inst);
+    keybinder_bind ("<Ctrl>XF86AudioRaiseVolume", xvd_raise_stream_handler, Inst);
     keybinder_bind ("<Alt>XF86AudioRaiseVolume", xvd_raise_handler, Inst);
     keybinder_bind ("<Super>XF86AudioRaiseVolume", xvd_raise_handler, Inst);
     keybinder_bind ("<Shift>XF86AudioRaiseVolume", xvd_raise_handler, Inst);
@@ -90,7 +464,7 @@ xvd_keys_init(XvdInstance *Inst)
 
 
     keybinder_bind ("XF86AudioLowerVolume", xvd_lower_handler, Inst);
-    keybinder_bind ("<Ctrl>XF86AudioLowerVolume", xvd_lower_handler, Inst);
+    keybinder_bind ("<Ctrl>XF86AudioLowerVolume", xvd_lower_stream_handler, Inst);
     keybinder_bind ("<Alt>XF86AudioLowerVolume", xvd_lower_handler, Inst);
     keybinder_bind ("<Super>XF86AudioLowerVolume", xvd_lower_handler, Inst);
     keybinder_bind ("<Shift>XF86AudioLowerVolume", xvd_lower_handler, Inst);
@@ -141,14 +515,16 @@ xvd_keys_init(XvdInstance *Inst)
     keybinder_bind ("<Ctrl><Alt><Super>XF86AudioMicMute", xvd_mic_mute_handler, Inst);
     keybinder_bind ("<Shift><Alt><Super>XF86AudioMicMute", xvd_mic_mute_handler, Inst);
     keybinder_bind ("<Ctrl><Shift><Alt><Super>XF86AudioMicMute", xvd_mic_mute_handler, Inst);
+
+    return ret;
 }
 
-void
-xvd_keys_release (XvdInstance *Inst)
+static void
+xvd_keys_unbind_all(void)
 {
 
     keybinder_unbind ("XF86AudioRaiseVolume", xvd_raise_handler);
-    keybinder_unbind ("<Ctrl>XF86AudioRaiseVolume", xvd_raise_handler);
+    keybinder_unbind ("<Ctrl>XF86AudioRaiseVolume", xvd_raise_stream_handler);
     keybinder_unbind ("<Alt>XF86AudioRaiseVolume", xvd_raise_handler);
     keybinder_unbind ("<Super>XF86AudioRaiseVolume", xvd_raise_handler);
     keybinder_unbind ("<Shift>XF86AudioRaiseVolume", xvd_raise_handler);
@@ -166,7 +542,7 @@ xvd_keys_release (XvdInstance *Inst)
 
 
     keybinder_unbind ("XF86AudioLowerVolume", xvd_lower_handler);
-    keybinder_unbind ("<Ctrl>XF86AudioLowerVolume", xvd_lower_handler);
+    keybinder_unbind ("<Ctrl>XF86AudioLowerVolume", xvd_lower_stream_handler);
     keybinder_unbind ("<Alt>XF86AudioLowerVolume", xvd_lower_handler);
     keybinder_unbind ("<Super>XF86AudioLowerVolume", xvd_lower_handler);
     keybinder_unbind ("<Shift>XF86AudioLowerVolume", xvd_lower_handler);
@@ -218,3 +594,46 @@ xvd_keys_release (XvdInstance *Inst)
     keybinder_unbind ("<Shift><Alt><Super>XF86AudioMicMute", xvd_mic_mute_handler);
     keybinder_unbind ("<Ctrl><Shift><Alt><Super>XF86AudioMicMute", xvd_mic_mute_handler);
 }
+
+void
+xvd_keys_init(XvdInstance *Inst)
+{
+    keybinder_init();
+
+    xvd_keys_bind_all (Inst);
+    xvd_keys_watch_repeat (Inst);
+
+    xvd_keys_ready = TRUE;
+}
+
+gboolean
+xvd_keys_regrab(XvdInstance *Inst)
+{
+    gboolean ret;
+
+    xvd_keys_unbind_all ();
+    ret = xvd_keys_bind_all (Inst);
+
+    if (xvd_mute_all_key && !xvd_keys_grab_mute_all (Inst))
+      ret = FALSE;
+    if (xvd_ptt_key && !xvd_keys_grab_push_to_talk (Inst))
+      ret = FALSE;
+
+    return ret;
+}
+
+void
+xvd_keys_release (XvdInstance *Inst)
+{
+    xvd_keys_unbind_all ();
+    xvd_keys_unset_mute_all ();
+    xvd_keys_ready = FALSE;
+
+    if (xvd_detectable_repeat)
+      {
+        gdk_window_remove_filter (gdk_get_default_root_window (), xvd_volume_filter, Inst);
+        xvd_detectable_repeat = FALSE;
+      }
+
+    xvd_keys_unset_push_to_talk (Inst);
+}
@@ -27,6 +27,31 @@
 void 
 xvd_keys_init(XvdInstance *Inst);
 
+/**
+ * Binds the mute-all key from the settings, in place of the one bound
+ * before. Nothing is bound while the setting is empty.
+ */
+void
+xvd_keys_bind_mute_all(XvdInstance *Inst);
+
+void
+xvd_keys_bind_push_to_talk(XvdInstance *Inst);
+
+/**
+ * Binds push-to-talk to @accelerator, in place of the key bound before.
+ * xvd_keys_bind_push_to_talk() reads it from the settings.
+ */
+void
+xvd_keys_set_push_to_talk(XvdInstance *Inst,
+                          const gchar *accelerator);
+
+/**
+ * Grabs the keys again, once the instance that held them is gone.
+ * Returns FALSE if they are still taken.
+ */
+gboolean
+xvd_keys_regrab(XvdInstance *Inst);
+
 void 
 xvd_keys_release(XvdInstance *Inst);
 
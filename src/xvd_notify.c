@@ -18,20 +18,145 @@
  *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <gio/gio.h>
 #include <libnotify/notify.h>
 
+#include "xvd_probes.h"
 #include "xvd_pulse.h"
+#include "xvd_trace.h"
 #include "xvd_notify.h"
 #include "xvd_xfconf.h"
+#include "xvd_watchdog.h"
+
+
+/* Time in ms a popup is assumed to stay on screen. Servers keep one with
+   the default timeout up longer, underestimating only costs a resend. */
+#define XVD_NOTIFY_SHOWN_FOR 2000
+
+#define XVD_NOTIFY_NAME "org.freedesktop.Notifications"
+#define XVD_NOTIFY_PATH "/org/freedesktop/Notifications"
+
+/* Value of the popups without a gauge */
+#define XVD_NOTIFY_NO_GAUGE G_MININT
+
+/**
+ * Shows @popup with @title and @icon, and the gauge at @value unless it is
+ * XVD_NOTIFY_NO_GAUGE. Nothing is sent while the popup still shows that
+ * already.
+ */
+static void
+xvd_notify_show(XvdInstance *Inst,
+				XvdPopup *popup,
+				const gchar* title,
+				const gchar* icon,
+				gint value)
+{
+	GError* error						= NULL;
+	gint64  now							= g_get_monotonic_time ();
+	gint    id							= 0;
+
+	/* the ack of our own change and the server echo of it show the same
+	   state, don't send the popup on screen again */
+	if (now < popup->until
+		&& (!Inst->gauge_notifications || value == popup->value)
+		&& g_strcmp0 (icon, popup->icon) == 0
+		&& g_strcmp0 (title, popup->title) == 0) {
+		g_object_get (popup->notification, "id", &id, NULL);
+		XVD_TRACE (NOTIFY, id, -1);
+		Inst->stats.notifications_saved++;
+		return;
+	}
+
+	notify_notification_update (popup->notification,
+				title,
+				NULL,
+				icon);
+
+	/* the other hints don't change, they are set once in xvd_notify_init() */
+	if (Inst->gauge_notifications && value != XVD_NOTIFY_NO_GAUGE) {
+		notify_notification_set_hint_int32 (popup->notification,
+							"value",
+							value);
+	}
+
+	XVD_PROBE1 (notify_send, popup->notification);
+	if (!notify_notification_show (popup->notification, &error))
+	{
+		XVD_PROBE2 (notify_done, popup->notification, 0);
+		XVD_TRACE (NOTIFY, 0, 0);
+		g_warning ("Error while sending notification : %s\n", error->message);
+		g_error_free (error);
+		Inst->stats.notifications_failed++;
+		popup->until = 0;
+		return;
+	}
+
+	XVD_PROBE2 (notify_done, popup->notification, 1);
+	g_object_get (popup->notification, "id", &id, NULL);
+	XVD_TRACE (NOTIFY, id, 1);
+	Inst->stats.notifications_sent++;
+	g_free (popup->title);
+	popup->title = g_strdup (title);
+	g_free (popup->icon);
+	popup->icon = g_strdup (icon);
+	popup->value = value;
+	popup->until = now + XVD_NOTIFY_SHOWN_FOR * 1000;
+}
+
+/**
+ * Shows the volume popup, with the icon in the configured style.
+ */
+static void
+xvd_notify_show_volume(XvdInstance *Inst,
+					   const gchar* title,
+					   const gchar* icon,
+					   gint value)
+{
+	gchar*  symbolic					= NULL;
+
+	if (Inst->icon_style == ICONS_STYLE_SYMBOLIC)
+		icon = symbolic = g_strconcat (icon, "-symbolic", NULL);
+
+	xvd_notify_show (Inst, &Inst->popup, title, icon, value);
+	g_free (symbolic);
+}
+
+/**
+ * Returns TRUE when a volume popup would get in the way of the fullscreen
+ * application in focus. Only the popup is left out, the volume change has
+ * already been sent by then.
+ */
+static gboolean
+xvd_notify_skip_fullscreen(XvdInstance *Inst,
+						   gboolean mute_changed)
+{
+	if (!g_atomic_int_get (&Inst->focused_fullscreen))
+		return FALSE;
+
+	switch (Inst->fullscreen_notifications) {
+		case FULLSCREEN_NOTIFICATIONS_NONE:
+			break;
+		case FULLSCREEN_NOTIFICATIONS_MUTE:
+			if (mute_changed)
+				return FALSE;
+			break;
+		default:
+			return FALSE;
+	}
+
+	Inst->stats.notifications_fullscreen++;
+	return TRUE;
+}
 
 void
 xvd_notify_notification(XvdInstance *Inst,
 						gchar* icon,
 						gint value)
 {
-	GError* error						= NULL;
 	gchar*  title						= NULL;
 
+	XVD_DISPATCH_TAG ();
+
 	if ((icon != NULL) && (g_strcmp0(icon, ICON_AUDIO_VOLUME_MUTED) == 0)) {
 		// TRANSLATORS: this is the body of the ATK interface of the volume notifications. This is the case when volume is muted
 		title = g_strdup ("Volume is muted");
@@ -41,141 +166,321 @@ xvd_notify_notification(XvdInstance *Inst,
 		title = g_strdup_printf ("Volume is at %d%c", value, '%');
 	}
 
-	if (Inst->icon_style == ICONS_STYLE_SYMBOLIC)
-		icon = g_strconcat (icon, "-symbolic", NULL);
+	/* the gauge follows the sound while the level meter runs */
+	xvd_notify_show_volume (Inst, title, icon, (Inst->osd.level >= 0) ? Inst->osd.level : value);
+	Inst->notified_mute = Inst->osd.mute;
+	g_free (title);
+}
 
-	notify_notification_update (Inst->notification,
-				title,
-				NULL,
-				icon);
+void
+xvd_notify_stream_notification(XvdInstance *Inst)
+{
+	gchar*  title						= NULL;
+	gchar*  icon						= NULL;
+	gint    vol							= xvd_get_readable_volume (&Inst->osd.stream_volume);
 
-	g_free (title);
+	XVD_DISPATCH_TAG ();
 
-	notify_notification_set_hint (Inst->notification, "transient", g_variant_new_boolean (TRUE));
-	if (Inst->gauge_notifications) {
-		notify_notification_set_hint_int32 (Inst->notification,
-							"value",
-							value);
-		notify_notification_set_hint_string (Inst->notification,
-							 "x-canonical-private-synchronous",
-							 "");
-	}
+	if (xvd_notify_skip_fullscreen (Inst, FALSE))
+		return;
 
-	if (!notify_notification_show (Inst->notification, &error))
-	{
-		g_warning ("Error while sending notification : %s\n", error->message);
-		g_error_free (error);
-	}
+	if (vol == 0)
+		icon = ICON_AUDIO_VOLUME_OFF;
+	else if (vol < 34)
+		icon = ICON_AUDIO_VOLUME_LOW;
+	else if (vol < 67)
+		icon = ICON_AUDIO_VOLUME_MEDIUM;
+	else
+		icon = ICON_AUDIO_VOLUME_HIGH;
+
+	// TRANSLATORS: %s is the name of an application, %d its volume displayed as a percent, and %c is replaced by '%'.
+	title = g_strdup_printf ("%s volume is at %d%c", Inst->osd.stream_name, vol, '%');
+
+	xvd_notify_show_volume (Inst, title, icon, vol);
+	g_free (title);
 }
 
 void
 xvd_notify_volume_notification(XvdInstance *Inst)
 {
-	gint vol = xvd_get_readable_volume (&Inst->volume);
+	gint vol = xvd_get_readable_volume (&Inst->osd.volume);
+
+	if (xvd_notify_skip_fullscreen (Inst, Inst->osd.mute != Inst->notified_mute))
+		return;
+
 	if (vol == 0)
-		xvd_notify_notification (Inst, (Inst->mute) ? ICON_AUDIO_VOLUME_MUTED : ICON_AUDIO_VOLUME_OFF, vol);
+		xvd_notify_notification (Inst, (Inst->osd.mute) ? ICON_AUDIO_VOLUME_MUTED : ICON_AUDIO_VOLUME_OFF, vol);
 	else if (vol < 34)
-		xvd_notify_notification (Inst, (Inst->mute) ? ICON_AUDIO_VOLUME_MUTED : ICON_AUDIO_VOLUME_LOW, vol);
+		xvd_notify_notification (Inst, (Inst->osd.mute) ? ICON_AUDIO_VOLUME_MUTED : ICON_AUDIO_VOLUME_LOW, vol);
 	else if (vol < 67)
-		xvd_notify_notification (Inst, (Inst->mute) ? ICON_AUDIO_VOLUME_MUTED : ICON_AUDIO_VOLUME_MEDIUM, vol);
+		xvd_notify_notification (Inst, (Inst->osd.mute) ? ICON_AUDIO_VOLUME_MUTED : ICON_AUDIO_VOLUME_MEDIUM, vol);
 	else
-		xvd_notify_notification (Inst, (Inst->mute) ? ICON_AUDIO_VOLUME_MUTED : ICON_AUDIO_VOLUME_HIGH, vol);
+		xvd_notify_notification (Inst, (Inst->osd.mute) ? ICON_AUDIO_VOLUME_MUTED : ICON_AUDIO_VOLUME_HIGH, vol);
 }
 
 void
 xvd_notify_overshoot_notification(XvdInstance *Inst)
 {
+	if (xvd_notify_skip_fullscreen (Inst, Inst->osd.mute != Inst->notified_mute))
+		return;
+
 	xvd_notify_notification (Inst,
-	    (Inst->mute) ? ICON_AUDIO_VOLUME_MUTED : ICON_AUDIO_VOLUME_HIGH,
+	    (Inst->osd.mute) ? ICON_AUDIO_VOLUME_MUTED : ICON_AUDIO_VOLUME_HIGH,
 	    (Inst->gauge_notifications) ? 101 : 100);
 }
 
 void
 xvd_notify_undershoot_notification(XvdInstance *Inst)
 {
+	if (xvd_notify_skip_fullscreen (Inst, Inst->osd.mute != Inst->notified_mute))
+		return;
+
 	xvd_notify_notification (Inst,
-	    (Inst->mute) ? ICON_AUDIO_VOLUME_MUTED : ICON_AUDIO_VOLUME_OFF,
+	    (Inst->osd.mute) ? ICON_AUDIO_VOLUME_MUTED : ICON_AUDIO_VOLUME_OFF,
 	    (Inst->gauge_notifications) ? -1 : 0);
 }
 
 void
 xvd_notify_mic_notification(XvdInstance *Inst)
 {
-	GError* error						= NULL;
 	gchar*  title						= NULL;
 	gchar*  icon						= NULL;
 
-	title = g_strdup_printf ("Microphone is %s", (Inst->mic_mute) ? "muted" : "active");
-	icon = (Inst->mic_mute) ? ICON_MICROPHONE_MUTED : ICON_MICROPHONE_HIGH;
+	XVD_DISPATCH_TAG ();
+
+	title = g_strdup_printf ("Microphone is %s", (Inst->osd.mic_mute) ? "muted" : "active");
+	icon = (Inst->osd.mic_mute) ? ICON_MICROPHONE_MUTED : ICON_MICROPHONE_HIGH;
+
+	xvd_notify_show (Inst, &Inst->popup_mic, title, icon, XVD_NOTIFY_NO_GAUGE);
+	g_free (title);
+}
+
+void
+xvd_notify_device_notification(XvdInstance *Inst)
+{
+	gchar*  title						= NULL;
+
+	XVD_DISPATCH_TAG ();
 
-	notify_notification_update (Inst->notification_mic,
-                              title,
-                              NULL,
-                              icon);
+	// TRANSLATORS: %s is the name of the sound card or port now in use
+	title = g_strdup_printf ("Sound output: %s", Inst->osd.device_name);
 
+	xvd_notify_show (Inst, &Inst->popup_device, title, ICON_AUDIO_CARD, XVD_NOTIFY_NO_GAUGE);
 	g_free (title);
+}
+
+void
+xvd_notify_mute_all_notification(XvdInstance *Inst)
+{
+	const gchar* title					= NULL;
+	const gchar* icon					= NULL;
+
+	XVD_DISPATCH_TAG ();
+
+	if (Inst->osd.mute && Inst->osd.mic_mute) {
+		title = "Sound and microphone are muted";
+		icon = ICON_MICROPHONE_MUTED;
+	}
+	else {
+		title = "Sound and microphone are active";
+		icon = ICON_MICROPHONE_HIGH;
+	}
+
+	xvd_notify_show (Inst, &Inst->popup_mute_all, title, icon, XVD_NOTIFY_NO_GAUGE);
+}
+
+/**
+ * Sets the hints of the popups, which survive notify_notification_update()
+ * so they are not sent again on every show.
+ */
+static void
+xvd_notify_set_hints(XvdInstance *Inst)
+{
+	XvdPopup *popups[] = { &Inst->popup, &Inst->popup_mic, &Inst->popup_device, &Inst->popup_mute_all };
+	guint     n;
+
+	for (n = 0; n < G_N_ELEMENTS (popups); n++) {
+		notify_notification_clear_hints (popups[n]->notification);
+		notify_notification_set_hint (popups[n]->notification, "transient", g_variant_new_boolean (TRUE));
+	}
 
-	notify_notification_set_hint (Inst->notification, "transient", g_variant_new_boolean (TRUE));
 	if (Inst->gauge_notifications) {
-		notify_notification_set_hint_int32 (Inst->notification_mic,
+		notify_notification_set_hint_string (Inst->popup.notification,
+							 SYNCHRONOUS,
+							 "");
+		notify_notification_set_hint_int32 (Inst->popup_mic.notification,
 							 LAYOUT_ICON_ONLY,
 							 1);
 	}
+}
 
-	if (!notify_notification_show (Inst->notification_mic, &error))
-	{
-		g_warning ("Error while sending mic notification : %s\n", error->message);
+static void
+xvd_notify_caps_callback(GObject *source,
+						 GAsyncResult *result,
+						 gpointer userdata)
+{
+	XvdInstance *Inst					= userdata;
+	GVariant    *reply					= NULL;
+	GError      *error					= NULL;
+	const gchar **caps					= NULL;
+
+	reply = g_dbus_connection_call_finish (G_DBUS_CONNECTION (source), result, &error);
+	if (!reply) {
+		if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+			g_debug ("No notification server capabilities, asking again when the server changes: %s", error->message);
+			g_clear_object (&Inst->notify_caps_cancellable);
+		}
 		g_error_free (error);
+		return;
 	}
+	g_clear_object (&Inst->notify_caps_cancellable);
 
+	g_variant_get (reply, "(^a&s)", &caps);
+	Inst->gauge_notifications = g_strv_contains (caps, LAYOUT_ICON_ONLY);
+	Inst->notify_caps_known = TRUE;
+	g_free (caps);
+	g_variant_unref (reply);
+
+	xvd_notify_set_hints (Inst);
 }
 
-void
-xvd_notify_init(XvdInstance *Inst,
-				const gchar *appname)
+/**
+ * Asks the server that just took the name whether it shows gauges. The
+ * answer comes back on the main loop, popups sent until then keep the
+ * hints they have.
+ */
+static void
+xvd_notify_server_appeared(GDBusConnection *connection,
+						   const gchar *name,
+						   const gchar *owner,
+						   gpointer userdata)
 {
-	GList *caps_list = NULL;
+	XvdInstance *Inst					= userdata;
 
-	Inst->gauge_notifications = TRUE;
-	notify_init (appname);
+	if (Inst->notify_caps_cancellable)
+		g_cancellable_cancel (Inst->notify_caps_cancellable);
+	g_clear_object (&Inst->notify_caps_cancellable);
+	Inst->notify_caps_cancellable = g_cancellable_new ();
 
-	caps_list = notify_get_server_caps ();
+	g_dbus_connection_call (connection,
+				owner,
+				XVD_NOTIFY_PATH,
+				XVD_NOTIFY_NAME,
+				"GetCapabilities",
+				NULL,
+				G_VARIANT_TYPE ("(as)"),
+				G_DBUS_CALL_FLAGS_NO_AUTO_START,
+				-1,
+				Inst->notify_caps_cancellable,
+				xvd_notify_caps_callback,
+				Inst);
+}
 
-	if (caps_list)
-	{
-		GList *node;
+/**
+ * The server left with its popups, the next one may show other things.
+ * The popups keep their hints until it answers.
+ */
+static void
+xvd_notify_server_vanished(GDBusConnection *connection,
+						   const gchar *name,
+						   gpointer userdata)
+{
+	XvdInstance *Inst					= userdata;
+	XvdPopup    *popups[]				= { &Inst->popup, &Inst->popup_mic, &Inst->popup_device, &Inst->popup_mute_all };
+	guint        n;
 
-		node = g_list_find_custom (caps_list, LAYOUT_ICON_ONLY, (GCompareFunc) g_strcmp0);
-		if (!node)
-			Inst->gauge_notifications = FALSE;
+	for (n = 0; n < G_N_ELEMENTS (popups); n++)
+		popups[n]->until = 0;
 
-/*		node = g_list_find_custom (caps_list, SYNCHRONOUS, (GCompareFunc) g_strcmp0);*/
-/*		if (!node)*/
-/*			Inst->gauge_notifications = FALSE;*/
+	if (Inst->notify_caps_cancellable)
+		g_cancellable_cancel (Inst->notify_caps_cancellable);
+	g_clear_object (&Inst->notify_caps_cancellable);
+	Inst->notify_caps_known = FALSE;
+}
 
-		g_list_free (caps_list);
-	}
+static void
+xvd_notify_closed(NotifyNotification *notification,
+				  XvdPopup *popup)
+{
+	XVD_DISPATCH_TAG ();
+
+	/* the next show has to be sent, whatever it looks like */
+	popup->until = 0;
+}
+
+static void
+xvd_notify_volume_closed(NotifyNotification *notification,
+						 XvdInstance *Inst)
+{
+	/* nothing left to animate */
+	xvd_pulse_stop_meter (Inst);
+}
 
+static void
+xvd_notify_popup_init(XvdPopup *popup)
+{
 #ifdef NOTIFY_CHECK_VERSION
 #if NOTIFY_CHECK_VERSION (0, 7, 0)
-	Inst->notification = notify_notification_new ("Xfce4-Volumed", NULL, NULL);
-	Inst->notification_mic = notify_notification_new ("Xfce4-Volumed", NULL, NULL);
+	popup->notification = notify_notification_new ("Xfce4-Volumed", NULL, NULL);
 #else
-	Inst->notification = notify_notification_new ("Xfce4-Volumed", NULL, NULL, NULL);
-	Inst->notification_mic = notify_notification_new ("Xfce4-Volumed", NULL, NULL, NULL);
+	popup->notification = notify_notification_new ("Xfce4-Volumed", NULL, NULL, NULL);
 #endif
 #else
-	Inst->notification = notify_notification_new ("Xfce4-Volumed", NULL, NULL, NULL);
-	Inst->notification_mic = notify_notification_new ("Xfce4-Volumed", NULL, NULL, NULL);
+	popup->notification = notify_notification_new ("Xfce4-Volumed", NULL, NULL, NULL);
 #endif
+
+	g_signal_connect (popup->notification, "closed", G_CALLBACK (xvd_notify_closed), popup);
+}
+
+static void
+xvd_notify_popup_uninit(XvdPopup *popup)
+{
+	g_object_unref (G_OBJECT (popup->notification));
+	popup->notification = NULL;
+	g_clear_pointer (&popup->title, g_free);
+	g_clear_pointer (&popup->icon, g_free);
+	popup->until = 0;
+}
+
+void
+xvd_notify_init(XvdInstance *Inst,
+				const gchar *appname)
+{
+	/* gauges unless the server says otherwise, most servers show them */
+	Inst->gauge_notifications = TRUE;
+	notify_init (appname);
+
+	xvd_notify_popup_init (&Inst->popup);
+	xvd_notify_popup_init (&Inst->popup_mic);
+	xvd_notify_popup_init (&Inst->popup_device);
+	xvd_notify_popup_init (&Inst->popup_mute_all);
+	xvd_notify_set_hints (Inst);
+
+	/* asked once the server is there, and again whenever it changes */
+	Inst->notify_watch_id = g_bus_watch_name (G_BUS_TYPE_SESSION,
+						  XVD_NOTIFY_NAME,
+						  G_BUS_NAME_WATCHER_FLAGS_NONE,
+						  xvd_notify_server_appeared,
+						  xvd_notify_server_vanished,
+						  Inst,
+						  NULL);
+
+	g_signal_connect (Inst->popup.notification, "closed", G_CALLBACK (xvd_notify_volume_closed), Inst);
 }
 
 void
 xvd_notify_uninit (XvdInstance *Inst)
 {
-	g_object_unref (G_OBJECT (Inst->notification));
-	Inst->notification = NULL;
-	g_object_unref (G_OBJECT (Inst->notification_mic));
-	Inst->notification_mic = NULL;
+	if (Inst->notify_watch_id)
+		g_bus_unwatch_name (Inst->notify_watch_id);
+	Inst->notify_watch_id = 0;
+	if (Inst->notify_caps_cancellable)
+		g_cancellable_cancel (Inst->notify_caps_cancellable);
+	g_clear_object (&Inst->notify_caps_cancellable);
+
+	xvd_notify_popup_uninit (&Inst->popup);
+	xvd_notify_popup_uninit (&Inst->popup_mic);
+	xvd_notify_popup_uninit (&Inst->popup_device);
+	xvd_notify_popup_uninit (&Inst->popup_mute_all);
 	notify_uninit ();
 }
@@ -42,10 +42,19 @@ xvd_notify_overshoot_notification(XvdInstance *Inst);
 void
 xvd_notify_undershoot_notification(XvdInstance *Inst);
 
+void
+xvd_notify_stream_notification(XvdInstance *Inst);
+
 
 void
 xvd_notify_mic_notification(XvdInstance *Inst);
 
+void
+xvd_notify_device_notification(XvdInstance *Inst);
+
+void
+xvd_notify_mute_all_notification(XvdInstance *Inst);
+
 
 void 
 xvd_notify_init(XvdInstance *Inst, 
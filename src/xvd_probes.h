@@ -0,0 +1,48 @@
+/*
+ *  xfce4-volumed-pulse - Volume management daemon for XFCE 4 (Pulseaudio variant)
+ *
+ *  Copyright © 2026 The Xfce Development Team
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _XVD_PROBES_H
+#define _XVD_PROBES_H
+
+/**
+ * USDT probes for bpftrace and perf, provider "xvd". Built with the 'usdt'
+ * meson option, each one is a single nop until a tracer attaches.
+ *
+ *  key_press (keystring)           a key handler is entered
+ *  key_release (keystring)         the push-to-talk key is released
+ *  op_submit (XvdOpType, op)       an operation is sent, op is NULL on failure
+ *  op_done (XvdOpType, success)    the server answered an operation
+ *  server_event (type, index)      a subscription event came in
+ *  notify_send (notification)      a notification is about to be shown
+ *  notify_done (notification, ok)  the notification server answered
+ *  context_state (pa_context_state_t)
+ *  reconnect ()                    a new connection is attempted
+ */
+#ifdef HAVE_SYS_SDT_H
+#include <sys/sdt.h>
+#define XVD_PROBE0(name)       DTRACE_PROBE (xvd, name)
+#define XVD_PROBE1(name, a)    DTRACE_PROBE1 (xvd, name, a)
+#define XVD_PROBE2(name, a, b) DTRACE_PROBE2 (xvd, name, a, b)
+#else
+#define XVD_PROBE0(name)       do { } while (0)
+#define XVD_PROBE1(name, a)    do { } while (0)
+#define XVD_PROBE2(name, a, b) do { } while (0)
+#endif
+
+#endif
@@ -17,11 +17,33 @@
  *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+#ifdef HAVE_ERRNO_H
+#include <errno.h>
+#endif
+#include <fcntl.h>
+#include <string.h>
+
+#include <glib-unix.h>
+
 #include <pulse/error.h>
 #include <pulse/introspect.h>
+#include <pulse/rtclock.h>
+#include <pulse/stream.h>
 #include <pulse/subscribe.h>
 
+#include "xvd_devices.h"
+#include "xvd_probes.h"
 #include "xvd_pulse.h"
+#include "xvd_record.h"
+#include "xvd_state.h"
+#include "xvd_stats.h"
+#include "xvd_streams.h"
+#include "xvd_trace.h"
+#include "xvd_watchdog.h"
+#include "xvd_work.h"
 
 #ifdef HAVE_LIBNOTIFY
 #include "xvd_notify.h"
@@ -32,6 +54,29 @@
  */
 #define XVD_PA_VOLUME_STEP(n) ((pa_volume_t)((n) * PA_VOLUME_NORM / 100))
 
+/* ramps write the volume at most once per frame */
+#define XVD_RAMP_FRAME_USEC (PA_USEC_PER_SEC / 60)
+
+/* the level meter gets this many peaks per second, and runs that long
+   (in ms) after the last volume notification */
+#define XVD_METER_RATE    10
+#define XVD_METER_TIMEOUT 3000
+
+/* the notification follows the level at most this often (in us), and
+   only once it moved by this many percent */
+#define XVD_METER_UPDATE_USEC   (G_USEC_PER_SEC / 5)
+#define XVD_METER_UPDATE_CHANGE 5
+
+#define XVD_METER_ON  1
+#define XVD_METER_OFF 2
+
+/* key presses from before the first sink are dropped once this old (in us) */
+#define XVD_EARLY_TIMEOUT (2 * G_USEC_PER_SEC)
+
+/* XVD_CMD_PUSH_TO_TALK arguments */
+#define XVD_PTT_TALK  1
+#define XVD_PTT_QUIET 2
+
 
 static pa_cvolume old_volume;
 static int        old_mute;
@@ -39,6 +84,8 @@ static int        old_mic_mute;
 
 
 #ifdef HAVE_LIBNOTIFY
+static void xvd_notify_volume_change       (XvdInstance                    *i);
+
 static void xvd_notify_volume_callback     (pa_context                     *c,
                                             int                             success,
                                             void                           *userdata);
@@ -46,11 +93,45 @@ static void xvd_notify_volume_callback     (pa_context                     *c,
 static void xvd_notify_mic_callback        (pa_context                     *c,
                                             int                             success,
                                             void                           *userdata);
-#else
-#define xvd_notify_volume_callback NULL
-#define xvd_notify_mic_callback NULL
 #endif
 
+static void xvd_sink_volume_callback       (pa_context                     *c,
+                                            int                             success,
+                                            void                           *userdata);
+
+static void xvd_member_volume_callback     (pa_context                     *c,
+                                            int                             success,
+                                            void                           *userdata);
+
+static void xvd_sink_mute_callback         (pa_context                     *c,
+                                            int                             success,
+                                            void                           *userdata);
+
+static void xvd_stream_volume_callback     (pa_context                     *c,
+                                            int                             success,
+                                            void                           *userdata);
+
+static void xvd_sink_mute_all_callback     (pa_context                     *c,
+                                            int                             success,
+                                            void                           *userdata);
+
+static void xvd_source_mute_all_callback   (pa_context                     *c,
+                                            int                             success,
+                                            void                           *userdata);
+
+static void xvd_mute_all_sources_callback  (pa_context                     *c,
+                                            const pa_source_info           *info,
+                                            int                             eol,
+                                            void                           *userdata);
+
+static void xvd_ptt_mute_callback          (pa_context                     *c,
+                                            int                             success,
+                                            void                           *userdata);
+
+static void xvd_source_mute_callback       (pa_context                     *c,
+                                            int                             success,
+                                            void                           *userdata);
+
 static void xvd_context_state_callback     (pa_context                     *c,
                                             void                           *userdata);
 
@@ -59,9 +140,14 @@ static void xvd_subscribed_events_callback (pa_context                     *c,
                                             uint32_t                        index,
                                             void                           *userdata);
 
-static void xvd_server_info_callback       (pa_context                     *c,
-                                            const pa_server_info           *info,
-                                            void                           *userdata);
+static void xvd_fetch_defaults             (pa_context                     *c,
+                                            XvdInstance                    *i);
+
+static void xvd_fetch_sinks                (pa_context                     *c,
+                                            XvdInstance                    *i);
+
+static void xvd_fetch_sources              (pa_context                     *c,
+                                            XvdInstance                    *i);
 
 static void xvd_default_sink_info_callback (pa_context                     *c,
                                             const pa_sink_info             *info,
@@ -78,6 +164,11 @@ static void xvd_update_sink_callback       (pa_context                     *c,
                                             int                             eol,
                                             void                           *userdata);
 
+static void xvd_member_sink_callback       (pa_context                     *c,
+                                            const pa_sink_info             *info,
+                                            int                             eol,
+                                            void                           *userdata);
+
 static void xvd_default_source_info_callback (pa_context                     *c,
                                               const pa_source_info             *info,
                                               int                             eol,
@@ -93,299 +184,2094 @@ static void xvd_update_source_callback      (pa_context                     *c,
                                              int                             eol,
                                              void                           *userdata);
 
+static void xvd_fetch_sink_inputs          (pa_context                     *c,
+                                            XvdInstance                    *i);
+
+static void xvd_sink_input_info_callback   (pa_context                     *c,
+                                            const pa_sink_input_info       *info,
+                                            int                             eol,
+                                            void                           *userdata);
+
+static void xvd_new_sink_callback          (pa_context                     *c,
+                                            const pa_sink_info             *info,
+                                            int                             eol,
+                                            void                           *userdata);
+
+static void xvd_fetch_cards                (pa_context                     *c,
+                                            XvdInstance                    *i);
+
+static void xvd_card_info_callback         (pa_context                     *c,
+                                            const pa_card_info             *info,
+                                            int                             eol,
+                                            void                           *userdata);
+
 static gboolean xvd_connect_to_pulse       (XvdInstance                    *i);
 
+static void xvd_context_ready              (XvdInstance                    *i);
+
+static void xvd_replay_connect_callback    (pa_mainloop_api                *api,
+                                            pa_defer_event                 *e,
+                                            void                           *userdata);
+
+static void xvd_command_callback           (pa_mainloop_api                *api,
+                                            pa_io_event                    *e,
+                                            int                             fd,
+                                            pa_io_event_flags_t             events,
+                                            void                           *userdata);
+
+static void xvd_run_command                (XvdInstance                    *i,
+                                            XvdCommand                      cmd,
+                                            gint                            arg);
+
+static void xvd_apply_volume               (XvdInstance                    *i,
+                                            guint                           percent);
+
+static void xvd_step_volume                (XvdInstance                    *i,
+                                            gint                            delta);
+
+static void xvd_step_stream_volume         (XvdInstance                    *i,
+                                            gint                            delta);
+
+static void xvd_switch_mute                (XvdInstance                    *i);
+
+static void xvd_switch_mic_mute            (XvdInstance                    *i);
+
+static void xvd_switch_mute_all            (XvdInstance                    *i);
+
+static void xvd_mute_all_done              (XvdInstance                    *i);
+
+static void xvd_state_changed              (XvdInstance                    *i);
+
+static void xvd_save_state_work            (XvdInstance                    *i);
+
+static void xvd_switch_push_to_talk        (XvdInstance                    *i,
+                                            gboolean                        talk);
+
+static void xvd_write_volume               (XvdInstance                    *i);
+
+static void xvd_write_mute                 (XvdInstance                    *i);
+
+static void xvd_write_mic_mute             (XvdInstance                    *i);
+
+static void xvd_write_stream_volume        (XvdInstance                    *i);
+
+static void xvd_ramp_volume                (XvdInstance                    *i,
+                                            const pa_cvolume               *target);
+
+static void xvd_ramp_stop                  (XvdInstance                    *i);
+
+static void xvd_set_sink_monitor           (XvdInstance                    *i,
+                                            const gchar                    *name);
+
+#ifdef HAVE_LIBNOTIFY
+static void xvd_meter_connect              (XvdInstance                    *i);
+
+static void xvd_meter_disconnect           (XvdInstance                    *i);
+#endif
+
+
+/**
+ * Sends a libpulse request, to the recorded server in a replay. Gives a
+ * pa_operation, or a XvdReplayOp in a replay, NULL on failure.
+ */
+#define XVD_REQUEST(i, request, ...) \
+  ((i)->pa_replay ? (gpointer) xvd_replay_##request (__VA_ARGS__) \
+                  : (gpointer) pa_context_##request ((i)->pulse_context, __VA_ARGS__))
+
+
+/**
+ * Drops a request returned by XVD_REQUEST.
+ */
+static void
+xvd_request_unref (XvdInstance *i,
+                   gpointer     op)
+{
+  if (i->pa_replay)
+    xvd_replay_op_unref (op);
+  else
+    pa_operation_unref (op);
+}
+
+
+/**
+ * Keeps the callback of a request returned by XVD_REQUEST from running.
+ */
+static void
+xvd_request_cancel (XvdInstance *i,
+                    gpointer     op)
+{
+  if (i->pa_replay)
+    xvd_replay_op_cancel (op);
+  else if (pa_operation_get_state (op) == PA_OPERATION_RUNNING)
+    pa_operation_cancel (op);
+}
+
+
+/**
+ * Returns whether requests can be sent, to the server or to the recorded
+ * one in a replay.
+ */
+static gboolean
+xvd_pulse_ready (XvdInstance *i)
+{
+  if (!i->pulse_context)
+    return FALSE;
+  if (i->pa_replay)
+    return i->pa_replay_ready;
+  return pa_context_get_state (i->pulse_context) == PA_CONTEXT_READY;
+}
+
+
+/**
+ * Accounts for a write operation sent to the server, and keeps track of it
+ * until it completes.
+ */
+static gboolean
+xvd_op_submitted (XvdInstance  *i,
+                  gpointer      op,
+                  XvdOpType     type)
+{
+  i->stats.ops_issued[type]++;
+  XVD_TRACE (OP_SUBMIT, type, op != NULL);
+  XVD_PROBE2 (op_submit, type, op);
+  if (!op)
+    {
+      i->stats.ops_failed[type]++;
+      return FALSE;
+    }
+  i->pending[type].op = op;
+  i->pending[type].superseded = FALSE;
+  return TRUE;
+}
+
+
+/**
+ * Returns whether a write to the target of @type is still in flight. The
+ * new state is then only written once it completes, so a burst of changes
+ * ends up in at most two writes.
+ */
+static gboolean
+xvd_op_in_flight (XvdInstance *i,
+                  XvdOpType    type)
+{
+  if (!i->pending[type].op)
+    return FALSE;
+
+  i->pending[type].superseded = TRUE;
+  return TRUE;
+}
+
+
+/**
+ * Forgets the write in flight for @type, returns whether it was superseded
+ * by a newer state that remains to be written.
+ */
+static gboolean
+xvd_op_release (XvdInstance *i,
+                XvdOpType    type)
+{
+  gboolean superseded = i->pending[type].superseded;
+
+  if (i->pending[type].op)
+    {
+      xvd_request_unref (i, i->pending[type].op);
+      i->pending[type].op = NULL;
+    }
+  i->pending[type].superseded = FALSE;
+
+  return superseded;
+}
+
+
+/**
+ * Cancels the write in flight for @type, its callback won't run.
+ */
+static void
+xvd_op_cancel (XvdInstance *i,
+               XvdOpType    type)
+{
+  if (i->pending[type].op)
+    xvd_request_cancel (i, i->pending[type].op);
+
+  xvd_op_release (i, type);
+}
+
+
+/**
+ * Cancels all the writes in flight.
+ */
+static void
+xvd_op_cancel_all (XvdInstance *i)
+{
+  guint type;
+
+  for (type = 0; type < XVD_OP_N; type++)
+    xvd_op_cancel (i, type);
+}
+
+
+/**
+ * Accounts for the completion of a write operation.
+ */
+static gboolean
+xvd_op_succeeded (pa_context  *c,
+                  int          success,
+                  XvdInstance *i,
+                  XvdOpType    type)
+{
+  XVD_TRACE (OP_DONE, type, success);
+  XVD_PROBE2 (op_done, type, success);
+  if (success)
+    return TRUE;
+
+  i->stats.ops_failed[type]++;
+  g_warning ("xvd_op_succeeded: operation failed, %s",
+             pa_strerror (pa_context_errno (c)));
+  return FALSE;
+}
+
 
 gboolean
 xvd_open_pulse (XvdInstance *i)
 {
-  i->pa_main_loop = pa_glib_mainloop_new (NULL);
-  g_assert (i->pa_main_loop);
-  return xvd_connect_to_pulse (i);
+  gboolean ret;
+  XvdState state;
+
+  /* shown until the server tells better, a replay starts from the
+     recording alone */
+  if (!i->pa_replay && xvd_state_load (&state))
+    {
+      g_strlcpy (i->sink_name, state.sink_name, sizeof (i->sink_name));
+      old_volume = i->volume = state.volume;
+      old_mute = i->mute = state.mute;
+      i->state_cached = TRUE;
+    }
+
+  i->streams = xvd_streams_new ();
+  i->cards = xvd_devices_new_cards ();
+  i->sinks = xvd_devices_new_sinks ();
+
+  if (!i->pa_use_thread)
+    {
+      i->pa_main_loop = pa_glib_mainloop_new (NULL);
+      g_assert (i->pa_main_loop);
+      i->pa_api = pa_glib_mainloop_get_api (i->pa_main_loop);
+      return xvd_connect_to_pulse (i);
+    }
+
+  i->pa_threaded_loop = pa_threaded_mainloop_new ();
+  g_assert (i->pa_threaded_loop);
+  i->pa_api = pa_threaded_mainloop_get_api (i->pa_threaded_loop);
+
+  /* the key handlers wake the PulseAudio thread through this pipe */
+  if (!g_unix_open_pipe (i->pa_command_pipe, FD_CLOEXEC, NULL)
+      || !g_unix_set_fd_nonblocking (i->pa_command_pipe[0], TRUE, NULL)
+      || !g_unix_set_fd_nonblocking (i->pa_command_pipe[1], TRUE, NULL))
+    {
+      g_warning ("xvd_open_pulse: failed to create the command pipe");
+      return FALSE;
+    }
+  i->pa_command_event = i->pa_api->io_new (i->pa_api,
+                                           i->pa_command_pipe[0],
+                                           PA_IO_EVENT_INPUT,
+                                           xvd_command_callback,
+                                           i);
+
+  ret = xvd_connect_to_pulse (i);
+
+  if (ret && pa_threaded_mainloop_start (i->pa_threaded_loop) < 0)
+    {
+      g_warning ("xvd_open_pulse: failed to start the PulseAudio thread");
+      ret = FALSE;
+    }
+
+  return ret;
 }
 
 
 void
 xvd_close_pulse (XvdInstance *i)
 {
+  /* joins the PulseAudio thread, everything is ours again */
+  if (i->pa_threaded_loop)
+    pa_threaded_mainloop_stop (i->pa_threaded_loop);
+
   if (i->reconnect_id != 0)
     {
       g_source_remove(i->reconnect_id);
       i->reconnect_id = 0;
     }
+  xvd_ramp_stop (i);
+  xvd_op_cancel_all (i);
+  if (i->pa_replay)
+    {
+      xvd_replay_stop ();
+      i->pa_replay_ready = FALSE;
+    }
+  xvd_save_state_work (i);
+#ifdef HAVE_LIBNOTIFY
+  if (i->meter_timeout_id != 0)
+    {
+      g_source_remove (i->meter_timeout_id);
+      i->meter_timeout_id = 0;
+    }
+  xvd_meter_disconnect (i);
+#endif
   if (i->pulse_context)
     {
       pa_context_unref (i->pulse_context);
       i->pulse_context = NULL;
     }
-  pa_glib_mainloop_free (i->pa_main_loop);
-  i->pa_main_loop = NULL;
+  if (i->streams)
+    {
+      g_hash_table_destroy (i->streams);
+      g_hash_table_destroy (i->cards);
+      g_hash_table_destroy (i->sinks);
+      i->streams = i->cards = i->sinks = NULL;
+    }
+  xvd_set_sink_monitor (i, NULL);
+  if (i->pa_command_event)
+    {
+      i->pa_api->io_free (i->pa_command_event);
+      i->pa_command_event = NULL;
+    }
+  if (i->pa_command_pipe[0] >= 0)
+    {
+      close (i->pa_command_pipe[0]);
+      close (i->pa_command_pipe[1]);
+      i->pa_command_pipe[0] = i->pa_command_pipe[1] = -1;
+    }
+  if (i->pa_threaded_loop)
+    {
+      pa_threaded_mainloop_free (i->pa_threaded_loop);
+      i->pa_threaded_loop = NULL;
+    }
+  if (i->pa_main_loop)
+    {
+      pa_glib_mainloop_free (i->pa_main_loop);
+      i->pa_main_loop = NULL;
+    }
+  i->pa_api = NULL;
 }
 
 
 void
-xvd_update_volume (XvdInstance        *i,
-                   XvdVolStepDirection d)
+xvd_pulse_lock (XvdInstance *i)
 {
-  pa_operation *op = NULL;
+  if (i->pa_threaded_loop)
+    pa_threaded_mainloop_lock (i->pa_threaded_loop);
+}
 
-  if (!i || !i->pulse_context)
+
+void
+xvd_pulse_unlock (XvdInstance *i)
+{
+  if (i->pa_threaded_loop)
+    pa_threaded_mainloop_unlock (i->pa_threaded_loop);
+}
+
+
+/**
+ * Runs a command in the PulseAudio thread, or right away without one.
+ * Commands of the same kind posted meanwhile are merged, so a thread
+ * busy with I/O catches up in a single operation.
+ */
+static void
+xvd_post_command (XvdInstance *i,
+                  XvdCommand   cmd,
+                  gint         arg)
+{
+  if (!i->pa_threaded_loop)
     {
-      g_warning ("xvd_update_volume: pulseaudio context is null");
+      xvd_run_command (i, cmd, arg);
       return;
     }
 
-  if (pa_context_get_state (i->pulse_context) != PA_CONTEXT_READY)
+  /* absolute commands only keep the last value, the others add up */
+  if (cmd == XVD_CMD_SET_VOLUME || cmd == XVD_CMD_METER
+      || cmd == XVD_CMD_PUSH_TO_TALK)
+    g_atomic_int_set (&i->pa_commands[cmd], arg);
+  else
+    g_atomic_int_add (&i->pa_commands[cmd], arg);
+
+  /* a full pipe already has a wakeup pending */
+  if (write (i->pa_command_pipe[1], "c", 1) < 0 && errno != EAGAIN)
+    g_warning ("xvd_post_command: failed to wake the PulseAudio thread: %s",
+               g_strerror (errno));
+}
+
+
+/**
+ * Drains the commands posted to the PulseAudio thread.
+ */
+static void
+xvd_command_callback (pa_mainloop_api    *api,
+                      pa_io_event        *e,
+                      int                 fd,
+                      pa_io_event_flags_t events,
+                      void               *userdata)
+{
+  XvdInstance *i = (XvdInstance *) userdata;
+  gchar        buf[64];
+  guint        cmd;
+
+  while (read (fd, buf, sizeof (buf)) > 0)
+    ;
+
+  for (cmd = 0; cmd < XVD_CMD_N; cmd++)
+    {
+      gint arg;
+
+      do
+        arg = g_atomic_int_get (&i->pa_commands[cmd]);
+      while (!g_atomic_int_compare_and_exchange (&i->pa_commands[cmd], arg, 0));
+
+      if (arg != 0)
+        xvd_run_command (i, cmd, arg);
+    }
+}
+
+
+static void
+xvd_run_command (XvdInstance *i,
+                 XvdCommand   cmd,
+                 gint         arg)
+{
+  switch (cmd)
+    {
+      case XVD_CMD_SET_VOLUME:
+        xvd_apply_volume (i, arg - 1);
+      break;
+      case XVD_CMD_VOLUME:
+        xvd_step_volume (i, arg);
+      break;
+      case XVD_CMD_MUTE:
+        /* an even number of toggles is a no-op */
+        if (arg % 2 != 0)
+          xvd_switch_mute (i);
+      break;
+      case XVD_CMD_MIC_MUTE:
+        if (arg % 2 != 0)
+          xvd_switch_mic_mute (i);
+      break;
+      case XVD_CMD_MUTE_ALL:
+        if (arg % 2 != 0)
+          xvd_switch_mute_all (i);
+      break;
+      case XVD_CMD_PUSH_TO_TALK:
+        xvd_switch_push_to_talk (i, arg == XVD_PTT_TALK);
+      break;
+      case XVD_CMD_STREAM_VOLUME:
+        xvd_step_stream_volume (i, arg);
+      break;
+      case XVD_CMD_METER:
+#ifdef HAVE_LIBNOTIFY
+        if (arg == XVD_METER_ON)
+          xvd_meter_connect (i);
+        else
+          xvd_meter_disconnect (i);
+#endif
+      break;
+      default:
+        g_warning ("xvd_run_command: invalid command");
+      break;
+    }
+}
+
+
+void
+xvd_update_volume (XvdInstance        *i,
+                   XvdVolStepDirection d,
+                   guint               step)
+{
+  switch (d)
+    {
+      case XVD_UP:
+        xvd_post_command (i, XVD_CMD_VOLUME, step);
+      break;
+      case XVD_DOWN:
+        xvd_post_command (i, XVD_CMD_VOLUME, -(gint) step);
+      break;
+      default:
+        g_warning ("xvd_update_volume: invalid direction");
+      break;
+    }
+}
+
+
+void
+xvd_update_stream_volume (XvdInstance        *i,
+                          XvdVolStepDirection d,
+                          guint               step)
+{
+  switch (d)
+    {
+      case XVD_UP:
+        xvd_post_command (i, XVD_CMD_STREAM_VOLUME, step);
+      break;
+      case XVD_DOWN:
+        xvd_post_command (i, XVD_CMD_STREAM_VOLUME, -(gint) step);
+      break;
+      default:
+        g_warning ("xvd_update_stream_volume: invalid direction");
+      break;
+    }
+}
+
+
+void
+xvd_set_volume (XvdInstance *i,
+                guint        percent)
+{
+  xvd_post_command (i, XVD_CMD_SET_VOLUME, MIN (percent, 100) + 1);
+}
+
+
+void
+xvd_toggle_mute (XvdInstance *i)
+{
+  xvd_post_command (i, XVD_CMD_MUTE, 1);
+}
+
+
+void
+xvd_toggle_mic_mute (XvdInstance *i)
+{
+  xvd_post_command (i, XVD_CMD_MIC_MUTE, 1);
+}
+
+
+void
+xvd_toggle_mute_all (XvdInstance *i)
+{
+  xvd_post_command (i, XVD_CMD_MUTE_ALL, 1);
+}
+
+
+void
+xvd_push_to_talk (XvdInstance *i,
+                  gboolean     talk)
+{
+  xvd_post_command (i, XVD_CMD_PUSH_TO_TALK,
+                    (talk) ? XVD_PTT_TALK : XVD_PTT_QUIET);
+}
+
+
+/**
+ * Moves @vol by @delta percent, between silence and 100%.
+ */
+static void
+xvd_cvolume_step (pa_cvolume *vol,
+                  gint        delta)
+{
+  if (delta > 0)
+    pa_cvolume_inc_clamp (vol,
+                          XVD_PA_VOLUME_STEP(delta),
+                          PA_VOLUME_NORM);
+  else
+    pa_cvolume_dec (vol,
+                    XVD_PA_VOLUME_STEP(-delta));
+}
+
+
+/**
+ * Sets the sink volume to @percent, keeping the balance.
+ */
+static void
+xvd_apply_volume (XvdInstance *i,
+                  guint        percent)
+{
+  pa_cvolume target;
+
+  if (!i || !i->pulse_context)
+    {
+      g_warning ("xvd_apply_volume: pulseaudio context is null");
+      return;
+    }
+
+  if (!xvd_pulse_ready (i))
+    {
+      g_warning ("xvd_apply_volume: pulseaudio context isn't ready");
+      return;
+    }
+
+  if (i->sink_index == PA_INVALID_INDEX)
+    {
+      g_warning ("xvd_apply_volume: undefined sink");
+      return;
+    }
+
+  /* backup */
+  old_volume = i->volume;
+
+  target = i->ramp_event ? i->ramp_to : i->volume;
+  pa_cvolume_scale (&target, XVD_PA_VOLUME_STEP(percent));
+  xvd_ramp_volume (i, &target);
+}
+
+
+/**
+ * Returns whether a key press coming before the sink is known should wait
+ * for it. Only at startup: once there was a sink, a press while the server
+ * is gone would be applied out of the blue when it comes back.
+ */
+static gboolean
+xvd_defer_press (XvdInstance *i)
+{
+  if (i->had_sink)
+    {
+      g_debug ("xvd_defer_press: no sink, key press dropped");
+      return FALSE;
+    }
+
+  i->early_time = g_get_monotonic_time ();
+  return TRUE;
+}
+
+
+/**
+ * Changes the sink volume by @delta percent.
+ */
+static void
+xvd_step_volume (XvdInstance *i,
+                 gint         delta)
+{
+  if (!i)
+    {
+      g_warning ("xvd_step_volume: invalid argument");
+      return;
+    }
+
+  /* too early, kept for when the sink is known */
+  if (!xvd_pulse_ready (i)
+      || i->sink_index == PA_INVALID_INDEX)
+    {
+      if (!xvd_defer_press (i))
+        return;
+      i->early_volume += delta;
+      XVD_TRACE (DEFERRED_VOLUME, 0, i->early_volume);
+      if (!i->state_cached)
+        return;
+
+      /* show it on the saved volume meanwhile */
+      old_volume = i->volume;
+      xvd_cvolume_step (&i->volume, delta);
+#ifdef HAVE_LIBNOTIFY
+      xvd_notify_volume_change (i);
+#endif
+      return;
+    }
+
+  /* backup */
+  old_volume = i->volume;
+
+  /* a ramp is running, move where it's heading to */
+  if (i->ramp_event)
+    {
+      xvd_cvolume_step (&i->ramp_to, delta);
+      return;
+    }
+
+  xvd_cvolume_step (&i->volume, delta);
+
+  if (!xvd_op_in_flight (i, XVD_OP_SINK_VOLUME))
+    xvd_write_volume (i);
+}
+
+
+/**
+ * Changes the volume of the focused application by @delta percent, or of
+ * the one that played last if it has no stream. The target is picked from
+ * the cached focus and stream table without asking any server.
+ */
+static void
+xvd_step_stream_volume (XvdInstance *i,
+                        gint         delta)
+{
+  XvdStream *stream = NULL;
+  gint       pid;
+
+  if (!i || !i->pulse_context)
+    {
+      g_warning ("xvd_step_stream_volume: pulseaudio context is null");
+      return;
+    }
+
+  if (!xvd_pulse_ready (i))
+    {
+      g_warning ("xvd_step_stream_volume: pulseaudio context isn't ready");
+      return;
+    }
+
+  pid = g_atomic_int_get (&i->focused_pid);
+  if (pid > 0)
+    stream = xvd_streams_find_pid (i->streams, pid);
+  if (!stream)
+    stream = xvd_streams_most_recent (i->streams);
+  if (!stream)
+    {
+      XVD_TRACE (NO_STREAM, 0, delta);
+      return;
+    }
+
+  /* the table keeps our latest value, the next step builds on it */
+  xvd_cvolume_step (&stream->volume, delta);
+  i->stream_index = stream->index;
+  i->stream_volume = stream->volume;
+  g_strlcpy (i->stream_name, stream->app_name, sizeof (i->stream_name));
+
+  if (!xvd_op_in_flight (i, XVD_OP_STREAM_VOLUME))
+    xvd_write_stream_volume (i);
+}
+
+
+/**
+ * Sends the current stream volume to the server.
+ */
+static void
+xvd_write_stream_volume (XvdInstance *i)
+{
+  gpointer      op = NULL;
+
+  op = XVD_REQUEST (i, set_sink_input_volume,
+                    i->stream_index,
+                    &i->stream_volume,
+                    xvd_stream_volume_callback,
+                    i);
+
+  if (!xvd_op_submitted (i, op, XVD_OP_STREAM_VOLUME))
+    g_warning ("xvd_write_stream_volume: failed");
+}
+
+
+/**
+ * Advances the running ramp by one frame.
+ */
+static void
+xvd_ramp_callback (pa_mainloop_api      *api,
+                   pa_time_event        *e,
+                   const struct timeval *tv,
+                   void                 *userdata)
+{
+  XvdInstance *i = (XvdInstance *) userdata;
+  pa_usec_t    elapsed, duration;
+  guint        ch;
+
+  XVD_DISPATCH_TAG ();
+
+  elapsed = pa_rtclock_now () - i->ramp_start;
+  duration = (pa_usec_t) i->vol_ramp_duration * PA_USEC_PER_MSEC;
+
+  if (elapsed >= duration)
+    {
+      i->volume = i->ramp_to;
+      xvd_ramp_stop (i);
+    }
+  else
+    {
+      i->volume.channels = i->ramp_to.channels;
+      for (ch = 0; ch < i->ramp_to.channels; ch++)
+        i->volume.values[ch] = i->ramp_from.values[ch]
+                               + ((gint64) i->ramp_to.values[ch] - (gint64) i->ramp_from.values[ch])
+                                 * (gint64) elapsed / (gint64) duration;
+      pa_context_rttime_restart (i->pulse_context, e, pa_rtclock_now () + XVD_RAMP_FRAME_USEC);
+    }
+
+  /* latest wins: a frame coming while the previous write is in flight
+     is sent when it completes, skipped if yet another frame came */
+  if (!xvd_op_in_flight (i, XVD_OP_SINK_VOLUME))
+    xvd_write_volume (i);
+}
+
+
+/**
+ * Moves the sink volume to @target, over vol_ramp_duration ms if set.
+ */
+static void
+xvd_ramp_volume (XvdInstance      *i,
+                 const pa_cvolume *target)
+{
+  if (i->vol_ramp_duration == 0)
+    {
+      i->volume = *target;
+      if (!xvd_op_in_flight (i, XVD_OP_SINK_VOLUME))
+        xvd_write_volume (i);
+      return;
+    }
+
+  i->ramp_from = i->volume;
+  i->ramp_to = *target;
+  i->ramp_start = pa_rtclock_now ();
+
+  /* the first frame goes out on the next iteration */
+  if (!i->ramp_event)
+    i->ramp_event = pa_context_rttime_new (i->pulse_context,
+                                           i->ramp_start,
+                                           xvd_ramp_callback,
+                                           i);
+  else
+    pa_context_rttime_restart (i->pulse_context, i->ramp_event, i->ramp_start);
+}
+
+
+/**
+ * Remembers the monitor source of the sink, the level meter records it.
+ */
+static void
+xvd_set_sink_monitor (XvdInstance *i,
+                      const gchar *name)
+{
+  if (g_strcmp0 (i->sink_monitor, name) == 0)
+    return;
+
+  g_free (i->sink_monitor);
+  i->sink_monitor = g_strdup (name);
+}
+
+
+/**
+ * Stops the running ramp where it is.
+ */
+static void
+xvd_ramp_stop (XvdInstance *i)
+{
+  if (!i->ramp_event)
+    return;
+
+  i->pa_api->time_free (i->ramp_event);
+  i->ramp_event = NULL;
+}
+
+
+/**
+ * Returns the names of the sinks grouped with the default one, or NULL.
+ */
+static gchar **
+xvd_sink_group (XvdInstance *i)
+{
+  XvdSink *sink;
+  guint    n;
+
+  if (!i->sink_groups || i->sink_groups->len == 0)
+    return NULL;
+
+  sink = g_hash_table_lookup (i->sinks, GUINT_TO_POINTER (i->sink_index));
+  if (!sink)
+    return NULL;
+
+  for (n = 0; n < i->sink_groups->len; n++)
+    {
+      gchar **group = g_ptr_array_index (i->sink_groups, n);
+
+      if (g_strv_contains ((const gchar * const *) group, sink->name))
+        return group;
+    }
+
+  return NULL;
+}
+
+
+/**
+ * Returns whether the sink @index is another member of the group of the
+ * default one.
+ */
+static gboolean
+xvd_sink_in_group (XvdInstance *i,
+                   guint32      index)
+{
+  gchar   **group;
+  XvdSink  *sink;
+
+  if (index == i->sink_index)
+    return FALSE;
+
+  group = xvd_sink_group (i);
+  sink = g_hash_table_lookup (i->sinks, GUINT_TO_POINTER (index));
+
+  return group && sink && g_strv_contains ((const gchar * const *) group, sink->name);
+}
+
+
+/**
+ * Sends the current sink volume to the server, and to the other sinks of
+ * its group if any. The requests all go out in the same batch.
+ */
+static void
+xvd_write_volume (XvdInstance *i)
+{
+  gpointer      op = NULL;
+  gchar       **group;
+  guint         n;
+
+  op = XVD_REQUEST (i, set_sink_volume_by_index,
+                    i->sink_index,
+                    &i->volume,
+                    xvd_sink_volume_callback,
+                    i);
+
+  if (!xvd_op_submitted (i, op, XVD_OP_SINK_VOLUME))
+    {
+      g_warning ("xvd_write_volume: failed");
+      return;
+    }
+
+  group = xvd_sink_group (i);
+  for (n = 0; group && group[n]; n++)
+    {
+      XvdSink *member = xvd_devices_find_sink (i->sinks, group[n]);
+
+      if (!member || member->index == i->sink_index)
+        continue;
+
+      /* same level, each member keeps its balance */
+      pa_cvolume_scale (&member->volume, pa_cvolume_max (&i->volume));
+
+      i->stats.ops_issued[XVD_OP_SINK_VOLUME]++;
+      op = XVD_REQUEST (i, set_sink_volume_by_index,
+                        member->index,
+                        &member->volume,
+                        xvd_member_volume_callback,
+                        i);
+      XVD_PROBE2 (op_submit, XVD_OP_SINK_VOLUME, op);
+      if (!op)
+        {
+          i->stats.ops_failed[XVD_OP_SINK_VOLUME]++;
+          g_warning ("xvd_write_volume: failed for %s", member->name);
+          continue;
+        }
+      xvd_request_unref (i, op);
+      i->group_acks++;
+    }
+}
+
+
+/**
+ * Sends the current sink volume right away, ahead of the writes that
+ * follow. A write in flight is given up rather than waited for: the server
+ * answers requests in order, so it still lands before this one.
+ */
+static void
+xvd_write_volume_now (XvdInstance *i)
+{
+  xvd_op_cancel (i, XVD_OP_SINK_VOLUME);
+  xvd_write_volume (i);
+}
+
+
+/**
+ * Toggles the sink mute.
+ */
+static void
+xvd_switch_mute (XvdInstance *i)
+{
+  if (!i)
+   {
+      g_warning ("xvd_switch_mute: invalid argument");
+      return;
+   }
+
+  /* too early, kept for when the sink is known */
+  if (!xvd_pulse_ready (i)
+      || i->sink_index == PA_INVALID_INDEX)
+    {
+      if (!xvd_defer_press (i))
+        return;
+      i->early_mute++;
+      XVD_TRACE (DEFERRED_MUTE, 0, i->early_mute);
+      if (!i->state_cached)
+        return;
+
+      i->mute = !(old_mute = i->mute);
+#ifdef HAVE_LIBNOTIFY
+      xvd_notify_volume_change (i);
+#endif
+      return;
+    }
+
+  /* backup existing mute and update */
+  i->mute = !(old_mute = i->mute);
+
+  /* fade in from silence rather than restoring the volume at once, the
+     silent volume is sent ahead of the unmute: not held back behind a
+     volume write in flight, the unmute would overtake it */
+  if (!i->mute && i->vol_ramp_duration > 0 && !i->ramp_event)
+    {
+      pa_cvolume target = i->volume;
+
+      old_volume = i->volume;
+      pa_cvolume_set (&i->volume, i->volume.channels, PA_VOLUME_MUTED);
+      xvd_write_volume_now (i);
+      xvd_ramp_volume (i, &target);
+    }
+
+  if (!xvd_op_in_flight (i, XVD_OP_SINK_MUTE))
+    xvd_write_mute (i);
+}
+
+
+/**
+ * Sends the current sink mute to the server.
+ */
+static void
+xvd_write_mute (XvdInstance *i)
+{
+  gpointer      op = NULL;
+
+  op =  XVD_REQUEST (i, set_sink_mute_by_index,
+                     i->sink_index,
+                     i->mute,
+                     xvd_sink_mute_callback,
+                     i);
+
+  if (!xvd_op_submitted (i, op, XVD_OP_SINK_MUTE))
+    g_warning ("xvd_write_mute: failed");
+}
+
+
+/**
+ * Toggles the source mute.
+ */
+static void
+xvd_switch_mic_mute (XvdInstance *i)
+{
+  if (!i || !i->pulse_context)
+   {
+      g_warning ("xvd_switch_mic_mute: pulseaudio context is null");
+      return;
+   }
+
+  if (!xvd_pulse_ready (i))
+    {
+      g_warning ("xvd_switch_mic_mute: pulseaudio context isn't ready");
+      return;
+    }
+
+  if (i->source_index == PA_INVALID_INDEX)
+    {
+      g_warning ("xvd_switch_mic_mute: undefined source");
+      return;
+    }
+
+  /* backup existing mute and update */
+  i->mic_mute = !(old_mic_mute = i->mic_mute);
+
+  if (!xvd_op_in_flight (i, XVD_OP_SOURCE_MUTE))
+    xvd_write_mic_mute (i);
+}
+
+
+/**
+ * Sends the current source mute to the server.
+ */
+static void
+xvd_write_mic_mute (XvdInstance *i)
+{
+  gpointer      op = NULL;
+
+  op =  XVD_REQUEST (i, set_source_mute_by_index,
+                     i->source_index,
+                     i->mic_mute,
+                     xvd_source_mute_callback,
+                     i);
+
+  if (!xvd_op_submitted (i, op, XVD_OP_SOURCE_MUTE))
+    g_warning ("xvd_write_mic_mute: failed");
+}
+
+
+/**
+ * Unmutes the source while the push-to-talk key is held, and mutes it
+ * back on release. The state is written at once, neither waiting for an
+ * earlier write to be answered nor for this one, and no notification is
+ * shown.
+ */
+static void
+xvd_switch_push_to_talk (XvdInstance *i,
+                         gboolean     talk)
+{
+  gpointer      op = NULL;
+
+  /* autorepeat, or a release whose press was dropped */
+  if (talk == i->ptt_active)
+    return;
+
+  if (!xvd_pulse_ready (i))
+    {
+      g_warning ("xvd_switch_push_to_talk: pulseaudio context isn't ready");
+      return;
+    }
+
+  if (i->source_index == PA_INVALID_INDEX)
+    {
+      g_warning ("xvd_switch_push_to_talk: undefined source");
+      return;
+    }
+
+  i->ptt_active = talk;
+  old_mic_mute = i->mic_mute = !talk;
+
+  i->stats.ops_issued[XVD_OP_SOURCE_MUTE]++;
+  op = XVD_REQUEST (i, set_source_mute_by_index,
+                    i->source_index,
+                    i->mic_mute,
+                    xvd_ptt_mute_callback,
+                    i);
+  XVD_PROBE2 (op_submit, XVD_OP_SOURCE_MUTE, op);
+  if (!op)
+    {
+      i->stats.ops_failed[XVD_OP_SOURCE_MUTE]++;
+      g_warning ("xvd_switch_push_to_talk: failed");
+      return;
+    }
+  xvd_request_unref (i, op);
+}
+
+
+/**
+ * Counts a mute-everything request on its way to the server.
+ */
+static void
+xvd_mute_all_submitted (XvdInstance  *i,
+                        gpointer      op,
+                        XvdOpType     type)
+{
+  i->stats.ops_issued[type]++;
+  XVD_PROBE2 (op_submit, type, op);
+  if (!op)
+    {
+      i->stats.ops_failed[type]++;
+      i->mute_all_failed = TRUE;
+      g_warning ("xvd_mute_all_submitted: failed");
+      return;
+    }
+  xvd_request_unref (i, op);
+  i->mute_all_acks++;
+}
+
+
+/**
+ * Mutes the sink and the source, or all the sources, together. When
+ * everything is muted already, unmutes it all instead. The requests all
+ * go out before the first answer comes back, and the last answer shows a
+ * single notification.
+ */
+static void
+xvd_switch_mute_all (XvdInstance *i)
+{
+  gpointer      op = NULL;
+  gboolean      mute;
+
+  if (!i || !i->pulse_context)
+   {
+      g_warning ("xvd_switch_mute_all: pulseaudio context is null");
+      return;
+   }
+
+  if (!xvd_pulse_ready (i))
+    {
+      g_warning ("xvd_switch_mute_all: pulseaudio context isn't ready");
+      return;
+    }
+
+  if (i->sink_index == PA_INVALID_INDEX && i->source_index == PA_INVALID_INDEX)
+    {
+      g_warning ("xvd_switch_mute_all: undefined sink and source");
+      return;
+    }
+
+  mute = !(i->mute && i->mic_mute);
+
+  /* no fade in, privacy keys act at once: a fade is cut to its end and
+     sent before the mute, so unmuting later doesn't restore a partly
+     faded volume */
+  if (i->ramp_event)
+    {
+      xvd_ramp_stop (i);
+      i->volume = i->ramp_to;
+      if (i->sink_index != PA_INVALID_INDEX)
+        xvd_write_volume_now (i);
+    }
+
+  old_mute = i->mute;
+  old_mic_mute = i->mic_mute;
+  i->mute = i->mic_mute = mute;
+  i->mute_all_failed = FALSE;
+
+  /* one more answer to wait for, released below once all is sent */
+  i->mute_all_acks++;
+
+  if (i->sink_index != PA_INVALID_INDEX)
+    {
+      op = XVD_REQUEST (i, set_sink_mute_by_index,
+                        i->sink_index,
+                        mute,
+                        xvd_sink_mute_all_callback,
+                        i);
+      xvd_mute_all_submitted (i, op, XVD_OP_SINK_MUTE);
+    }
+
+  if (i->mute_all_sources)
+    {
+      /* the sources are muted as the list comes in */
+      i->stats.introspections++;
+      op = XVD_REQUEST (i, get_source_info_list,
+                        xvd_mute_all_sources_callback,
+                        i);
+      if (op)
+        {
+          xvd_request_unref (i, op);
+          i->mute_all_acks++;
+        }
+      else
+        {
+          i->mute_all_failed = TRUE;
+          g_warning ("xvd_switch_mute_all: failed to list the sources");
+        }
+    }
+  else if (i->source_index != PA_INVALID_INDEX)
+    {
+      op = XVD_REQUEST (i, set_source_mute_by_index,
+                        i->source_index,
+                        mute,
+                        xvd_source_mute_all_callback,
+                        i);
+      xvd_mute_all_submitted (i, op, XVD_OP_SOURCE_MUTE);
+    }
+
+  xvd_mute_all_done (i);
+}
+
+
+gint
+xvd_get_readable_volume (const pa_cvolume *vol)
+{
+  guint new_vol = 0;
+
+  new_vol = 100 * pa_cvolume_avg (vol) / PA_VOLUME_NORM;
+  return MIN (new_vol, 100);
+}
+
+
+/**
+ * This function does the context initialization.
+ */
+static gboolean
+xvd_connect_to_pulse (XvdInstance *i)
+{
+  pa_context_flags_t flags = PA_CONTEXT_NOFAIL;
+
+  i->stats.connect_started = g_get_monotonic_time ();
+
+  if (i->pulse_context)
+    {
+      pa_context_unref (i->pulse_context);
+      i->pulse_context = NULL;
+    }
+
+  i->pulse_context = pa_context_new (i->pa_api,
+                                     XVD_APPNAME);
+  g_assert(i->pulse_context);
+
+  /* the context stays unconnected, the recording answers the requests */
+  if (i->pa_replay)
+    {
+      i->pa_api->defer_new (i->pa_api, xvd_replay_connect_callback, i);
+      return TRUE;
+    }
+
+  pa_context_set_state_callback (i->pulse_context,
+                                 xvd_context_state_callback,
+                                 i);
+
+  if (pa_context_connect (i->pulse_context,
+                          NULL,
+                          flags,
+                          NULL) < 0)
+    {
+      g_warning ("xvd_connect_to_pulse: failed to connect context: %s",
+                 pa_strerror (pa_context_errno (i->pulse_context)));
+      return FALSE;
+    }
+  return TRUE;
+}
+
+
+typedef struct {
+  XvdInstance *inst;
+  XvdWork      work;
+  XvdWorkFunc  func;
+} XvdPulseWork;
+
+
+static gboolean
+xvd_queue_work_in_main (gpointer data)
+{
+  XvdPulseWork *w = (XvdPulseWork *) data;
+
+  xvd_work_queue (w->inst, w->work, w->func);
+  return G_SOURCE_REMOVE;
+}
+
+
+/**
+ * Queues some UI work, from the PulseAudio thread if there's one.
+ */
+static void
+xvd_queue_work (XvdInstance *i,
+                XvdWork      work,
+                XvdWorkFunc  func)
+{
+  XvdPulseWork *w;
+
+  if (!i->pa_threaded_loop)
+    {
+      xvd_work_queue (i, work, func);
+      return;
+    }
+
+  w = g_new (XvdPulseWork, 1);
+  w->inst = i;
+  w->work = work;
+  w->func = func;
+  g_main_context_invoke_full (NULL, G_PRIORITY_DEFAULT, xvd_queue_work_in_main, w, g_free);
+}
+
+
+/**
+ * Writes the state of the default sink for the next start.
+ */
+static void
+xvd_save_state_work (XvdInstance *i)
+{
+  XvdState state;
+
+  /* the replayed sink is not ours to remember */
+  if (i->pa_replay)
+    return;
+
+  memset (&state, 0, sizeof (state));
+  xvd_pulse_lock (i);
+  state.sink_index = i->sink_index;
+  g_strlcpy (state.sink_name, i->sink_name, sizeof (state.sink_name));
+  state.volume = i->volume;
+  state.mute = i->mute;
+  xvd_pulse_unlock (i);
+
+  if (state.sink_index == PA_INVALID_INDEX)
+    return;
+
+  xvd_state_save (&state);
+}
+
+
+/**
+ * Saves the sink state once things settle down.
+ */
+static void
+xvd_state_changed (XvdInstance *i)
+{
+  xvd_queue_work (i, XVD_WORK_SAVE_STATE, xvd_save_state_work);
+}
+
+
+#ifdef HAVE_LIBNOTIFY
+
+
+/**
+ * Copies the state shown by the notifications, the PulseAudio thread
+ * is only held for the copy and never while talking to the notification
+ * server.
+ */
+static void
+xvd_snapshot_osd (XvdInstance *i)
+{
+  xvd_pulse_lock (i);
+  i->osd.volume = i->volume;
+  i->osd.mute = i->mute;
+  i->osd.mic_mute = i->mic_mute;
+  i->osd.kind = i->volume_osd;
+  i->osd.level = g_atomic_int_get (&i->meter_level);
+  i->osd.stream_volume = i->stream_volume;
+  g_strlcpy (i->osd.stream_name, i->stream_name, sizeof (i->osd.stream_name));
+  g_strlcpy (i->osd.device_name, i->device_name, sizeof (i->osd.device_name));
+  xvd_pulse_unlock (i);
+}
+
+
+/**
+ * Refreshes the volume notification with a new level.
+ */
+static void
+xvd_notify_level_work (XvdInstance *i);
+
+
+/**
+ * Records the peaks of the sink monitor, the server computes them so only
+ * one float per period reaches us. The loudest since the last update is
+ * shown when it differs enough from the level on screen.
+ */
+static void
+xvd_meter_read_callback (pa_stream *s,
+                         size_t     length,
+                         void      *userdata)
+{
+  XvdInstance *i = (XvdInstance *) userdata;
+  const void  *data;
+  size_t       len, n;
+  gfloat       peak = 0;
+  gint64       now;
+  gint         level, shown;
+
+  XVD_DISPATCH_TAG ();
+
+  while (pa_stream_readable_size (s) > 0)
+    {
+      if (pa_stream_peek (s, &data, &len) < 0 || len == 0)
+        break;
+
+      /* data is NULL on holes, a late read brings several periods */
+      if (data)
+        for (n = 0; n < len / sizeof (gfloat); n++)
+          peak = MAX (peak, ((const gfloat *) data)[n]);
+      pa_stream_drop (s);
+    }
+
+  i->meter_peak = MAX (i->meter_peak, (gint) CLAMP (peak * 100, 0, 100));
+
+  now = g_get_monotonic_time ();
+  if (now - i->meter_update_time < XVD_METER_UPDATE_USEC)
+    return;
+
+  level = i->meter_peak;
+  i->meter_peak = 0;
+  i->meter_update_time = now;
+
+  shown = g_atomic_int_get (&i->meter_level);
+  if (shown >= 0 && ABS (level - shown) < XVD_METER_UPDATE_CHANGE)
+    return;
+
+  g_atomic_int_set (&i->meter_level, level);
+  xvd_queue_work (i, XVD_WORK_NOTIFY_LEVEL, xvd_notify_level_work);
+}
+
+
+/**
+ * Starts recording the peaks of the sink monitor, if not already.
+ */
+static void
+xvd_meter_connect (XvdInstance *i)
+{
+  pa_sample_spec ss;
+  pa_buffer_attr attr;
+
+  /* a replay has no server to stream the peaks from */
+  if (i->meter_stream || !i->sink_monitor || i->pa_replay
+      || !xvd_pulse_ready (i))
+    return;
+
+  i->meter_peak = 0;
+  i->meter_update_time = 0;
+
+  ss.format = PA_SAMPLE_FLOAT32NE;
+  ss.channels = 1;
+  ss.rate = XVD_METER_RATE;
+
+  memset (&attr, 0, sizeof (attr));
+  attr.maxlength = (uint32_t) -1;
+  attr.fragsize = sizeof (gfloat);
+
+  i->meter_stream = pa_stream_new (i->pulse_context, "Peak detect", &ss, NULL);
+  if (!i->meter_stream)
+    {
+      g_warning ("xvd_meter_connect: failed to create the stream: %s",
+                 pa_strerror (pa_context_errno (i->pulse_context)));
+      return;
+    }
+  pa_stream_set_read_callback (i->meter_stream, xvd_meter_read_callback, i);
+
+  if (pa_stream_connect_record (i->meter_stream,
+                                i->sink_monitor,
+                                &attr,
+                                PA_STREAM_DONT_MOVE | PA_STREAM_PEAK_DETECT
+                                | PA_STREAM_ADJUST_LATENCY | PA_STREAM_DONT_INHIBIT_AUTO_SUSPEND) < 0)
+    {
+      g_warning ("xvd_meter_connect: failed to connect the stream: %s",
+                 pa_strerror (pa_context_errno (i->pulse_context)));
+      xvd_meter_disconnect (i);
+    }
+}
+
+
+/**
+ * Stops recording the sink monitor.
+ */
+static void
+xvd_meter_disconnect (XvdInstance *i)
+{
+  g_atomic_int_set (&i->meter_level, -1);
+
+  if (!i->meter_stream)
+    return;
+
+  pa_stream_set_read_callback (i->meter_stream, NULL, NULL);
+  if (pa_stream_get_state (i->meter_stream) == PA_STREAM_READY
+      || pa_stream_get_state (i->meter_stream) == PA_STREAM_CREATING)
+    pa_stream_disconnect (i->meter_stream);
+  pa_stream_unref (i->meter_stream);
+  i->meter_stream = NULL;
+}
+
+
+static gboolean
+xvd_meter_timeout (gpointer data)
+{
+  XvdInstance *i = (XvdInstance *) data;
+
+  XVD_DISPATCH_TAG ();
+  i->meter_timeout_id = 0;
+  xvd_pulse_stop_meter (i);
+  return G_SOURCE_REMOVE;
+}
+
+
+/**
+ * Runs the level meter for a while after a volume notification.
+ */
+static void
+xvd_start_meter (XvdInstance *i)
+{
+  if (!i->show_level_meter || !i->gauge_notifications)
+    return;
+
+  if (i->meter_timeout_id != 0)
+    g_source_remove (i->meter_timeout_id);
+  i->meter_timeout_id = g_timeout_add (XVD_METER_TIMEOUT, xvd_meter_timeout, i);
+
+  xvd_post_command (i, XVD_CMD_METER, XVD_METER_ON);
+}
+
+
+/**
+ * Shows the volume notification from the current state.
+ */
+static void
+xvd_show_volume_osd (XvdInstance *i)
+{
+  xvd_snapshot_osd (i);
+
+  switch (i->osd.kind)
+    {
+      case XVD_OSD_OVERSHOOT:
+        xvd_notify_overshoot_notification (i);
+      break;
+      case XVD_OSD_UNDERSHOOT:
+        xvd_notify_undershoot_notification (i);
+      break;
+      default:
+        xvd_notify_volume_notification (i);
+      break;
+    }
+}
+
+
+/**
+ * Shows the volume notification decided on the last change.
+ */
+static void
+xvd_notify_volume_work (XvdInstance *i)
+{
+  xvd_show_volume_osd (i);
+  xvd_start_meter (i);
+}
+
+
+static void
+xvd_notify_level_work (XvdInstance *i)
+{
+  /* stopped meanwhile */
+  if (i->meter_timeout_id == 0)
+    return;
+
+  xvd_show_volume_osd (i);
+}
+
+
+/**
+ * Shows the device notification.
+ */
+static void
+xvd_notify_device_work (XvdInstance *i)
+{
+  xvd_snapshot_osd (i);
+  xvd_notify_device_notification (i);
+}
+
+
+/**
+ * Shows the mic notification.
+ */
+static void
+xvd_notify_mic_work (XvdInstance *i)
+{
+  xvd_snapshot_osd (i);
+  xvd_notify_mic_notification (i);
+}
+
+
+/**
+ * Shows the mute-everything notification.
+ */
+static void
+xvd_notify_mute_all_work (XvdInstance *i)
+{
+  xvd_snapshot_osd (i);
+  xvd_notify_mute_all_notification (i);
+}
+
+
+/**
+ * Shows the stream volume notification.
+ */
+static void
+xvd_notify_stream_work (XvdInstance *i)
+{
+  xvd_snapshot_osd (i);
+  xvd_notify_stream_notification (i);
+}
+
+
+/**
+ * Notifies a change once the server confirmed it.
+ */
+static void
+xvd_notify_volume_callback (pa_context *c,
+                            int         success,
+                            void       *userdata)
+{
+  XvdInstance  *i = (XvdInstance *) userdata;
+
+  XVD_DISPATCH_TAG ();
+
+  if (!c || !userdata)
+    {
+      g_warning ("xvd_notify_volume_callback: invalid argument");
+      return;
+    }
+
+  if (!success)
+    {
+      g_warning ("xvd_notify_volume_callback: operation failed, %s",
+                 pa_strerror (pa_context_errno (c)));
+      return;
+    }
+
+  xvd_notify_volume_change (i);
+}
+
+
+/**
+ * Decides the type of notification to show on a change.
+ */
+static void
+xvd_notify_volume_change (XvdInstance *i)
+{
+  guint32 r_oldv, r_curv;
+
+  r_oldv = xvd_get_readable_volume (&old_volume);
+  r_curv = xvd_get_readable_volume (&i->volume);
+
+  /* the sink was (un)muted */
+  if (old_mute != i->mute)
+    i->volume_osd = XVD_OSD_VOLUME;
+  /* trying to go above 100 */
+  else if (r_oldv == 100 && r_curv >= r_oldv)
+    i->volume_osd = XVD_OSD_OVERSHOOT;
+  /* trying to go below 0 */
+  else if (r_oldv == 0 && r_curv <= r_oldv)
+    i->volume_osd = XVD_OSD_UNDERSHOOT;
+  /* normal */
+  else
+    i->volume_osd = XVD_OSD_VOLUME;
+
+  /* the OSD waits until pending key presses have been served */
+  xvd_queue_work (i, XVD_WORK_NOTIFY_VOLUME, xvd_notify_volume_work);
+}
+
+
+/**
+ * Shows Mic mute status notification
+ */
+static void
+xvd_notify_mic_callback (pa_context *c,
+                            int         success,
+                            void       *userdata)
+{
+  XvdInstance *i = (XvdInstance *) userdata;
+
+  XVD_DISPATCH_TAG ();
+
+  if (!c || !userdata)
+    {
+      g_warning ("xvd_notify_mic_callback: invalid argument");
+      return;
+    }
+
+  if (!success)
+    {
+      g_warning ("xvd_notify_mic_callback: operation failed, %s",
+                 pa_strerror (pa_context_errno (c)));
+      return;
+    }
+
+  /* the sink was (un)muted */
+  if (old_mic_mute != i->mic_mute)
+    xvd_queue_work (i, XVD_WORK_NOTIFY_MIC, xvd_notify_mic_work);
+}
+#endif
+
+
+void
+xvd_pulse_start_meter (XvdInstance *i)
+{
+#ifdef HAVE_LIBNOTIFY
+  xvd_start_meter (i);
+#endif
+}
+
+
+void
+xvd_pulse_stop_meter (XvdInstance *i)
+{
+#ifdef HAVE_LIBNOTIFY
+  if (i->meter_timeout_id != 0)
+    {
+      g_source_remove (i->meter_timeout_id);
+      i->meter_timeout_id = 0;
+    }
+  g_atomic_int_set (&i->meter_level, -1);
+  xvd_post_command (i, XVD_CMD_METER, XVD_METER_OFF);
+#endif
+}
+
+
+/**
+ * Callback for the completion of a sink volume change.
+ */
+static void
+xvd_sink_volume_callback (pa_context *c,
+                          int         success,
+                          void       *userdata)
+{
+  XvdInstance *i = (XvdInstance *) userdata;
+
+  XVD_DISPATCH_TAG ();
+
+  if (!c || !userdata)
     {
-      g_warning ("xvd_update_volume: pulseaudio context isn't ready");
+      g_warning ("xvd_sink_volume_callback: invalid argument");
       return;
     }
 
-  if (i->sink_index == PA_INVALID_INDEX)
+  /* a newer state is waiting, the notification will be about it */
+  if (xvd_op_release (i, XVD_OP_SINK_VOLUME))
     {
-      g_warning ("xvd_update_volume: undefined sink");
+      xvd_write_volume (i);
       return;
     }
 
-  /* backup */
-  old_volume = i->volume;
+  if (!xvd_op_succeeded (c, success, i, XVD_OP_SINK_VOLUME))
+    return;
 
-  switch (d)
-    {
-      case XVD_UP:
-        pa_cvolume_inc_clamp (&i->volume,
-                              XVD_PA_VOLUME_STEP(i->vol_step),
-                              PA_VOLUME_NORM);
-      break;
-      case XVD_DOWN:
-        pa_cvolume_dec (&i->volume,
-                        XVD_PA_VOLUME_STEP(i->vol_step));
-      break;
-      default:
-        g_warning ("xvd_update_volume: invalid direction");
-        return;
-      break;
-    }
+  /* a running ramp is notified once, when it ends */
+  if (i->ramp_event)
+    return;
 
-  op = pa_context_set_sink_volume_by_index (i->pulse_context,
-                                            i->sink_index,
-                                            &i->volume,
-                                            xvd_notify_volume_callback,
-                                            i);
+  xvd_state_changed (i);
 
-  if (!op)
+  /* the other sinks of the group answer after us, the last one notifies */
+  if (i->group_acks > 0)
     {
-      g_warning ("xvd_update_volume: failed");
+      i->group_notify = TRUE;
       return;
     }
-  pa_operation_unref (op);
+
+#ifdef HAVE_LIBNOTIFY
+  xvd_notify_volume_callback (c, success, i);
+#endif
 }
 
 
-void
-xvd_toggle_mute (XvdInstance *i)
+/**
+ * Callback for the completion of a volume change on a grouped sink.
+ */
+static void
+xvd_member_volume_callback (pa_context *c,
+                            int         success,
+                            void       *userdata)
 {
-  pa_operation *op = NULL;
+  XvdInstance *i = (XvdInstance *) userdata;
 
-  if (!i || !i->pulse_context)
-   {
-      g_warning ("xvd_toggle_mute: pulseaudio context is null");
-      return;
-   }
+  XVD_DISPATCH_TAG ();
 
-  if (pa_context_get_state (i->pulse_context) != PA_CONTEXT_READY)
+  if (!c || !userdata)
     {
-      g_warning ("xvd_toggle_mute: pulseaudio context isn't ready");
+      g_warning ("xvd_member_volume_callback: invalid argument");
       return;
     }
 
-  if (i->sink_index == PA_INVALID_INDEX)
-    {
-      g_warning ("xvd_toggle_mute: undefined sink");
-      return;
-    }
+  if (i->group_acks > 0)
+    i->group_acks--;
 
-  /* backup existing mute and update */
-  i->mute = !(old_mute = i->mute);
+  xvd_op_succeeded (c, success, i, XVD_OP_SINK_VOLUME);
 
-  op =  pa_context_set_sink_mute_by_index (i->pulse_context,
-                                           i->sink_index,
-                                           i->mute,
-                                           xvd_notify_volume_callback,
-                                           i);
+  if (i->group_acks > 0 || !i->group_notify)
+    return;
 
-  if (!op)
-    {
-      g_warning ("xvd_toggle_mute: failed");
-      return;
-    }
-  pa_operation_unref (op);
+  i->group_notify = FALSE;
+#ifdef HAVE_LIBNOTIFY
+  xvd_notify_volume_callback (c, 1, i);
+#endif
 }
 
 
-void
-xvd_toggle_mic_mute (XvdInstance *i)
+/**
+ * Counts an answer to a mute-everything request, the last one notifies.
+ */
+static void
+xvd_mute_all_done (XvdInstance *i)
 {
-  pa_operation *op = NULL;
+  if (i->mute_all_acks == 0 || --i->mute_all_acks > 0)
+    return;
 
-  if (!i || !i->pulse_context)
-   {
-      g_warning ("xvd_toggle_mic_mute: pulseaudio context is null");
-      return;
-   }
+  if (i->mute_all_failed)
+    return;
 
-  if (pa_context_get_state (i->pulse_context) != PA_CONTEXT_READY)
-    {
-      g_warning ("xvd_toggle_mic_mute: pulseaudio context isn't ready");
-      return;
-    }
+#ifdef HAVE_LIBNOTIFY
+  xvd_queue_work (i, XVD_WORK_NOTIFY_MUTE_ALL, xvd_notify_mute_all_work);
+#endif
+}
 
-  if (i->source_index == PA_INVALID_INDEX)
+
+/**
+ * Callback for the completion of a sink mute for mute-everything.
+ */
+static void
+xvd_sink_mute_all_callback (pa_context *c,
+                            int         success,
+                            void       *userdata)
+{
+  XvdInstance *i = (XvdInstance *) userdata;
+
+  XVD_DISPATCH_TAG ();
+
+  if (!c || !userdata)
     {
-      g_warning ("xvd_toggle_mic_mute: undefined source");
+      g_warning ("xvd_sink_mute_all_callback: invalid argument");
       return;
     }
 
-  /* backup existing mute and update */
-  i->mic_mute = !(old_mic_mute = i->mic_mute);
+  if (!xvd_op_succeeded (c, success, i, XVD_OP_SINK_MUTE))
+    i->mute_all_failed = TRUE;
+
+  xvd_mute_all_done (i);
+}
 
-  op =  pa_context_set_source_mute_by_index (i->pulse_context,
-                                             i->source_index,
-                                             i->mic_mute,
-                                             xvd_notify_mic_callback,
-                                             i);
 
-  if (!op)
+/**
+ * Callback for the completion of a push-to-talk mute change.
+ */
+static void
+xvd_ptt_mute_callback (pa_context *c,
+                       int         success,
+                       void       *userdata)
+{
+  XvdInstance *i = (XvdInstance *) userdata;
+
+  XVD_DISPATCH_TAG ();
+
+  if (!c || !userdata)
     {
-      g_warning ("xvd_toggle_mic_mute: failed");
+      g_warning ("xvd_ptt_mute_callback: invalid argument");
       return;
     }
-  pa_operation_unref (op);
+
+  xvd_op_succeeded (c, success, i, XVD_OP_SOURCE_MUTE);
 }
 
 
-gint
-xvd_get_readable_volume (const pa_cvolume *vol)
+/**
+ * Callback for the completion of a source mute for mute-everything.
+ */
+static void
+xvd_source_mute_all_callback (pa_context *c,
+                              int         success,
+                              void       *userdata)
 {
-  guint new_vol = 0;
+  XvdInstance *i = (XvdInstance *) userdata;
 
-  new_vol = 100 * pa_cvolume_avg (vol) / PA_VOLUME_NORM;
-  return MIN (new_vol, 100);
+  XVD_DISPATCH_TAG ();
+
+  if (!c || !userdata)
+    {
+      g_warning ("xvd_source_mute_all_callback: invalid argument");
+      return;
+    }
+
+  if (!xvd_op_succeeded (c, success, i, XVD_OP_SOURCE_MUTE))
+    i->mute_all_failed = TRUE;
+
+  xvd_mute_all_done (i);
 }
 
 
 /**
- * This function does the context initialization.
+ * Mutes each source of the list for mute-everything, monitors excepted.
  */
-static gboolean
-xvd_connect_to_pulse (XvdInstance *i)
+static void
+xvd_mute_all_sources_callback (pa_context           *c,
+                               const pa_source_info *info,
+                               int                   eol,
+                               void                 *userdata)
 {
-  pa_context_flags_t flags = PA_CONTEXT_NOFAIL;
+  XvdInstance  *i = (XvdInstance *) userdata;
+  gpointer      op = NULL;
 
-  if (i->pulse_context)
+  XVD_DISPATCH_TAG ();
+
+  if (!c || !userdata)
     {
-      pa_context_unref (i->pulse_context);
-      i->pulse_context = NULL;
+      g_warning ("xvd_mute_all_sources_callback: invalid argument");
+      return;
     }
 
-  i->pulse_context = pa_context_new (pa_glib_mainloop_get_api (i->pa_main_loop),
-                                     XVD_APPNAME);
-  g_assert(i->pulse_context);
-  pa_context_set_state_callback (i->pulse_context,
-                                 xvd_context_state_callback,
-                                 i);
-
-  if (pa_context_connect (i->pulse_context,
-                          NULL,
-                          flags,
-                          NULL) < 0)
+  if (eol != 0)
     {
-      g_warning ("xvd_connect_to_pulse: failed to connect context: %s",
-                 pa_strerror (pa_context_errno (i->pulse_context)));
-      return FALSE;
+      if (eol < 0)
+        i->mute_all_failed = TRUE;
+      xvd_mute_all_done (i);
+      return;
     }
-  return TRUE;
+
+  if (!info)
+    return;
+  xvd_record_source (info);
+  if (info->monitor_of_sink != PA_INVALID_INDEX)
+    return;
+
+  op = XVD_REQUEST (i, set_source_mute_by_index,
+                    info->index,
+                    i->mic_mute,
+                    xvd_source_mute_all_callback,
+                    i);
+  xvd_mute_all_submitted (i, op, XVD_OP_SOURCE_MUTE);
 }
 
 
-#ifdef HAVE_LIBNOTIFY
 /**
- * Decides the type of notification to show on a change.
+ * Callback for the completion of a sink mute change.
  */
 static void
-xvd_notify_volume_callback (pa_context *c,
-                            int         success,
-                            void       *userdata)
+xvd_sink_mute_callback (pa_context *c,
+                        int         success,
+                        void       *userdata)
 {
-  XvdInstance  *i = (XvdInstance *) userdata;
-  guint32       r_oldv, r_curv;
+  XvdInstance *i = (XvdInstance *) userdata;
+
+  XVD_DISPATCH_TAG ();
 
   if (!c || !userdata)
     {
-      g_warning ("xvd_notify_volume_callback: invalid argument");
+      g_warning ("xvd_sink_mute_callback: invalid argument");
       return;
     }
 
-  if (!success)
+  /* a newer state is waiting, the notification will be about it */
+  if (xvd_op_release (i, XVD_OP_SINK_MUTE))
     {
-      g_warning ("xvd_notify_volume_callback: operation failed, %s",
-                 pa_strerror (pa_context_errno (c)));
+      xvd_write_mute (i);
       return;
     }
 
-  /* the sink was (un)muted */
-  if (old_mute != i->mute)
+  if (!xvd_op_succeeded (c, success, i, XVD_OP_SINK_MUTE))
+    return;
+
+  if (i->ramp_event)
+    return;
+
+  xvd_state_changed (i);
+
+#ifdef HAVE_LIBNOTIFY
+  xvd_notify_volume_callback (c, success, i);
+#endif
+}
+
+
+/**
+ * Callback for the completion of a source mute change.
+ */
+static void
+xvd_source_mute_callback (pa_context *c,
+                          int         success,
+                          void       *userdata)
+{
+  XvdInstance *i = (XvdInstance *) userdata;
+
+  XVD_DISPATCH_TAG ();
+
+  if (!c || !userdata)
     {
-      xvd_notify_volume_notification (i);
+      g_warning ("xvd_source_mute_callback: invalid argument");
       return;
     }
 
-  r_oldv = xvd_get_readable_volume (&old_volume);
-  r_curv = xvd_get_readable_volume (&i->volume);
+  /* a newer state is waiting, the notification will be about it */
+  if (xvd_op_release (i, XVD_OP_SOURCE_MUTE))
+    {
+      xvd_write_mic_mute (i);
+      return;
+    }
 
-  /* trying to go above 100 */
-  if (r_oldv == 100 && r_curv >= r_oldv)
-    xvd_notify_overshoot_notification (i);
-  /* trying to go below 0 */
-  else if (r_oldv == 0 && r_curv <= r_oldv)
-   xvd_notify_undershoot_notification (i);
-  /* normal */
-  else
-   xvd_notify_volume_notification (i);
+  if (!xvd_op_succeeded (c, success, i, XVD_OP_SOURCE_MUTE))
+    return;
+
+#ifdef HAVE_LIBNOTIFY
+  xvd_notify_mic_callback (c, success, i);
+#endif
 }
 
 
 /**
- * Shows Mic mute status notification
+ * Callback for the completion of a stream volume change.
  */
 static void
-xvd_notify_mic_callback (pa_context *c,
+xvd_stream_volume_callback (pa_context *c,
                             int         success,
                             void       *userdata)
 {
   XvdInstance *i = (XvdInstance *) userdata;
 
+  XVD_DISPATCH_TAG ();
+
   if (!c || !userdata)
     {
-      g_warning ("xvd_notify_mic_callback: invalid argument");
+      g_warning ("xvd_stream_volume_callback: invalid argument");
       return;
     }
 
-  if (!success)
+  /* a newer state is waiting, the notification will be about it */
+  if (xvd_op_release (i, XVD_OP_STREAM_VOLUME))
     {
-      g_warning ("xvd_notify_mic_callback: operation failed, %s",
-                 pa_strerror (pa_context_errno (c)));
+      xvd_write_stream_volume (i);
       return;
     }
 
-  /* the sink was (un)muted */
-  if (old_mic_mute != i->mic_mute)
-    {
-      xvd_notify_mic_notification (i);
-      return;
-    }
-}
+  if (!xvd_op_succeeded (c, success, i, XVD_OP_STREAM_VOLUME))
+    return;
+
+#ifdef HAVE_LIBNOTIFY
+  xvd_queue_work (i, XVD_WORK_NOTIFY_STREAM, xvd_notify_stream_work);
 #endif
+}
 
 
 /**
@@ -398,7 +2284,9 @@ xvd_subscribed_events_callback (pa_context                     *c,
                                 void                           *userdata)
 {
   XvdInstance  *i = (XvdInstance *) userdata;
-  pa_operation *op = NULL;
+  gpointer      op = NULL;
+
+  XVD_DISPATCH_TAG ();
 
   if (!c || !userdata)
     {
@@ -406,75 +2294,190 @@ xvd_subscribed_events_callback (pa_context                     *c,
       return;
     }
 
+  XVD_TRACE (SERVER_EVENT, index, t);
+  XVD_PROBE2 (server_event, t, index);
+  xvd_record_event (t, index);
+
   switch (t & PA_SUBSCRIPTION_EVENT_FACILITY_MASK)
     {
       /* change on a sink, re-fetch it */
       case PA_SUBSCRIPTION_EVENT_SINK:
+        i->stats.events[XVD_FACILITY_SINK]++;
+        if ((t & PA_SUBSCRIPTION_EVENT_TYPE_MASK) == PA_SUBSCRIPTION_EVENT_REMOVE)
+          xvd_devices_remove (i->sinks, index);
+
+        /* a device was plugged, the hotplug policy may want it */
+        if ((t & PA_SUBSCRIPTION_EVENT_TYPE_MASK) == PA_SUBSCRIPTION_EVENT_NEW)
+          {
+             i->stats.introspections++;
+             op = XVD_REQUEST (i, get_sink_info_by_index,
+                               index,
+                               xvd_new_sink_callback,
+                               userdata);
+
+             if (!op)
+               {
+                 g_warning ("xvd_subscribed_events_callback: failed to get sink info");
+                 return;
+               }
+             xvd_request_unref (i, op);
+             return;
+          }
+
+        /* the group keeps the balance of each member, keep it up to date */
+        if ((t & PA_SUBSCRIPTION_EVENT_TYPE_MASK) == PA_SUBSCRIPTION_EVENT_CHANGE
+            && xvd_sink_in_group (i, index))
+          {
+             i->stats.introspections++;
+             op = XVD_REQUEST (i, get_sink_info_by_index,
+                               index,
+                               xvd_member_sink_callback,
+                               userdata);
+
+             if (!op)
+               {
+                 g_warning ("xvd_subscribed_events_callback: failed to get sink info");
+                 return;
+               }
+             xvd_request_unref (i, op);
+             return;
+          }
+
         if (i->sink_index != index)
           return;
 
         if ((t & PA_SUBSCRIPTION_EVENT_TYPE_MASK) == PA_SUBSCRIPTION_EVENT_REMOVE)
-          i->sink_index = PA_INVALID_INDEX;
+          {
+            i->sink_index = PA_INVALID_INDEX;
+            xvd_ramp_stop (i);
+            xvd_op_cancel (i, XVD_OP_SINK_VOLUME);
+            xvd_op_cancel (i, XVD_OP_SINK_MUTE);
+          }
         else
           {
-             op = pa_context_get_sink_info_by_index (c,
-                                                     index,
-                                                     xvd_update_sink_callback,
-                                                     userdata);
+             i->stats.introspections++;
+             op = XVD_REQUEST (i, get_sink_info_by_index,
+                               index,
+                               xvd_update_sink_callback,
+                               userdata);
 
              if (!op)
                {
                  g_warning ("xvd_subscribed_events_callback: failed to get sink info");
                  return;
                }
-             pa_operation_unref (op);
+             xvd_request_unref (i, op);
           }
       break;
       /* change on a source, re-fetch it */
       case PA_SUBSCRIPTION_EVENT_SOURCE:
+        i->stats.events[XVD_FACILITY_SOURCE]++;
         if (i->source_index != index)
           return;
 
         if ((t & PA_SUBSCRIPTION_EVENT_TYPE_MASK) == PA_SUBSCRIPTION_EVENT_REMOVE)
-          i->source_index = PA_INVALID_INDEX;
+          {
+            i->source_index = PA_INVALID_INDEX;
+            xvd_op_cancel (i, XVD_OP_SOURCE_MUTE);
+          }
         else
           {
-             op = pa_context_get_source_info_by_index (c,
-                                                       index,
-                                                       xvd_update_source_callback,
-                                                       userdata);
+             i->stats.introspections++;
+             op = XVD_REQUEST (i, get_source_info_by_index,
+                               index,
+                               xvd_update_source_callback,
+                               userdata);
 
              if (!op)
                {
                  g_warning ("xvd_subscribed_events_callback: failed to get source info");
                  return;
                }
-             pa_operation_unref (op);
+             xvd_request_unref (i, op);
           }
       break;
-      /* change on the server, re-fetch everything */
-      case PA_SUBSCRIPTION_EVENT_SERVER:
-        op = pa_context_get_server_info (c,
-                                         xvd_server_info_callback,
-                                         userdata);
+      /* a stream came, changed or went, keep the table current */
+      case PA_SUBSCRIPTION_EVENT_SINK_INPUT:
+        i->stats.events[XVD_FACILITY_SINK_INPUT]++;
+        if ((t & PA_SUBSCRIPTION_EVENT_TYPE_MASK) == PA_SUBSCRIPTION_EVENT_REMOVE)
+          {
+            xvd_streams_remove (i->streams, index);
+            if (i->stream_index == index)
+              xvd_op_cancel (i, XVD_OP_STREAM_VOLUME);
+          }
+        else
+          {
+             i->stats.introspections++;
+             op = XVD_REQUEST (i, get_sink_input_info,
+                               index,
+                               xvd_sink_input_info_callback,
+                               userdata);
 
-        if (!op)
+             if (!op)
+               {
+                 g_warning ("xvd_subscribed_events_callback: failed to get sink input info");
+                 return;
+               }
+             xvd_request_unref (i, op);
+          }
+      break;
+      /* a card came, went or changed its ports and profiles */
+      case PA_SUBSCRIPTION_EVENT_CARD:
+        i->stats.events[XVD_FACILITY_CARD]++;
+        if ((t & PA_SUBSCRIPTION_EVENT_TYPE_MASK) == PA_SUBSCRIPTION_EVENT_REMOVE)
+          xvd_devices_remove (i->cards, index);
+        else
           {
-            g_warning("xvd_subscribed_events_callback: failed to get server info");
-            return;
+             i->stats.introspections++;
+             op = XVD_REQUEST (i, get_card_info_by_index,
+                               index,
+                               xvd_card_info_callback,
+                               userdata);
+
+             if (!op)
+               {
+                 g_warning ("xvd_subscribed_events_callback: failed to get card info");
+                 return;
+               }
+             xvd_request_unref (i, op);
           }
-        pa_operation_unref(op);
+      break;
+      /* change on the server, the defaults may have moved */
+      case PA_SUBSCRIPTION_EVENT_SERVER:
+        i->stats.events[XVD_FACILITY_SERVER]++;
+        xvd_fetch_defaults (c, i);
+      break;
+      default:
+        i->stats.events[XVD_FACILITY_OTHER]++;
       break;
     }
 }
 
 
+void
+xvd_pulse_inject_event (XvdInstance *i,
+                        guint32      t,
+                        guint32      index)
+{
+  xvd_pulse_lock (i);
+  if (xvd_pulse_ready (i))
+    xvd_subscribed_events_callback (i->pulse_context, t, index, i);
+  xvd_pulse_unlock (i);
+}
+
+
 static gboolean
 xvd_connect_to_pulse_idle (gpointer data)
 {
   XvdInstance *i = data;
+
+  XVD_DISPATCH_TAG ();
+  xvd_pulse_lock (i);
+  i->stats.reconnects++;
+  XVD_PROBE0 (reconnect);
   xvd_connect_to_pulse(i);
   i->reconnect_id = 0;
+  xvd_pulse_unlock (i);
   return FALSE;
 }
 
@@ -487,15 +2490,19 @@ xvd_context_state_callback (pa_context *c,
                             void       *userdata)
 {
   XvdInstance           *i = (XvdInstance *) userdata;
-  pa_subscription_mask_t mask = PA_SUBSCRIPTION_MASK_SINK | PA_SUBSCRIPTION_MASK_SOURCE | PA_SUBSCRIPTION_MASK_SERVER;
+  pa_subscription_mask_t mask = PA_SUBSCRIPTION_MASK_SINK | PA_SUBSCRIPTION_MASK_SOURCE | PA_SUBSCRIPTION_MASK_SINK_INPUT | PA_SUBSCRIPTION_MASK_SERVER | PA_SUBSCRIPTION_MASK_CARD;
   pa_operation          *op = NULL;
 
+  XVD_DISPATCH_TAG ();
+
   if (!c || !userdata)
     {
       g_critical ("xvd_context_state_callback: invalid argument");
       return;
     }
 
+  XVD_PROBE1 (context_state, pa_context_get_state (c));
+
   switch (pa_context_get_state (c))
     {
       case PA_CONTEXT_UNCONNECTED:
@@ -513,11 +2520,37 @@ xvd_context_state_callback (pa_context *c,
       case PA_CONTEXT_TERMINATED:
         g_debug ("xvd_context_state_callback: The connection was terminated cleanly");
         i->sink_index = PA_INVALID_INDEX;
+        g_hash_table_remove_all (i->streams);
+        g_hash_table_remove_all (i->cards);
+        g_hash_table_remove_all (i->sinks);
+        i->group_acks = 0;
+        i->group_notify = FALSE;
+        i->mute_all_acks = 0;
+        i->ptt_active = FALSE;
+#ifdef HAVE_LIBNOTIFY
+        xvd_meter_disconnect (i);
+#endif
+        xvd_ramp_stop (i);
+        xvd_op_cancel_all (i);
+        xvd_stats_set_connected (i, FALSE);
       break;
       case PA_CONTEXT_FAILED:
         g_warning("xvd_context_state_callback: The connection failed or was disconnected, is PulseAudio Daemon running? Try to reconnect once in a few seconds.");
         i->sink_index = PA_INVALID_INDEX;
         i->source_index = PA_INVALID_INDEX;
+        g_hash_table_remove_all (i->streams);
+        g_hash_table_remove_all (i->cards);
+        g_hash_table_remove_all (i->sinks);
+        i->group_acks = 0;
+        i->group_notify = FALSE;
+        i->mute_all_acks = 0;
+        i->ptt_active = FALSE;
+#ifdef HAVE_LIBNOTIFY
+        xvd_meter_disconnect (i);
+#endif
+        xvd_ramp_stop (i);
+        xvd_op_cancel_all (i);
+        xvd_stats_set_connected (i, FALSE);
         i->reconnect_id = g_timeout_add_seconds(5, xvd_connect_to_pulse_idle, i);
       break;
       case PA_CONTEXT_READY:
@@ -526,7 +2559,7 @@ xvd_context_state_callback (pa_context *c,
                                            xvd_subscribed_events_callback,
                                            userdata);
 
-        /* subscribe to sink/source and server changes, we don't need more */
+        /* subscribe to sink/source, stream, card and server changes, we don't need more */
         op = pa_context_subscribe (c,
                                    mask,
                                    NULL,
@@ -539,102 +2572,252 @@ xvd_context_state_callback (pa_context *c,
           }
         pa_operation_unref(op);
 
-        op = pa_context_get_server_info (c,
-                                         xvd_server_info_callback,
-                                         userdata);
-
-        if (!op)
-          {
-            g_warning("xvd_context_state_callback: pa_context_get_server_info() failed");
-            return;
-          }
-        pa_operation_unref(op);
+        xvd_context_ready (i);
       break;
     }
 }
 
 
 /**
- * Callback to retrieve server infos (mostly, the default sink).
+ * Asks for everything the daemon tracks once connected.
  */
 static void
-xvd_server_info_callback (pa_context           *c,
-                          const pa_server_info *info,
-                          void                 *userdata)
+xvd_context_ready (XvdInstance *i)
 {
-  pa_operation *op = NULL;
+  pa_context *c = i->pulse_context;
+
+  xvd_stats_set_connected (i, TRUE);
+  /* the lists of a previous connection won't be answered */
+  i->sink_list_pending = FALSE;
+  i->source_list_pending = FALSE;
+
+  /* don't wait for each reply before asking the next question, the
+     server answers in order and the callbacks sort it out */
+  xvd_fetch_defaults (c, i);
+  xvd_fetch_sinks (c, i);
+  xvd_fetch_sources (c, i);
+  xvd_fetch_sink_inputs (c, i);
+  xvd_fetch_cards (c, i);
+}
 
-  if (!c || !userdata)
+
+/**
+ * Connects to the recorded server of a replay, from the PulseAudio loop
+ * like the state callback.
+ */
+static void
+xvd_replay_connect_callback (pa_mainloop_api *api,
+                             pa_defer_event  *e,
+                             void            *userdata)
+{
+  XvdInstance *i = (XvdInstance *) userdata;
+
+  XVD_DISPATCH_TAG ();
+
+  api->defer_free (e);
+  g_debug ("xvd_replay_connect_callback: replaying a recorded server");
+  i->pa_replay_ready = TRUE;
+  xvd_context_ready (i);
+  xvd_replay_connected (i);
+}
+
+
+/**
+ * Looks up the default sink and source, the requests go out together.
+ */
+static void
+xvd_fetch_defaults (pa_context  *c,
+                    XvdInstance *i)
+{
+  gpointer      op = NULL;
+
+  i->stats.introspections++;
+  op = XVD_REQUEST (i, get_sink_info_by_name,
+                    "@DEFAULT_SINK@",
+                    xvd_default_sink_info_callback,
+                    i);
+  if (!op)
+    g_warning ("xvd_fetch_defaults: pa_context_get_sink_info_by_name() failed");
+  else
+    xvd_request_unref (i, op);
+
+  i->stats.introspections++;
+  op = XVD_REQUEST (i, get_source_info_by_name,
+                    "@DEFAULT_SOURCE@",
+                    xvd_default_source_info_callback,
+                    i);
+  if (!op)
+    g_warning ("xvd_fetch_defaults: pa_context_get_source_info_by_name() failed");
+  else
+    xvd_request_unref (i, op);
+}
+
+
+/**
+ * Lists all sinks, in case there's no default one. A list already on its
+ * way answers for this one.
+ */
+static void
+xvd_fetch_sinks (pa_context  *c,
+                 XvdInstance *i)
+{
+  gpointer      op = NULL;
+
+  if (i->sink_list_pending)
+    return;
+
+  i->stats.introspections++;
+  op = XVD_REQUEST (i, get_sink_info_list,
+                    xvd_sink_info_callback,
+                    i);
+  if (!op)
+    g_warning ("xvd_fetch_sinks: pa_context_get_sink_info_list() failed");
+  else
     {
-      g_warning ("xvd_server_info_callback: invalid argument");
-      return;
+      i->sink_list_pending = TRUE;
+      xvd_request_unref (i, op);
     }
+}
 
-  if (!info)
+
+/**
+ * Lists all sources, in case there's no default one. A list already on
+ * its way answers for this one.
+ */
+static void
+xvd_fetch_sources (pa_context  *c,
+                   XvdInstance *i)
+{
+  gpointer      op = NULL;
+
+  if (i->source_list_pending)
+    return;
+
+  i->stats.introspections++;
+  op = XVD_REQUEST (i, get_source_info_list,
+                    xvd_source_info_callback,
+                    i);
+  if (!op)
+    g_warning ("xvd_fetch_sources: pa_context_get_source_info_list() failed");
+  else
     {
-      g_warning("xvd_server_info_callback: No PulseAudio server");
-      return;
+      i->source_list_pending = TRUE;
+      xvd_request_unref (i, op);
     }
+}
 
-  if (info->default_sink_name)
-    {
-      op = pa_context_get_sink_info_by_name (c,
-                                             info->default_sink_name,
-                                             xvd_default_sink_info_callback,
-                                             userdata);
 
-      if (!op)
-        {
-          g_warning("xvd_server_info_callback: pa_context_get_sink_info_by_name() failed");
-          return;
-        }
-      pa_operation_unref (op);
-    }
+/**
+ * Lists the streams already playing, the events tell about the others.
+ */
+static void
+xvd_fetch_sink_inputs (pa_context  *c,
+                       XvdInstance *i)
+{
+  gpointer      op = NULL;
+
+  i->stats.introspections++;
+  op = XVD_REQUEST (i, get_sink_input_info_list,
+                    xvd_sink_input_info_callback,
+                    i);
+  if (!op)
+    g_warning ("xvd_fetch_sink_inputs: pa_context_get_sink_input_info_list() failed");
   else
-    {
-      /* when PulseAudio doesn't set a default sink, look at all of them
-         and hope to find a usable one */
-      op = pa_context_get_sink_info_list(c,
-                                         xvd_sink_info_callback,
-                                         userdata);
+    xvd_request_unref (i, op);
+}
 
-      if (!op)
-        {
-          g_warning("xvd_server_info_callback: pa_context_get_sink_info_list() failed");
-          return;
-        }
-      pa_operation_unref (op);
-    }
 
-  if (info->default_source_name)
-    {
-      op = pa_context_get_source_info_by_name (c,
-                                               info->default_source_name,
-                                               xvd_default_source_info_callback,
-                                               userdata);
+/**
+ * Callback to retrieve the infos of streams.
+ */
+static void
+xvd_sink_input_info_callback (pa_context               *c,
+                              const pa_sink_input_info *info,
+                              int                       eol,
+                              void                     *userdata)
+{
+  XvdInstance *i = (XvdInstance *) userdata;
+  XvdStream   *stream;
 
-      if (!op)
-        {
-          g_warning("xvd_server_info_callback: pa_context_get_source_info_by_name() failed");
-          return;
-        }
-      pa_operation_unref (op);
+  XVD_DISPATCH_TAG ();
+
+  /* detect the end of the list, or a stream gone meanwhile */
+  if (eol != 0)
+    return;
+
+  if (!userdata || !info)
+    {
+      g_warning ("xvd_sink_input_info_callback: invalid argument");
+      return;
     }
+  xvd_record_sink_input (info);
+
+  stream = xvd_streams_update (i->streams, info);
+
+  /* our own newer volume is still on its way to the server */
+  if (i->pending[XVD_OP_STREAM_VOLUME].op && stream->index == i->stream_index)
+    stream->volume = i->stream_volume;
+}
+
+
+/**
+ * Called when a usable sink is known, accounts for the connection latency.
+ */
+static void
+xvd_sink_resolved (XvdInstance *i)
+{
+  if (i->stats.connect_started == 0)
+    return;
+
+  i->stats.connect_latency = g_get_monotonic_time () - i->stats.connect_started;
+  i->stats.connect_started = 0;
+  g_debug ("xvd_sink_resolved: sink %u usable %" G_GINT64_FORMAT " us after connecting",
+           i->sink_index, i->stats.connect_latency);
+}
+
+
+/**
+ * Makes @info the sink the keys act on.
+ */
+static void
+xvd_use_sink (XvdInstance        *i,
+              const pa_sink_info *info)
+{
+  /* what was in flight targets the previous one */
+  xvd_ramp_stop (i);
+#ifdef HAVE_LIBNOTIFY
+  xvd_meter_disconnect (i);
+#endif
+  xvd_set_sink_monitor (i, info->monitor_source_name);
+  xvd_op_cancel (i, XVD_OP_SINK_VOLUME);
+  xvd_op_cancel (i, XVD_OP_SINK_MUTE);
+  i->sink_index = info->index;
+  old_volume = i->volume = info->volume;
+  old_mute = i->mute = info->mute;
+  xvd_sink_resolved (i);
+
+  if (i->state_cached && g_strcmp0 (i->sink_name, info->name) != 0)
+    g_debug ("xvd_use_sink: default sink is now %s, was %s", info->name, i->sink_name);
+  g_strlcpy (i->sink_name, info->name, sizeof (i->sink_name));
+  xvd_state_changed (i);
+
+  /* key presses from before the sink was known, unless the user gave up
+     on them by now */
+  i->had_sink = TRUE;
+  if (i->early_time != 0
+      && g_get_monotonic_time () - i->early_time > XVD_EARLY_TIMEOUT)
+    g_debug ("xvd_use_sink: dropping the key presses from %" G_GINT64_FORMAT " ms ago",
+             (g_get_monotonic_time () - i->early_time) / 1000);
   else
     {
-      /* when PulseAudio doesn't set a default source, look at all of them
-         and hope to find a usable one */
-      op = pa_context_get_source_info_list(c,
-                                           xvd_source_info_callback,
-                                           userdata);
-
-      if (!op)
-        {
-          g_warning("xvd_server_info_callback: pa_context_get_source_info_list() failed");
-          return;
-        }
-      pa_operation_unref (op);
+      if (i->early_volume != 0)
+        xvd_step_volume (i, i->early_volume);
+      if (i->early_mute % 2 != 0)
+        xvd_switch_mute (i);
     }
+  i->early_volume = 0;
+  i->early_mute = 0;
+  i->early_time = 0;
 }
 
 
@@ -649,6 +2832,11 @@ xvd_sink_info_callback (pa_context         *c,
 {
   XvdInstance *i = (XvdInstance *) userdata;
 
+  XVD_DISPATCH_TAG ();
+
+  if (eol != 0 && userdata)
+    i->sink_list_pending = FALSE;
+
   /* detect the end of the list */
   if (eol > 0)
     return;
@@ -659,16 +2847,15 @@ xvd_sink_info_callback (pa_context         *c,
           g_warning ("xvd_sink_info_callback: invalid argument");
           return;
         }
+      xvd_record_sink (sink);
+
+      xvd_devices_update_sink (i->sinks, sink);
 
       /* If there's no default sink, try to use this one */
       if (i->sink_index == PA_INVALID_INDEX
           /* indicator-sound does that check */
           && g_ascii_strncasecmp ("auto_null", sink->name, 9) != 0)
-        {
-          i->sink_index = sink->index;
-          old_volume = i->volume = sink->volume;
-          old_mute = i->mute = sink->mute;
-        }
+        xvd_use_sink (i, sink);
     }
 }
 
@@ -684,9 +2871,19 @@ xvd_default_sink_info_callback (pa_context         *c,
 {
   XvdInstance *i = (XvdInstance *) userdata;
 
+  XVD_DISPATCH_TAG ();
+
   /* detect the end of the list */
   if (eol > 0)
     return;
+  /* no default sink, look at all of them and hope to find a usable one */
+  else if (eol < 0)
+    {
+      xvd_record_default_sink (PA_INVALID_INDEX);
+      if (c && userdata && i->sink_index == PA_INVALID_INDEX)
+        xvd_fetch_sinks (c, i);
+      return;
+    }
   else
     {
       if (!userdata || !info)
@@ -694,15 +2891,211 @@ xvd_default_sink_info_callback (pa_context         *c,
           g_warning ("xvd_default_sink_info_callback: invalid argument");
           return;
         }
+      xvd_record_sink (info);
+      xvd_record_default_sink (info->index);
+
+      xvd_devices_update_sink (i->sinks, info);
 
       /* is this a new default sink? */
       if (i->sink_index != info->index)
-        {
-          i->sink_index = info->index;
-          old_volume = i->volume = info->volume;
-          old_mute = i->mute = info->mute;
-        }
+        xvd_use_sink (i, info);
+    }
+}
+
+
+/**
+ * Returns whether the hotplug policy wants a newly plugged sink.
+ */
+static gboolean
+xvd_hotplug_wanted (XvdInstance   *i,
+                    const XvdSink *sink)
+{
+  XvdCard     *card;
+  const gchar *bus = sink->bus;
+
+  /* only hardware, not the virtual sinks some applications create */
+  if (sink->card == PA_INVALID_INDEX)
+    return FALSE;
+
+  if (!bus && (card = g_hash_table_lookup (i->cards, GUINT_TO_POINTER (sink->card))))
+    bus = card->bus;
+
+  switch (i->hotplug_policy)
+    {
+      case HOTPLUG_POLICY_PREFER_USB:
+        return g_strcmp0 (bus, "usb") == 0;
+      case HOTPLUG_POLICY_PREFER_NEW:
+        return TRUE;
+      default:
+        return FALSE;
+    }
+}
+
+
+static void
+xvd_default_sink_set_callback (pa_context *c,
+                               int         success,
+                               void       *userdata)
+{
+  XVD_DISPATCH_TAG ();
+
+  if (!success)
+    g_warning ("xvd_default_sink_set_callback: operation failed, %s",
+               pa_strerror (pa_context_errno (c)));
+}
+
+
+/**
+ * Callback to retrieve the infos of a sink that just appeared.
+ */
+static void
+xvd_new_sink_callback (pa_context         *c,
+                       const pa_sink_info *info,
+                       int                 eol,
+                       void               *userdata)
+{
+  XvdInstance  *i = (XvdInstance *) userdata;
+  XvdSink      *sink;
+  gpointer      op = NULL;
+
+  XVD_DISPATCH_TAG ();
+
+  /* detect the end of the list, or a sink gone meanwhile */
+  if (eol != 0)
+    return;
+
+  if (!c || !userdata || !info)
+    {
+      g_warning ("xvd_new_sink_callback: invalid argument");
+      return;
+    }
+  xvd_record_sink (info);
+
+  sink = xvd_devices_update_sink (i->sinks, info);
+  if (i->sink_index == info->index || !xvd_hotplug_wanted (i, sink))
+    return;
+
+  g_debug ("xvd_new_sink_callback: switching to %s", info->name);
+  op = XVD_REQUEST (i, set_default_sink,
+                    info->name,
+                    xvd_default_sink_set_callback,
+                    i);
+  if (!op)
+    {
+      g_warning ("xvd_new_sink_callback: pa_context_set_default_sink() failed");
+      return;
+    }
+  xvd_request_unref (i, op);
+
+  /* no need to wait for the server to confirm, the keys act on it now */
+  xvd_use_sink (i, info);
+  g_strlcpy (i->device_name, sink->description ? sink->description : sink->name,
+             sizeof (i->device_name));
+#ifdef HAVE_LIBNOTIFY
+  xvd_queue_work (i, XVD_WORK_NOTIFY_DEVICE, xvd_notify_device_work);
+#endif
+}
+
+
+/**
+ * Lists the cards, the events tell about the others.
+ */
+static void
+xvd_fetch_cards (pa_context  *c,
+                 XvdInstance *i)
+{
+  gpointer      op = NULL;
+
+  i->stats.introspections++;
+  op = XVD_REQUEST (i, get_card_info_list,
+                    xvd_card_info_callback,
+                    i);
+  if (!op)
+    g_warning ("xvd_fetch_cards: pa_context_get_card_info_list() failed");
+  else
+    xvd_request_unref (i, op);
+}
+
+
+/**
+ * Callback to retrieve the infos of cards.
+ */
+static void
+xvd_card_info_callback (pa_context         *c,
+                        const pa_card_info *info,
+                        int                 eol,
+                        void               *userdata)
+{
+  XvdInstance *i = (XvdInstance *) userdata;
+  XvdPort     *plugged;
+  XvdSink     *sink;
+
+  XVD_DISPATCH_TAG ();
+
+  /* detect the end of the list, or a card gone meanwhile */
+  if (eol != 0)
+    return;
+
+  if (!userdata || !info)
+    {
+      g_warning ("xvd_card_info_callback: invalid argument");
+      return;
+    }
+  xvd_record_card (info);
+
+  plugged = xvd_devices_update_card (i->cards, info);
+  if (!plugged)
+    return;
+
+  /* headphones and the like, the server switches ports by itself, tell
+     about it if that's the card in use */
+  sink = g_hash_table_lookup (i->sinks, GUINT_TO_POINTER (i->sink_index));
+  if (!sink || sink->card != info->index)
+    return;
+
+  g_strlcpy (i->device_name, plugged->description, sizeof (i->device_name));
+#ifdef HAVE_LIBNOTIFY
+  xvd_queue_work (i, XVD_WORK_NOTIFY_DEVICE, xvd_notify_device_work);
+#endif
+}
+
+
+/**
+ * Callback for the changes of another sink of the group.
+ */
+static void
+xvd_member_sink_callback (pa_context         *c,
+                          const pa_sink_info *info,
+                          int                 eol,
+                          void               *userdata)
+{
+  XvdInstance *i = (XvdInstance *) userdata;
+  XvdSink     *sink;
+  pa_cvolume   volume = { 0 };
+  gboolean     in_flight;
+
+  XVD_DISPATCH_TAG ();
+
+  /* detect the end of the list, or a sink gone meanwhile */
+  if (eol != 0)
+    return;
+
+  if (!userdata || !info)
+    {
+      g_warning ("xvd_member_sink_callback: invalid argument");
+      return;
     }
+  xvd_record_sink (info);
+
+  /* our own newer volume is still on its way to the server */
+  sink = g_hash_table_lookup (i->sinks, GUINT_TO_POINTER (info->index));
+  in_flight = sink && i->group_acks > 0;
+  if (in_flight)
+    volume = sink->volume;
+
+  sink = xvd_devices_update_sink (i->sinks, info);
+  if (in_flight)
+    sink->volume = volume;
 }
 
 
@@ -716,6 +3109,9 @@ xvd_update_sink_callback (pa_context         *c,
                           void               *userdata)
 {
   XvdInstance *i = (XvdInstance *) userdata;
+  gboolean     changed = FALSE;
+
+  XVD_DISPATCH_TAG ();
 
   /* detect the end of the list */
   if (eol > 0)
@@ -727,18 +3123,35 @@ xvd_update_sink_callback (pa_context         *c,
           g_warning ("xvd_update_sink_callback: invalid argument");
           return;
         }
+      xvd_record_sink (info);
 
-      /* re-fetch infos from PulseAudio */
+      XVD_TRACE (SINK_INFO, info->index,
+                 (info->mute) ? -1 : xvd_get_readable_volume (&info->volume));
+
+      /* re-fetch infos from PulseAudio, unless our own newer state is
+         still on its way to the server */
       i->sink_index = info->index;
-      old_volume = i->volume;
-      i->volume = info->volume;
-      old_mute = i->mute;
-      i->mute = info->mute;
+      if (!i->pending[XVD_OP_SINK_VOLUME].op && !i->ramp_event)
+        {
+          old_volume = i->volume;
+          i->volume = info->volume;
+          if (xvd_get_readable_volume (&old_volume) != xvd_get_readable_volume (&i->volume))
+            changed = TRUE;
+        }
+      if (!i->pending[XVD_OP_SINK_MUTE].op)
+        {
+          old_mute = i->mute;
+          i->mute = info->mute;
+          if (old_mute != i->mute)
+            changed = TRUE;
+        }
+
+      if (changed)
+        xvd_state_changed (i);
 
 #ifdef HAVE_LIBNOTIFY
       /* notify user of the possible changes */
-      if (xvd_get_readable_volume (&old_volume) != xvd_get_readable_volume (&i->volume)
-          || old_mute != i->mute)
+      if (changed)
         xvd_notify_volume_callback (c, 1, i);
 #endif
     }
@@ -756,6 +3169,11 @@ xvd_source_info_callback (pa_context         *c,
 {
   XvdInstance *i = (XvdInstance *) userdata;
 
+  XVD_DISPATCH_TAG ();
+
+  if (eol != 0 && userdata)
+    i->source_list_pending = FALSE;
+
   /* detect the end of the list */
   if (eol > 0)
     return;
@@ -766,6 +3184,7 @@ xvd_source_info_callback (pa_context         *c,
           g_warning ("xvd_source_info_callback: invalid argument");
           return;
         }
+      xvd_record_source (source);
 
       /* If there's no default source, try to use this one */
       if (i->source_index == PA_INVALID_INDEX
@@ -790,9 +3209,19 @@ xvd_default_source_info_callback (pa_context         *c,
 {
   XvdInstance *i = (XvdInstance *) userdata;
 
+  XVD_DISPATCH_TAG ();
+
   /* detect the end of the list */
   if (eol > 0)
     return;
+  /* no default source, look at all of them and hope to find a usable one */
+  else if (eol < 0)
+    {
+      xvd_record_default_source (PA_INVALID_INDEX);
+      if (c && userdata && i->source_index == PA_INVALID_INDEX)
+        xvd_fetch_sources (c, i);
+      return;
+    }
   else
     {
       if (!userdata || !info)
@@ -800,10 +3229,13 @@ xvd_default_source_info_callback (pa_context         *c,
           g_warning ("xvd_default_source_info_callback: invalid argument");
           return;
         }
+      xvd_record_source (info);
+      xvd_record_default_source (info->index);
 
       /* is this a new default source? */
       if (i->source_index != info->index)
         {
+          xvd_op_cancel (i, XVD_OP_SOURCE_MUTE);
           i->source_index = info->index;
           old_mic_mute = i->mic_mute = info->mute;
         }
@@ -822,6 +3254,8 @@ xvd_update_source_callback (pa_context         *c,
 {
   XvdInstance *i = (XvdInstance *) userdata;
 
+  XVD_DISPATCH_TAG ();
+
   /* detect the end of the list */
   if (eol > 0)
     return;
@@ -832,9 +3266,15 @@ xvd_update_source_callback (pa_context         *c,
           g_warning ("xvd_update_source_callback: invalid argument");
           return;
         }
+      xvd_record_source (info);
 
-      /* re-fetch infos from PulseAudio */
+      XVD_TRACE (SOURCE_INFO, info->index, info->mute);
+
+      /* re-fetch infos from PulseAudio, unless our own newer state is
+         still on its way to the server */
       i->source_index = info->index;
+      if (i->pending[XVD_OP_SOURCE_MUTE].op)
+        return;
       old_mic_mute = i->mic_mute;
       i->mic_mute = info->mute;
 
@@ -36,16 +36,70 @@ gboolean xvd_open_pulse          (XvdInstance        *i);
 void     xvd_close_pulse         (XvdInstance        *i);
 
 /**
- * Changes the volume in the given direction.
+ * Holds the PulseAudio thread, if any, to access the PA state.
+ */
+void     xvd_pulse_lock          (XvdInstance        *i);
+
+/**
+ * Releases the PulseAudio thread.
+ */
+void     xvd_pulse_unlock        (XvdInstance        *i);
+
+/**
+ * Handles @t on @index as if the server had sent it, for replays.
+ */
+void     xvd_pulse_inject_event  (XvdInstance        *i,
+                                  guint32             t,
+                                  guint32             index);
+
+/**
+ * Changes the volume in the given direction, by @step percent.
  */
 void     xvd_update_volume       (XvdInstance        *i,
-                                  XvdVolStepDirection d);
+                                  XvdVolStepDirection d,
+                                  guint               step);
+
+/**
+ * Changes the volume of the focused application, or of the one that
+ * played last, in the given direction, by @step percent.
+ */
+void     xvd_update_stream_volume (XvdInstance        *i,
+                                   XvdVolStepDirection d,
+                                   guint               step);
+
+/**
+ * Runs the level meter of the volume notification for a while, as after a
+ * volume notification, if the notifications can show it.
+ */
+void     xvd_pulse_start_meter   (XvdInstance        *i);
+
+/**
+ * Stops the level meter of the volume notification, if running.
+ */
+void     xvd_pulse_stop_meter    (XvdInstance        *i);
+
+/**
+ * Sets the volume to @percent, ramping to it if configured.
+ */
+void     xvd_set_volume          (XvdInstance        *i,
+                                  guint               percent);
 
 /**
  * Toggle mute.
  */
 void     xvd_toggle_mute         (XvdInstance        *i);
 
+/**
+ * Mute the sink and the source together, or unmute both if both are muted.
+ */
+void     xvd_toggle_mute_all     (XvdInstance        *i);
+
+/**
+ * Unmute the source while @talk, mute it back otherwise.
+ */
+void     xvd_push_to_talk        (XvdInstance        *i,
+                                  gboolean            talk);
+
 /**
  * Toggle mic mute.
  */
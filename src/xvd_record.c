@@ -0,0 +1,1290 @@
+/*
+ *  xfce4-volumed-pulse - Volume management daemon for XFCE 4 (Pulseaudio variant)
+ *
+ *  Copyright © 2026 The Xfce Development Team
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/resource.h>
+
+#include "xvd_pulse.h"
+#include "xvd_record.h"
+#include "xvd_watchdog.h"
+
+/* "XVDR", then the version of the entries */
+#define XVD_RECORD_MAGIC   0x52445658
+#define XVD_RECORD_VERSION 2
+
+/* events injected per main loop iteration at full speed, so the
+   answers to the requests they cause get a chance to come in between */
+#define XVD_REPLAY_BATCH 64
+
+/* time (in ms) left to the last answers before the report */
+#define XVD_REPLAY_DRAIN_TIME 1000
+
+/* entries start on 8 bytes, as the GVariant data in them */
+#define XVD_RECORD_ALIGN(size) (((size) + 7) & ~(guint64) 7)
+
+
+/**
+ * What an entry holds. After an event come the replies the server gave to
+ * the requests it caused, they describe its state once the event happened.
+ */
+typedef enum {
+  XVD_RECORD_EVENT,
+  XVD_RECORD_SINK,
+  XVD_RECORD_SOURCE,
+  XVD_RECORD_SINK_INPUT,
+  XVD_RECORD_CARD,
+  XVD_RECORD_DEFAULT_SINK,
+  XVD_RECORD_DEFAULT_SOURCE,
+  XVD_RECORD_N
+} XvdRecordKind;
+
+/* the type of the payload of each kind */
+static const gchar *xvd_record_types[XVD_RECORD_N] =
+{
+  "(uu)",           /* type, index */
+  "(usmsaubmsums)", /* index, name, description, volume, mute, monitor source, card, bus */
+  "(usbu)",         /* index, name, mute, monitor of sink */
+  "(umsmsmsaubbb)", /* index, name, application, pid, volume, has volume, volume writable, corked */
+  "(usmsmsa(ssb))", /* index, name, bus, active profile, ports (name, description, available) */
+  "u",              /* index, or PA_INVALID_INDEX */
+  "u"
+};
+
+/**
+ * Each entry is a GVariant of this type, the time in microseconds since
+ * the recording started, the kind and the payload. Recordings are replayed
+ * on the machine that made them, it is stored in its byte order after its
+ * size, a guint64.
+ */
+#define XVD_RECORD_ENTRY_TYPE "(tuv)"
+
+typedef struct {
+  guint32 magic;
+  guint32 version;
+} XvdRecordHeader;
+
+typedef struct {
+  guint64   time;
+  guint32   kind;
+  GVariant *payload;
+} XvdReplayEntry;
+
+/**
+ * The requests, the kind of the entries they are about tells what they
+ * act on.
+ */
+typedef enum {
+  XVD_REPLAY_GET,
+  XVD_REPLAY_GET_LIST,
+  XVD_REPLAY_SET_VOLUME,
+  XVD_REPLAY_SET_MUTE,
+  XVD_REPLAY_SET_DEFAULT,
+  XVD_REPLAY_EVENT          /* sent by the server, not requested */
+} XvdReplayRequest;
+
+struct _XvdReplayOp {
+  gint                  ref_count;
+  pa_operation_state_t  state;
+  XvdReplayRequest      request;
+  XvdRecordKind         kind;
+  guint32               index;
+  gchar                *name;
+  pa_cvolume            volume;
+  gint                  mute;
+  guint32               event;
+  GCallback             callback;
+  gpointer              userdata;
+};
+
+
+/* written from the PulseAudio thread when there's one */
+static FILE   *xvd_record_file = NULL;
+static gint64  xvd_record_origin = 0;
+
+/* owned by the main thread */
+static XvdInstance    *xvd_replay_instance = NULL;
+static GArray         *xvd_replay_entries = NULL;
+static gsize           xvd_replay_next = 0;
+static gsize           xvd_replay_events = 0;
+static gboolean        xvd_replay_realtime = FALSE;
+static gint64          xvd_replay_origin = 0;
+static guint64         xvd_replay_introspections = 0;
+static guint64         xvd_replay_notifications = 0;
+static guint64         xvd_replay_notifications_saved = 0;
+static gint64          xvd_replay_cpu = 0;
+static guint           xvd_replay_source = 0;   /* the next step, or the report */
+
+/* the replayed server, owned by the PulseAudio thread when there's one:
+   the devices and streams by index, and the requests to answer */
+static GHashTable     *xvd_replay_objects[XVD_RECORD_N];
+static guint32         xvd_replay_default_sink = PA_INVALID_INDEX;
+static guint32         xvd_replay_default_source = PA_INVALID_INDEX;
+static GQueue          xvd_replay_ops = G_QUEUE_INIT;
+static pa_defer_event *xvd_replay_answer_event = NULL;
+
+static XvdReplayWriteFunc xvd_replay_write_func = NULL;
+static gpointer           xvd_replay_write_data = NULL;
+
+
+/**
+ * Appends an entry to the recording, consumes @payload.
+ */
+static void
+xvd_record_write (XvdRecordKind  kind,
+                  GVariant      *payload)
+{
+  static const gchar padding[8] = { 0 };
+  GVariant          *entry;
+  guint64            size;
+
+  entry = g_variant_ref_sink (g_variant_new (XVD_RECORD_ENTRY_TYPE,
+                                             (guint64) (g_get_monotonic_time () - xvd_record_origin),
+                                             (guint32) kind,
+                                             payload));
+  size = g_variant_get_size (entry);
+
+  if (fwrite (&size, sizeof (size), 1, xvd_record_file) != 1
+      || fwrite (g_variant_get_data (entry), 1, size, xvd_record_file) != size
+      || fwrite (padding, 1, XVD_RECORD_ALIGN (size) - size, xvd_record_file) != XVD_RECORD_ALIGN (size) - size)
+    {
+      g_warning ("xvd_record_write: write failed, recording stopped");
+      xvd_record_stop ();
+    }
+
+  g_variant_unref (entry);
+}
+
+
+static GVariant *
+xvd_record_cvolume (const pa_cvolume *volume)
+{
+  return g_variant_new_fixed_array (G_VARIANT_TYPE_UINT32,
+                                    volume->values,
+                                    volume->channels,
+                                    sizeof (guint32));
+}
+
+
+gboolean
+xvd_record_start (const gchar *path)
+{
+  XvdRecordHeader header = { XVD_RECORD_MAGIC, XVD_RECORD_VERSION };
+
+  xvd_record_file = fopen (path, "wb");
+  if (!xvd_record_file)
+    {
+      g_warning ("xvd_record_start: can't create %s: %s", path, g_strerror (errno));
+      return FALSE;
+    }
+
+  if (fwrite (&header, sizeof (header), 1, xvd_record_file) != 1)
+    {
+      g_warning ("xvd_record_start: can't write to %s", path);
+      xvd_record_stop ();
+      return FALSE;
+    }
+
+  xvd_record_origin = g_get_monotonic_time ();
+  return TRUE;
+}
+
+
+void
+xvd_record_event (pa_subscription_event_type_t t,
+                  guint32                      index)
+{
+  if (!xvd_record_file)
+    return;
+
+  xvd_record_write (XVD_RECORD_EVENT, g_variant_new ("(uu)", (guint32) t, index));
+}
+
+
+void
+xvd_record_sink (const pa_sink_info *info)
+{
+  if (!xvd_record_file)
+    return;
+
+  xvd_record_write (XVD_RECORD_SINK,
+                    g_variant_new ("(usms@aubmsums)",
+                                   info->index,
+                                   info->name,
+                                   info->description,
+                                   xvd_record_cvolume (&info->volume),
+                                   (gboolean) info->mute,
+                                   info->monitor_source_name,
+                                   info->card,
+                                   pa_proplist_gets (info->proplist, PA_PROP_DEVICE_BUS)));
+}
+
+
+void
+xvd_record_source (const pa_source_info *info)
+{
+  if (!xvd_record_file)
+    return;
+
+  xvd_record_write (XVD_RECORD_SOURCE,
+                    g_variant_new ("(usbu)",
+                                   info->index,
+                                   info->name,
+                                   (gboolean) info->mute,
+                                   info->monitor_of_sink));
+}
+
+
+void
+xvd_record_sink_input (const pa_sink_input_info *info)
+{
+  if (!xvd_record_file)
+    return;
+
+  xvd_record_write (XVD_RECORD_SINK_INPUT,
+                    g_variant_new ("(umsmsms@aubbb)",
+                                   info->index,
+                                   info->name,
+                                   pa_proplist_gets (info->proplist, PA_PROP_APPLICATION_NAME),
+                                   pa_proplist_gets (info->proplist, PA_PROP_APPLICATION_PROCESS_ID),
+                                   xvd_record_cvolume (&info->volume),
+                                   (gboolean) info->has_volume,
+                                   (gboolean) info->volume_writable,
+                                   (gboolean) info->corked));
+}
+
+
+void
+xvd_record_card (const pa_card_info *info)
+{
+  GVariantBuilder ports;
+  guint32         n;
+
+  if (!xvd_record_file)
+    return;
+
+  g_variant_builder_init (&ports, G_VARIANT_TYPE ("a(ssb)"));
+  for (n = 0; n < info->n_ports; n++)
+    g_variant_builder_add (&ports, "(ssb)",
+                           info->ports[n]->name,
+                           info->ports[n]->description ? info->ports[n]->description : "",
+                           info->ports[n]->available == PA_PORT_AVAILABLE_YES);
+
+  xvd_record_write (XVD_RECORD_CARD,
+                    g_variant_new ("(usmsmsa(ssb))",
+                                   info->index,
+                                   info->name,
+                                   pa_proplist_gets (info->proplist, PA_PROP_DEVICE_BUS),
+                                   info->active_profile ? info->active_profile->name : NULL,
+                                   &ports));
+}
+
+
+void
+xvd_record_default_sink (guint32 index)
+{
+  if (!xvd_record_file)
+    return;
+
+  xvd_record_write (XVD_RECORD_DEFAULT_SINK, g_variant_new_uint32 (index));
+}
+
+
+void
+xvd_record_default_source (guint32 index)
+{
+  if (!xvd_record_file)
+    return;
+
+  xvd_record_write (XVD_RECORD_DEFAULT_SOURCE, g_variant_new_uint32 (index));
+}
+
+
+void
+xvd_record_stop (void)
+{
+  if (!xvd_record_file)
+    return;
+
+  fclose (xvd_record_file);
+  xvd_record_file = NULL;
+}
+
+
+/**
+ * Returns the CPU time used so far by the whole process, in microseconds.
+ */
+static gint64
+xvd_replay_cpu_time (void)
+{
+  struct rusage usage;
+
+  getrusage (RUSAGE_SELF, &usage);
+  return (gint64) (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * G_USEC_PER_SEC
+         + usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+}
+
+
+static void
+xvd_replay_cvolume (GVariant   *array,
+                    pa_cvolume *volume)
+{
+  const guint32 *values;
+  gsize          n;
+
+  values = g_variant_get_fixed_array (array, &n, sizeof (guint32));
+  volume->channels = MIN (n, PA_CHANNELS_MAX);
+  memcpy (volume->values, values, volume->channels * sizeof (guint32));
+}
+
+
+/**
+ * Returns the index of the device named @name, the default one for the
+ * special names.
+ */
+static guint32
+xvd_replay_find (XvdRecordKind  kind,
+                 const gchar   *name)
+{
+  GHashTableIter iter;
+  gpointer       key, value;
+
+  if (kind == XVD_RECORD_SINK && g_strcmp0 (name, "@DEFAULT_SINK@") == 0)
+    return xvd_replay_default_sink;
+  if (kind == XVD_RECORD_SOURCE && g_strcmp0 (name, "@DEFAULT_SOURCE@") == 0)
+    return xvd_replay_default_source;
+
+  g_hash_table_iter_init (&iter, xvd_replay_objects[kind]);
+  while (g_hash_table_iter_next (&iter, &key, &value))
+    {
+      const gchar *object_name;
+
+      g_variant_get_child ((GVariant *) value, 1, "&s", &object_name);
+      if (g_strcmp0 (object_name, name) == 0)
+        return GPOINTER_TO_UINT (key);
+    }
+
+  return PA_INVALID_INDEX;
+}
+
+
+/**
+ * Updates the replayed server with a recorded entry.
+ */
+static void
+xvd_replay_apply (XvdReplayEntry *entry)
+{
+  guint32 type, index;
+
+  switch (entry->kind)
+    {
+      case XVD_RECORD_EVENT:
+        /* the replies that follow describe what's new or changed */
+        g_variant_get (entry->payload, "(uu)", &type, &index);
+        if ((type & PA_SUBSCRIPTION_EVENT_TYPE_MASK) != PA_SUBSCRIPTION_EVENT_REMOVE)
+          break;
+        switch (type & PA_SUBSCRIPTION_EVENT_FACILITY_MASK)
+          {
+            case PA_SUBSCRIPTION_EVENT_SINK:
+              g_hash_table_remove (xvd_replay_objects[XVD_RECORD_SINK], GUINT_TO_POINTER (index));
+            break;
+            case PA_SUBSCRIPTION_EVENT_SOURCE:
+              g_hash_table_remove (xvd_replay_objects[XVD_RECORD_SOURCE], GUINT_TO_POINTER (index));
+            break;
+            case PA_SUBSCRIPTION_EVENT_SINK_INPUT:
+              g_hash_table_remove (xvd_replay_objects[XVD_RECORD_SINK_INPUT], GUINT_TO_POINTER (index));
+            break;
+            case PA_SUBSCRIPTION_EVENT_CARD:
+              g_hash_table_remove (xvd_replay_objects[XVD_RECORD_CARD], GUINT_TO_POINTER (index));
+            break;
+            default:
+            break;
+          }
+      break;
+      case XVD_RECORD_DEFAULT_SINK:
+        xvd_replay_default_sink = g_variant_get_uint32 (entry->payload);
+      break;
+      case XVD_RECORD_DEFAULT_SOURCE:
+        xvd_replay_default_source = g_variant_get_uint32 (entry->payload);
+      break;
+      default:
+        g_variant_get_child (entry->payload, 0, "u", &index);
+        g_hash_table_replace (xvd_replay_objects[entry->kind],
+                              GUINT_TO_POINTER (index),
+                              g_variant_ref (entry->payload));
+      break;
+    }
+}
+
+
+/**
+ * Calls the info callback of @op with the device or stream @object, or
+ * with none to end the list.
+ */
+static void
+xvd_replay_answer_info (pa_context  *c,
+                        XvdReplayOp *op,
+                        GVariant    *object,
+                        gint         eol)
+{
+  GVariant *volume = NULL;
+  gboolean  mute = FALSE, has_volume = FALSE, writable = FALSE, corked = FALSE;
+  const gchar *bus = NULL, *application = NULL, *pid = NULL, *profile = NULL;
+
+  switch (op->kind)
+    {
+      case XVD_RECORD_SINK:
+        {
+          pa_sink_info info;
+
+          memset (&info, 0, sizeof (info));
+          if (object)
+            {
+              g_variant_get (object, "(u&sm&s@aubm&sum&s)",
+                             &info.index, &info.name, &info.description, &volume, &mute,
+                             &info.monitor_source_name, &info.card, &bus);
+              xvd_replay_cvolume (volume, &info.volume);
+              info.mute = mute;
+              info.proplist = pa_proplist_new ();
+              if (bus)
+                pa_proplist_sets (info.proplist, PA_PROP_DEVICE_BUS, bus);
+            }
+          ((pa_sink_info_cb_t) op->callback) (c, object ? &info : NULL, eol, op->userdata);
+          if (info.proplist)
+            pa_proplist_free (info.proplist);
+        }
+      break;
+      case XVD_RECORD_SOURCE:
+        {
+          pa_source_info info;
+
+          memset (&info, 0, sizeof (info));
+          if (object)
+            {
+              g_variant_get (object, "(u&sbu)",
+                             &info.index, &info.name, &mute, &info.monitor_of_sink);
+              info.mute = mute;
+            }
+          ((pa_source_info_cb_t) op->callback) (c, object ? &info : NULL, eol, op->userdata);
+        }
+      break;
+      case XVD_RECORD_SINK_INPUT:
+        {
+          pa_sink_input_info info;
+
+          memset (&info, 0, sizeof (info));
+          if (object)
+            {
+              g_variant_get (object, "(um&sm&sm&s@aubbb)",
+                             &info.index, &info.name, &application, &pid, &volume,
+                             &has_volume, &writable, &corked);
+              xvd_replay_cvolume (volume, &info.volume);
+              info.has_volume = has_volume;
+              info.volume_writable = writable;
+              info.corked = corked;
+              info.proplist = pa_proplist_new ();
+              if (application)
+                pa_proplist_sets (info.proplist, PA_PROP_APPLICATION_NAME, application);
+              if (pid)
+                pa_proplist_sets (info.proplist, PA_PROP_APPLICATION_PROCESS_ID, pid);
+            }
+          ((pa_sink_input_info_cb_t) op->callback) (c, object ? &info : NULL, eol, op->userdata);
+          if (info.proplist)
+            pa_proplist_free (info.proplist);
+        }
+      break;
+      case XVD_RECORD_CARD:
+        {
+          pa_card_info          info;
+          pa_card_profile_info  active;
+          pa_card_port_info    *ports = NULL;
+          GVariant             *port_list = NULL;
+          guint32               n;
+
+          memset (&info, 0, sizeof (info));
+          memset (&active, 0, sizeof (active));
+          if (object)
+            {
+              g_variant_get (object, "(u&sm&sm&s@a(ssb))",
+                             &info.index, &info.name, &bus, &profile, &port_list);
+              info.proplist = pa_proplist_new ();
+              if (bus)
+                pa_proplist_sets (info.proplist, PA_PROP_DEVICE_BUS, bus);
+              if (profile)
+                {
+                  active.name = profile;
+                  info.active_profile = &active;
+                }
+              info.n_ports = g_variant_n_children (port_list);
+              ports = g_new0 (pa_card_port_info, info.n_ports);
+              info.ports = g_new0 (pa_card_port_info *, info.n_ports);
+              for (n = 0; n < info.n_ports; n++)
+                {
+                  gboolean available;
+
+                  g_variant_get_child (port_list, n, "(&s&sb)",
+                                       &ports[n].name, &ports[n].description, &available);
+                  ports[n].available = available ? PA_PORT_AVAILABLE_YES : PA_PORT_AVAILABLE_NO;
+                  info.ports[n] = &ports[n];
+                }
+            }
+          ((pa_card_info_cb_t) op->callback) (c, object ? &info : NULL, eol, op->userdata);
+          if (info.proplist)
+            pa_proplist_free (info.proplist);
+          g_free (info.ports);
+          g_free (ports);
+          if (port_list)
+            g_variant_unref (port_list);
+        }
+      break;
+      default:
+      break;
+    }
+
+  if (volume)
+    g_variant_unref (volume);
+}
+
+
+static gint
+xvd_replay_compare_index (gconstpointer a,
+                          gconstpointer b)
+{
+  guint32 x = GPOINTER_TO_UINT (a), y = GPOINTER_TO_UINT (b);
+
+  return (x > y) - (x < y);
+}
+
+
+/**
+ * Returns @object with a new volume and mute, -1 keeps the mute.
+ */
+static GVariant *
+xvd_replay_modify (XvdRecordKind     kind,
+                   GVariant         *object,
+                   const pa_cvolume *volume,
+                   gint              mute)
+{
+  GVariant    *old_volume = NULL, *modified = NULL;
+  gboolean     old_mute = FALSE, has_volume, writable, corked;
+  guint32      index, card;
+  const gchar *name, *description, *monitor, *bus, *application, *pid;
+
+  switch (kind)
+    {
+      case XVD_RECORD_SINK:
+        g_variant_get (object, "(u&sm&s@aubm&sum&s)",
+                       &index, &name, &description, &old_volume, &old_mute, &monitor, &card, &bus);
+        modified = g_variant_new ("(usms@aubmsums)",
+                                  index, name, description,
+                                  volume ? xvd_record_cvolume (volume) : old_volume,
+                                  (mute < 0) ? old_mute : mute != 0,
+                                  monitor, card, bus);
+      break;
+      case XVD_RECORD_SOURCE:
+        g_variant_get (object, "(u&sbu)", &index, &name, &old_mute, &card);
+        modified = g_variant_new ("(usbu)", index, name, (mute < 0) ? old_mute : mute != 0, card);
+      break;
+      case XVD_RECORD_SINK_INPUT:
+        g_variant_get (object, "(um&sm&sm&s@aubbb)",
+                       &index, &name, &application, &pid, &old_volume, &has_volume, &writable, &corked);
+        modified = g_variant_new ("(umsmsms@aubbb)",
+                                  index, name, application, pid,
+                                  volume ? xvd_record_cvolume (volume) : old_volume,
+                                  has_volume, writable, corked);
+      break;
+      default:
+        g_assert_not_reached ();
+      break;
+    }
+
+  g_variant_ref_sink (modified);
+  if (old_volume)
+    g_variant_unref (old_volume);
+  return modified;
+}
+
+
+static void xvd_replay_answer_all (pa_mainloop_api *api,
+                                   pa_defer_event  *e,
+                                   void            *userdata);
+
+
+static XvdReplayOp *
+xvd_replay_op_new (XvdReplayRequest  request,
+                   XvdRecordKind     kind,
+                   guint32           index,
+                   const gchar      *name,
+                   GCallback         callback,
+                   gpointer          userdata)
+{
+  XvdReplayOp     *op;
+  pa_mainloop_api *api = xvd_replay_instance->pa_api;
+
+  op = g_new0 (XvdReplayOp, 1);
+  op->ref_count = 2;  /* ours until answered, and the caller's */
+  op->state = PA_OPERATION_RUNNING;
+  op->request = request;
+  op->kind = kind;
+  op->index = index;
+  op->name = g_strdup (name);
+  op->mute = -1;
+  op->callback = callback;
+  op->userdata = userdata;
+
+  /* answered in order, from the main loop like the server replies */
+  g_queue_push_tail (&xvd_replay_ops, op);
+  if (!xvd_replay_answer_event)
+    xvd_replay_answer_event = api->defer_new (api, xvd_replay_answer_all, NULL);
+  else
+    api->defer_enable (xvd_replay_answer_event, 1);
+
+  return op;
+}
+
+
+/**
+ * Sends a subscription event after a change, as the server does.
+ */
+static void
+xvd_replay_emit (guint32 event,
+                 guint32 index)
+{
+  XvdReplayOp *op;
+
+  op = xvd_replay_op_new (XVD_REPLAY_EVENT, XVD_RECORD_EVENT, index, NULL, NULL, NULL);
+  op->event = event;
+  xvd_replay_op_unref (op);
+}
+
+
+/**
+ * Changes a device or stream for a write request, returns whether it
+ * exists.
+ */
+static gboolean
+xvd_replay_write (XvdReplayOp *op)
+{
+  static const guint32 facilities[XVD_RECORD_N] =
+  {
+    0,
+    PA_SUBSCRIPTION_EVENT_SINK,
+    PA_SUBSCRIPTION_EVENT_SOURCE,
+    PA_SUBSCRIPTION_EVENT_SINK_INPUT,
+    PA_SUBSCRIPTION_EVENT_CARD,
+    0,
+    0
+  };
+  GVariant *object, *modified;
+  guint32   index;
+
+  if (op->request == XVD_REPLAY_SET_DEFAULT)
+    {
+      index = xvd_replay_find (XVD_RECORD_SINK, op->name);
+      if (index == PA_INVALID_INDEX)
+        return FALSE;
+
+      if (index != xvd_replay_default_sink)
+        {
+          xvd_replay_default_sink = index;
+          xvd_replay_emit (PA_SUBSCRIPTION_EVENT_SERVER | PA_SUBSCRIPTION_EVENT_CHANGE,
+                           PA_INVALID_INDEX);
+        }
+      return TRUE;
+    }
+
+  object = g_hash_table_lookup (xvd_replay_objects[op->kind], GUINT_TO_POINTER (op->index));
+  if (!object)
+    return FALSE;
+
+  if (xvd_replay_write_func)
+    xvd_replay_write_func (facilities[op->kind], op->index,
+                           (op->request == XVD_REPLAY_SET_VOLUME) ? &op->volume : NULL,
+                           op->mute, xvd_replay_write_data);
+
+  modified = xvd_replay_modify (op->kind, object,
+                                (op->request == XVD_REPLAY_SET_VOLUME) ? &op->volume : NULL,
+                                op->mute);
+  if (g_variant_equal (modified, object))
+    {
+      g_variant_unref (modified);
+      return TRUE;
+    }
+
+  g_hash_table_replace (xvd_replay_objects[op->kind], GUINT_TO_POINTER (op->index), modified);
+  xvd_replay_emit (facilities[op->kind] | PA_SUBSCRIPTION_EVENT_CHANGE, op->index);
+  return TRUE;
+}
+
+
+/**
+ * Answers a request from the replayed server.
+ */
+static void
+xvd_replay_answer (XvdReplayOp *op)
+{
+  XvdInstance *i = xvd_replay_instance;
+  pa_context  *c = i->pulse_context;
+  GVariant    *object;
+  GList       *indexes, *l;
+  guint32      index;
+
+  switch (op->request)
+    {
+      case XVD_REPLAY_GET:
+        index = op->name ? xvd_replay_find (op->kind, op->name) : op->index;
+        object = g_hash_table_lookup (xvd_replay_objects[op->kind], GUINT_TO_POINTER (index));
+        if (object)
+          xvd_replay_answer_info (c, op, object, 0);
+        /* like the server, no such entity is an error */
+        xvd_replay_answer_info (c, op, NULL, object ? 1 : -1);
+      break;
+      case XVD_REPLAY_GET_LIST:
+        indexes = g_list_sort (g_hash_table_get_keys (xvd_replay_objects[op->kind]),
+                               xvd_replay_compare_index);
+        for (l = indexes; l; l = l->next)
+          xvd_replay_answer_info (c, op, g_hash_table_lookup (xvd_replay_objects[op->kind], l->data), 0);
+        g_list_free (indexes);
+        xvd_replay_answer_info (c, op, NULL, 1);
+      break;
+      case XVD_REPLAY_SET_VOLUME:
+      case XVD_REPLAY_SET_MUTE:
+      case XVD_REPLAY_SET_DEFAULT:
+        ((pa_context_success_cb_t) op->callback) (c, xvd_replay_write (op), op->userdata);
+      break;
+      case XVD_REPLAY_EVENT:
+        xvd_pulse_inject_event (i, op->event, op->index);
+      break;
+    }
+}
+
+
+/**
+ * Answers the requests made so far, those they cause wait for the next
+ * main loop iteration.
+ */
+static void
+xvd_replay_answer_all (pa_mainloop_api *api,
+                       pa_defer_event  *e,
+                       void            *userdata)
+{
+  guint n = g_queue_get_length (&xvd_replay_ops);
+
+  XVD_DISPATCH_TAG ();
+
+  while (n-- > 0)
+    {
+      XvdReplayOp *op = g_queue_pop_head (&xvd_replay_ops);
+
+      if (op->state == PA_OPERATION_RUNNING)
+        {
+          op->state = PA_OPERATION_DONE;
+          xvd_replay_answer (op);
+        }
+      xvd_replay_op_unref (op);
+    }
+
+  if (g_queue_is_empty (&xvd_replay_ops))
+    api->defer_enable (e, 0);
+}
+
+
+XvdReplayOp *
+xvd_replay_get_sink_info_by_name (const gchar       *name,
+                                  pa_sink_info_cb_t  cb,
+                                  gpointer           userdata)
+{
+  return xvd_replay_op_new (XVD_REPLAY_GET, XVD_RECORD_SINK, PA_INVALID_INDEX, name,
+                            G_CALLBACK (cb), userdata);
+}
+
+
+XvdReplayOp *
+xvd_replay_get_sink_info_by_index (guint32            index,
+                                   pa_sink_info_cb_t  cb,
+                                   gpointer           userdata)
+{
+  return xvd_replay_op_new (XVD_REPLAY_GET, XVD_RECORD_SINK, index, NULL,
+                            G_CALLBACK (cb), userdata);
+}
+
+
+XvdReplayOp *
+xvd_replay_get_sink_info_list (pa_sink_info_cb_t cb,
+                               gpointer          userdata)
+{
+  return xvd_replay_op_new (XVD_REPLAY_GET_LIST, XVD_RECORD_SINK, PA_INVALID_INDEX, NULL,
+                            G_CALLBACK (cb), userdata);
+}
+
+
+XvdReplayOp *
+xvd_replay_get_source_info_by_name (const gchar         *name,
+                                    pa_source_info_cb_t  cb,
+                                    gpointer             userdata)
+{
+  return xvd_replay_op_new (XVD_REPLAY_GET, XVD_RECORD_SOURCE, PA_INVALID_INDEX, name,
+                            G_CALLBACK (cb), userdata);
+}
+
+
+XvdReplayOp *
+xvd_replay_get_source_info_by_index (guint32              index,
+                                     pa_source_info_cb_t  cb,
+                                     gpointer             userdata)
+{
+  return xvd_replay_op_new (XVD_REPLAY_GET, XVD_RECORD_SOURCE, index, NULL,
+                            G_CALLBACK (cb), userdata);
+}
+
+
+XvdReplayOp *
+xvd_replay_get_source_info_list (pa_source_info_cb_t cb,
+                                 gpointer            userdata)
+{
+  return xvd_replay_op_new (XVD_REPLAY_GET_LIST, XVD_RECORD_SOURCE, PA_INVALID_INDEX, NULL,
+                            G_CALLBACK (cb), userdata);
+}
+
+
+XvdReplayOp *
+xvd_replay_get_sink_input_info (guint32                  index,
+                                pa_sink_input_info_cb_t  cb,
+                                gpointer                 userdata)
+{
+  return xvd_replay_op_new (XVD_REPLAY_GET, XVD_RECORD_SINK_INPUT, index, NULL,
+                            G_CALLBACK (cb), userdata);
+}
+
+
+XvdReplayOp *
+xvd_replay_get_sink_input_info_list (pa_sink_input_info_cb_t cb,
+                                     gpointer                userdata)
+{
+  return xvd_replay_op_new (XVD_REPLAY_GET_LIST, XVD_RECORD_SINK_INPUT, PA_INVALID_INDEX, NULL,
+                            G_CALLBACK (cb), userdata);
+}
+
+
+XvdReplayOp *
+xvd_replay_get_card_info_by_index (guint32            index,
+                                   pa_card_info_cb_t  cb,
+                                   gpointer           userdata)
+{
+  return xvd_replay_op_new (XVD_REPLAY_GET, XVD_RECORD_CARD, index, NULL,
+                            G_CALLBACK (cb), userdata);
+}
+
+
+XvdReplayOp *
+xvd_replay_get_card_info_list (pa_card_info_cb_t cb,
+                               gpointer          userdata)
+{
+  return xvd_replay_op_new (XVD_REPLAY_GET_LIST, XVD_RECORD_CARD, PA_INVALID_INDEX, NULL,
+                            G_CALLBACK (cb), userdata);
+}
+
+
+XvdReplayOp *
+xvd_replay_set_sink_volume_by_index (guint32                  index,
+                                     const pa_cvolume        *volume,
+                                     pa_context_success_cb_t  cb,
+                                     gpointer                 userdata)
+{
+  XvdReplayOp *op;
+
+  op = xvd_replay_op_new (XVD_REPLAY_SET_VOLUME, XVD_RECORD_SINK, index, NULL,
+                          G_CALLBACK (cb), userdata);
+  op->volume = *volume;
+  return op;
+}
+
+
+XvdReplayOp *
+xvd_replay_set_sink_mute_by_index (guint32                  index,
+                                   gint                     mute,
+                                   pa_context_success_cb_t  cb,
+                                   gpointer                 userdata)
+{
+  XvdReplayOp *op;
+
+  op = xvd_replay_op_new (XVD_REPLAY_SET_MUTE, XVD_RECORD_SINK, index, NULL,
+                          G_CALLBACK (cb), userdata);
+  op->mute = (mute != 0);
+  return op;
+}
+
+
+XvdReplayOp *
+xvd_replay_set_source_mute_by_index (guint32                  index,
+                                     gint                     mute,
+                                     pa_context_success_cb_t  cb,
+                                     gpointer                 userdata)
+{
+  XvdReplayOp *op;
+
+  op = xvd_replay_op_new (XVD_REPLAY_SET_MUTE, XVD_RECORD_SOURCE, index, NULL,
+                          G_CALLBACK (cb), userdata);
+  op->mute = (mute != 0);
+  return op;
+}
+
+
+XvdReplayOp *
+xvd_replay_set_sink_input_volume (guint32                  index,
+                                  const pa_cvolume        *volume,
+                                  pa_context_success_cb_t  cb,
+                                  gpointer                 userdata)
+{
+  XvdReplayOp *op;
+
+  op = xvd_replay_op_new (XVD_REPLAY_SET_VOLUME, XVD_RECORD_SINK_INPUT, index, NULL,
+                          G_CALLBACK (cb), userdata);
+  op->volume = *volume;
+  return op;
+}
+
+
+XvdReplayOp *
+xvd_replay_set_default_sink (const gchar             *name,
+                             pa_context_success_cb_t  cb,
+                             gpointer                 userdata)
+{
+  return xvd_replay_op_new (XVD_REPLAY_SET_DEFAULT, XVD_RECORD_SINK, PA_INVALID_INDEX, name,
+                            G_CALLBACK (cb), userdata);
+}
+
+
+gboolean
+xvd_replay_op_running (XvdReplayOp *op)
+{
+  return op->state == PA_OPERATION_RUNNING;
+}
+
+
+void
+xvd_replay_op_cancel (XvdReplayOp *op)
+{
+  if (op->state == PA_OPERATION_RUNNING)
+    op->state = PA_OPERATION_CANCELLED;
+}
+
+
+void
+xvd_replay_op_unref (XvdReplayOp *op)
+{
+  if (--op->ref_count > 0)
+    return;
+
+  g_free (op->name);
+  g_free (op);
+}
+
+
+static gboolean
+xvd_replay_report (gpointer data)
+{
+  XvdInstance *i = (XvdInstance *) data;
+
+  XVD_DISPATCH_TAG ();
+
+  xvd_replay_source = 0;
+  g_print ("replayed %" G_GSIZE_FORMAT " events in %" G_GINT64_FORMAT " ms\n",
+           xvd_replay_events, (g_get_monotonic_time () - xvd_replay_origin) / 1000);
+  g_print ("introspections: %" G_GUINT64_FORMAT "\n",
+           i->stats.introspections - xvd_replay_introspections);
+  g_print ("notifications: %" G_GUINT64_FORMAT "\n",
+           i->stats.notifications_sent - xvd_replay_notifications);
+  g_print ("notifications saved: %" G_GUINT64_FORMAT "\n",
+           i->stats.notifications_saved - xvd_replay_notifications_saved);
+  g_print ("cpu time: %" G_GINT64_FORMAT " us\n",
+           xvd_replay_cpu_time () - xvd_replay_cpu);
+
+  g_main_loop_quit (i->loop);
+  return G_SOURCE_REMOVE;
+}
+
+
+static gboolean
+xvd_replay_step (gpointer data)
+{
+  XvdInstance *i = (XvdInstance *) data;
+  gsize        count = xvd_replay_entries->len;
+  gsize        batch = 0;
+  gint64       elapsed;
+
+  XVD_DISPATCH_TAG ();
+
+  elapsed = g_get_monotonic_time () - xvd_replay_origin;
+
+  /* the replayed server belongs to the PulseAudio thread */
+  xvd_pulse_lock (i);
+  while (xvd_replay_next < count)
+    {
+      XvdReplayEntry *entry = &g_array_index (xvd_replay_entries, XvdReplayEntry, xvd_replay_next);
+      guint32         type, index;
+
+      if (xvd_replay_realtime ? (gint64) entry->time > elapsed : batch == XVD_REPLAY_BATCH)
+        break;
+      xvd_replay_next++;
+
+      xvd_replay_apply (entry);
+      if (entry->kind != XVD_RECORD_EVENT)
+        continue;
+
+      /* the server is in the state it replied with before telling */
+      while (xvd_replay_next < count
+             && g_array_index (xvd_replay_entries, XvdReplayEntry, xvd_replay_next).kind != XVD_RECORD_EVENT)
+        xvd_replay_apply (&g_array_index (xvd_replay_entries, XvdReplayEntry, xvd_replay_next++));
+
+      g_variant_get (entry->payload, "(uu)", &type, &index);
+      xvd_pulse_inject_event (i, type, index);
+      batch++;
+    }
+  xvd_pulse_unlock (i);
+
+  if (xvd_replay_next == count)
+    {
+      xvd_replay_source = g_timeout_add (XVD_REPLAY_DRAIN_TIME, xvd_replay_report, i);
+      return G_SOURCE_REMOVE;
+    }
+
+  /* sleep until the next event is due */
+  if (xvd_replay_realtime)
+    {
+      gint64 wait = g_array_index (xvd_replay_entries, XvdReplayEntry, xvd_replay_next).time - elapsed;
+
+      xvd_replay_source = g_timeout_add (MAX (wait / 1000, 1), xvd_replay_step, i);
+      return G_SOURCE_REMOVE;
+    }
+
+  return G_SOURCE_CONTINUE;
+}
+
+
+static gboolean
+xvd_replay_begin (gpointer data)
+{
+  XvdInstance *i = (XvdInstance *) data;
+
+  XVD_DISPATCH_TAG ();
+
+  xvd_replay_origin = g_get_monotonic_time ();
+  xvd_replay_introspections = i->stats.introspections;
+  xvd_replay_notifications = i->stats.notifications_sent;
+  xvd_replay_notifications_saved = i->stats.notifications_saved;
+  xvd_replay_cpu = xvd_replay_cpu_time ();
+
+  /* the times count from the first event */
+  if (xvd_replay_next < xvd_replay_entries->len)
+    xvd_replay_origin -= g_array_index (xvd_replay_entries, XvdReplayEntry, xvd_replay_next).time;
+
+  if (xvd_replay_realtime)
+    {
+      xvd_replay_source = 0;
+      xvd_replay_step (i);
+    }
+  else
+    xvd_replay_source = g_idle_add (xvd_replay_step, i);
+
+  return G_SOURCE_REMOVE;
+}
+
+
+void
+xvd_replay_connected (XvdInstance *i)
+{
+  /* from the PulseAudio thread when there's one, the replies to the
+     requests made on connection go first */
+  xvd_replay_source = g_idle_add (xvd_replay_begin, i);
+}
+
+
+static void
+xvd_replay_entry_clear (gpointer data)
+{
+  g_variant_unref (((XvdReplayEntry *) data)->payload);
+}
+
+
+/**
+ * Splits the recording in @contents into entries, returns FALSE if it
+ * isn't one.
+ */
+static gboolean
+xvd_replay_parse (gchar *contents,
+                  gsize  length)
+{
+  XvdRecordHeader header;
+  GBytes         *bytes;
+  gsize           offset = sizeof (header);
+  gboolean        ret;
+
+  bytes = g_bytes_new_take (contents, length);
+
+  if (length < sizeof (header))
+    ret = FALSE;
+  else
+    {
+      memcpy (&header, contents, sizeof (header));
+      ret = (header.magic == XVD_RECORD_MAGIC && header.version == XVD_RECORD_VERSION);
+    }
+
+  while (ret && offset < length)
+    {
+      XvdReplayEntry  entry;
+      GVariant       *variant;
+      GBytes         *data;
+      guint64         size;
+
+      if (length - offset < sizeof (size))
+        {
+          ret = FALSE;
+          break;
+        }
+      memcpy (&size, contents + offset, sizeof (size));
+      offset += sizeof (size);
+      if (size > length - offset)
+        {
+          ret = FALSE;
+          break;
+        }
+
+      data = g_bytes_new_from_bytes (bytes, offset, size);
+      variant = g_variant_ref_sink (g_variant_new_from_bytes (G_VARIANT_TYPE (XVD_RECORD_ENTRY_TYPE), data, FALSE));
+      g_bytes_unref (data);
+      offset += MIN (XVD_RECORD_ALIGN (size), length - offset);
+
+      g_variant_get (variant, XVD_RECORD_ENTRY_TYPE, &entry.time, &entry.kind, &entry.payload);
+      g_variant_unref (variant);
+
+      if (entry.kind >= XVD_RECORD_N
+          || !g_variant_is_of_type (entry.payload, G_VARIANT_TYPE (xvd_record_types[entry.kind])))
+        {
+          g_variant_unref (entry.payload);
+          ret = FALSE;
+          break;
+        }
+
+      g_array_append_val (xvd_replay_entries, entry);
+      if (entry.kind == XVD_RECORD_EVENT)
+        xvd_replay_events++;
+    }
+  g_bytes_unref (bytes);
+
+  return ret;
+}
+
+
+gboolean
+xvd_replay_start (XvdInstance *i,
+                  const gchar *path,
+                  gboolean     realtime)
+{
+  gchar  *contents = NULL;
+  gsize   length = 0;
+  GError *error = NULL;
+  guint   kind;
+
+  if (!g_file_get_contents (path, &contents, &length, &error))
+    {
+      g_warning ("xvd_replay_start: %s", error->message);
+      g_error_free (error);
+      return FALSE;
+    }
+
+  xvd_replay_entries = g_array_new (FALSE, FALSE, sizeof (XvdReplayEntry));
+  g_array_set_clear_func (xvd_replay_entries, xvd_replay_entry_clear);
+  xvd_replay_events = 0;
+
+  /* takes the contents */
+  if (!xvd_replay_parse (contents, length))
+    {
+      g_warning ("xvd_replay_start: %s is not a recording", path);
+      xvd_replay_stop ();
+      return FALSE;
+    }
+
+  for (kind = XVD_RECORD_SINK; kind <= XVD_RECORD_CARD; kind++)
+    xvd_replay_objects[kind] = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+                                                      NULL, (GDestroyNotify) g_variant_unref);
+
+  /* the server as it was when the recording started */
+  for (xvd_replay_next = 0; xvd_replay_next < xvd_replay_entries->len; xvd_replay_next++)
+    {
+      XvdReplayEntry *entry = &g_array_index (xvd_replay_entries, XvdReplayEntry, xvd_replay_next);
+
+      if (entry->kind == XVD_RECORD_EVENT)
+        break;
+      xvd_replay_apply (entry);
+    }
+
+  xvd_replay_instance = i;
+  xvd_replay_realtime = realtime;
+
+  /* no server, the daemon talks to this one */
+  i->pa_replay = TRUE;
+  return TRUE;
+}
+
+
+void
+xvd_replay_set_write_func (XvdReplayWriteFunc func,
+                           gpointer           userdata)
+{
+  xvd_replay_write_func = func;
+  xvd_replay_write_data = userdata;
+}
+
+
+void
+xvd_replay_stop (void)
+{
+  XvdReplayOp *op;
+  guint        kind;
+
+  while ((op = g_queue_pop_head (&xvd_replay_ops)))
+    xvd_replay_op_unref (op);
+
+  /* stopped before the end */
+  if (xvd_replay_source != 0)
+    {
+      g_source_remove (xvd_replay_source);
+      xvd_replay_source = 0;
+    }
+
+  if (xvd_replay_answer_event)
+    {
+      xvd_replay_instance->pa_api->defer_free (xvd_replay_answer_event);
+      xvd_replay_answer_event = NULL;
+    }
+
+  for (kind = 0; kind < XVD_RECORD_N; kind++)
+    g_clear_pointer (&xvd_replay_objects[kind], g_hash_table_destroy);
+  xvd_replay_default_sink = PA_INVALID_INDEX;
+  xvd_replay_default_source = PA_INVALID_INDEX;
+
+  if (xvd_replay_entries)
+    {
+      g_array_free (xvd_replay_entries, TRUE);
+      xvd_replay_entries = NULL;
+    }
+  xvd_replay_instance = NULL;
+}
@@ -0,0 +1,171 @@
+/*
+ *  xfce4-volumed-pulse - Volume management daemon for XFCE 4 (Pulseaudio variant)
+ *
+ *  Copyright © 2026 The Xfce Development Team
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _XVD_RECORD_H
+#define _XVD_RECORD_H
+
+#include <pulse/introspect.h>
+#include <pulse/subscribe.h>
+
+#include "xvd_data_types.h"
+
+
+/**
+ * Starts writing the subscription events, and the server replies
+ * describing the devices and streams, to @path. Returns FALSE if it can't
+ * be created.
+ */
+gboolean     xvd_record_start                     (const gchar                  *path);
+
+/**
+ * Appends an event to the recording, if any.
+ */
+void         xvd_record_event                     (pa_subscription_event_type_t  t,
+                                                   guint32                       index);
+
+/**
+ * Appends what the server told about a device or stream to the recording,
+ * if any. Only the fields the daemon reads are kept.
+ */
+void         xvd_record_sink                      (const pa_sink_info           *info);
+void         xvd_record_source                    (const pa_source_info         *info);
+void         xvd_record_sink_input                (const pa_sink_input_info     *info);
+void         xvd_record_card                      (const pa_card_info           *info);
+
+/**
+ * Appends the default sink or source to the recording, if any.
+ * PA_INVALID_INDEX if the server has none.
+ */
+void         xvd_record_default_sink              (guint32                       index);
+void         xvd_record_default_source            (guint32                       index);
+
+/**
+ * Closes the recording, if any.
+ */
+void         xvd_record_stop                      (void);
+
+/**
+ * Loads the recording in @path, the daemon then talks to the server it
+ * describes instead of a real one: its requests are answered from the
+ * recorded state, its writes change that state. Once the daemon is
+ * connected, the events are fed to it as fast as possible or with their
+ * original timing if @realtime, then what they cost is reported and the
+ * main loop quits.
+ */
+gboolean     xvd_replay_start                     (XvdInstance                  *i,
+                                                   const gchar                  *path,
+                                                   gboolean                      realtime);
+
+/**
+ * Starts feeding the events, called once the daemon is connected.
+ */
+void         xvd_replay_connected                 (XvdInstance                  *i);
+
+/**
+ * Drops the recording and the requests not yet answered.
+ */
+void         xvd_replay_stop                      (void);
+
+/**
+ * Tells about a write to a device or stream of the replayed server, in
+ * the order it applies them: @facility is a PA_SUBSCRIPTION_EVENT_* one,
+ * @volume is NULL for a mute change, @mute -1 for a volume change.
+ */
+typedef void (*XvdReplayWriteFunc) (guint32                       facility,
+                                    guint32                       index,
+                                    const pa_cvolume             *volume,
+                                    gint                          mute,
+                                    gpointer                      userdata);
+
+/**
+ * Has @func called for each write to the replayed server, for the tests.
+ * NULL to stop.
+ */
+void         xvd_replay_set_write_func            (XvdReplayWriteFunc            func,
+                                                   gpointer                      userdata);
+
+/**
+ * A request to the replayed server. Like a pa_operation, its callback
+ * runs from the main loop, never before the request returns, and not at
+ * all once cancelled.
+ */
+typedef struct _XvdReplayOp XvdReplayOp;
+
+/**
+ * The libpulse requests the daemon makes, without the context.
+ */
+XvdReplayOp *xvd_replay_get_sink_info_by_name     (const gchar                  *name,
+                                                   pa_sink_info_cb_t             cb,
+                                                   gpointer                      userdata);
+XvdReplayOp *xvd_replay_get_sink_info_by_index    (guint32                       index,
+                                                   pa_sink_info_cb_t             cb,
+                                                   gpointer                      userdata);
+XvdReplayOp *xvd_replay_get_sink_info_list        (pa_sink_info_cb_t             cb,
+                                                   gpointer                      userdata);
+XvdReplayOp *xvd_replay_get_source_info_by_name   (const gchar                  *name,
+                                                   pa_source_info_cb_t           cb,
+                                                   gpointer                      userdata);
+XvdReplayOp *xvd_replay_get_source_info_by_index  (guint32                       index,
+                                                   pa_source_info_cb_t           cb,
+                                                   gpointer                      userdata);
+XvdReplayOp *xvd_replay_get_source_info_list      (pa_source_info_cb_t           cb,
+                                                   gpointer                      userdata);
+XvdReplayOp *xvd_replay_get_sink_input_info       (guint32                       index,
+                                                   pa_sink_input_info_cb_t       cb,
+                                                   gpointer                      userdata);
+XvdReplayOp *xvd_replay_get_sink_input_info_list  (pa_sink_input_info_cb_t       cb,
+                                                   gpointer                      userdata);
+XvdReplayOp *xvd_replay_get_card_info_by_index    (guint32                       index,
+                                                   pa_card_info_cb_t             cb,
+                                                   gpointer                      userdata);
+XvdReplayOp *xvd_replay_get_card_info_list        (pa_card_info_cb_t             cb,
+                                                   gpointer                      userdata);
+XvdReplayOp *xvd_replay_set_sink_volume_by_index  (guint32                       index,
+                                                   const pa_cvolume             *volume,
+                                                   pa_context_success_cb_t       cb,
+                                                   gpointer                      userdata);
+XvdReplayOp *xvd_replay_set_sink_mute_by_index    (guint32                       index,
+                                                   gint                          mute,
+                                                   pa_context_success_cb_t       cb,
+                                                   gpointer                      userdata);
+XvdReplayOp *xvd_replay_set_source_mute_by_index  (guint32                       index,
+                                                   gint                          mute,
+                                                   pa_context_success_cb_t       cb,
+                                                   gpointer                      userdata);
+XvdReplayOp *xvd_replay_set_sink_input_volume     (guint32                       index,
+                                                   const pa_cvolume             *volume,
+                                                   pa_context_success_cb_t       cb,
+                                                   gpointer                      userdata);
+XvdReplayOp *xvd_replay_set_default_sink          (const gchar                  *name,
+                                                   pa_context_success_cb_t       cb,
+                                                   gpointer                      userdata);
+
+/**
+ * Returns whether @op still has to be answered.
+ */
+gboolean     xvd_replay_op_running                (XvdReplayOp                  *op);
+
+/**
+ * Keeps the callback of @op from running.
+ */
+void         xvd_replay_op_cancel                 (XvdReplayOp                  *op);
+
+void         xvd_replay_op_unref                  (XvdReplayOp                  *op);
+
+#endif
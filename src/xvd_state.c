@@ -0,0 +1,81 @@
+/*
+ *  xfce4-volumed-pulse - Volume management daemon for XFCE 4 (Pulseaudio variant)
+ *
+ *  Copyright © 2026 The Xfce Development Team
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+
+#include "xvd_state.h"
+
+/* bumped whenever XvdState changes */
+#define XVD_STATE_MAGIC 0x58564401
+
+/* $XDG_RUNTIME_DIR is per-session and cleared on logout */
+#define XVD_STATE_FILE  "xfce4-volumed-pulse.state"
+
+
+static gchar *
+xvd_state_path (void)
+{
+  return g_build_filename (g_get_user_runtime_dir (), XVD_STATE_FILE, NULL);
+}
+
+
+gboolean
+xvd_state_load (XvdState *state)
+{
+  gchar    *path = xvd_state_path ();
+  gchar    *contents = NULL;
+  gsize     length = 0;
+  gboolean  ret = FALSE;
+
+  if (g_file_get_contents (path, &contents, &length, NULL)
+      && length == sizeof (XvdState))
+    {
+      memcpy (state, contents, sizeof (XvdState));
+      state->sink_name[sizeof (state->sink_name) - 1] = '\0';
+      ret = state->magic == XVD_STATE_MAGIC
+            && pa_cvolume_valid (&state->volume);
+    }
+
+  if (!ret)
+    g_debug ("xvd_state_load: no usable state in %s", path);
+
+  g_free (contents);
+  g_free (path);
+  return ret;
+}
+
+
+void
+xvd_state_save (const XvdState *state)
+{
+  gchar    *path = xvd_state_path ();
+  XvdState  copy = *state;
+  GError   *error = NULL;
+
+  copy.magic = XVD_STATE_MAGIC;
+
+  /* written to a temporary file then renamed, never seen half written */
+  if (!g_file_set_contents (path, (const gchar *) &copy, sizeof (copy), &error))
+    {
+      g_warning ("xvd_state_save: %s", error->message);
+      g_error_free (error);
+    }
+
+  g_free (path);
+}
@@ -0,0 +1,53 @@
+/*
+ *  xfce4-volumed-pulse - Volume management daemon for XFCE 4 (Pulseaudio variant)
+ *
+ *  Copyright © 2026 The Xfce Development Team
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _XVD_STATE_H
+#define _XVD_STATE_H
+
+#include <pulse/volume.h>
+
+#include "xvd_data_types.h"
+
+
+/**
+ * The last known state of the default sink, saved across restarts so
+ * the first key press after login is shown without waiting for the
+ * server. The file is only ever read by the same build, on the same
+ * machine, so it holds the struct as is.
+ */
+typedef struct {
+  guint32    magic;
+  guint32    sink_index;
+  gchar      sink_name[128];
+  pa_cvolume volume;
+  gint32     mute;
+} XvdState;
+
+
+/**
+ * Reads the saved state, returns FALSE if there's none or it is unusable.
+ */
+gboolean xvd_state_load (XvdState       *state);
+
+/**
+ * Replaces the saved state.
+ */
+void     xvd_state_save (const XvdState *state);
+
+#endif
@@ -0,0 +1,140 @@
+/*
+ *  xfce4-volumed-pulse - Volume management daemon for XFCE 4 (Pulseaudio variant)
+ *
+ *  Copyright © 2026 The Xfce Development Team
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+
+#include "xvd_pulse.h"
+#include "xvd_stats.h"
+
+
+static const gchar *xvd_op_names[XVD_OP_N] =
+{
+  "sink-volume",
+  "sink-mute",
+  "source-mute",
+  "stream-volume",
+};
+
+static const gchar *xvd_facility_names[XVD_FACILITY_N] =
+{
+  "sink",
+  "source",
+  "server",
+  "sink-input",
+  "card",
+  "other",
+};
+
+
+void
+xvd_stats_init (XvdInstance *i)
+{
+  memset (&i->stats, 0, sizeof (i->stats));
+  i->stats.disconnected_since = g_get_monotonic_time ();
+}
+
+
+void
+xvd_stats_set_connected (XvdInstance *i,
+                         gboolean     connected)
+{
+  if (connected && i->stats.disconnected_since != 0)
+    {
+      i->stats.disconnected_time += g_get_monotonic_time () - i->stats.disconnected_since;
+      i->stats.disconnected_since = 0;
+    }
+  else if (!connected && i->stats.disconnected_since == 0)
+    i->stats.disconnected_since = g_get_monotonic_time ();
+}
+
+
+GVariant *
+xvd_stats_to_variant (XvdInstance *i)
+{
+  GVariantBuilder builder;
+  gchar           key[64];
+  gint64          disconnected;
+  guint           n;
+
+  /* most counters are updated by the PulseAudio thread, if any */
+  xvd_pulse_lock (i);
+
+  disconnected = i->stats.disconnected_time;
+  if (i->stats.disconnected_since != 0)
+    disconnected += g_get_monotonic_time () - i->stats.disconnected_since;
+
+  g_variant_builder_init (&builder, G_VARIANT_TYPE ("a{st}"));
+
+  for (n = 0; n < XVD_OP_N; n++)
+    {
+      g_snprintf (key, sizeof (key), "ops-%s", xvd_op_names[n]);
+      g_variant_builder_add (&builder, "{st}", key, i->stats.ops_issued[n]);
+      g_snprintf (key, sizeof (key), "ops-%s-failed", xvd_op_names[n]);
+      g_variant_builder_add (&builder, "{st}", key, i->stats.ops_failed[n]);
+    }
+
+  for (n = 0; n < XVD_FACILITY_N; n++)
+    {
+      g_snprintf (key, sizeof (key), "events-%s", xvd_facility_names[n]);
+      g_variant_builder_add (&builder, "{st}", key, i->stats.events[n]);
+    }
+
+  g_variant_builder_add (&builder, "{st}", "introspections", i->stats.introspections);
+  g_variant_builder_add (&builder, "{st}", "notifications", i->stats.notifications_sent);
+  g_variant_builder_add (&builder, "{st}", "notifications-failed", i->stats.notifications_failed);
+  g_variant_builder_add (&builder, "{st}", "notifications-fullscreen", i->stats.notifications_fullscreen);
+  g_variant_builder_add (&builder, "{st}", "notifications-saved", i->stats.notifications_saved);
+  g_variant_builder_add (&builder, "{st}", "reconnects", i->stats.reconnects);
+  g_variant_builder_add (&builder, "{st}", "disconnected-ms", (guint64) (disconnected / 1000));
+  g_variant_builder_add (&builder, "{st}", "connect-to-sink-us", (guint64) i->stats.connect_latency);
+  g_variant_builder_add (&builder, "{st}", "stalls", (guint64) g_atomic_int_get (&i->stats.stalls));
+
+  xvd_pulse_unlock (i);
+
+  return g_variant_builder_end (&builder);
+}
+
+
+gchar *
+xvd_stats_format (GVariant *stats)
+{
+  GString      *str = g_string_new (NULL);
+  GVariantIter  iter;
+  const gchar  *key;
+  guint64       value;
+
+  g_variant_iter_init (&iter, stats);
+  while (g_variant_iter_next (&iter, "{&st}", &key, &value))
+    g_string_append_printf (str, "%s: %" G_GUINT64_FORMAT "\n", key, value);
+
+  return g_string_free (str, FALSE);
+}
+
+
+void
+xvd_stats_log (XvdInstance *i)
+{
+  GVariant *stats = g_variant_ref_sink (xvd_stats_to_variant (i));
+  gchar    *dump = xvd_stats_format (stats);
+
+  g_message ("Runtime statistics:\n%s", dump);
+
+  g_free (dump);
+  g_variant_unref (stats);
+}
@@ -0,0 +1,52 @@
+/*
+ *  xfce4-volumed-pulse - Volume management daemon for XFCE 4 (Pulseaudio variant)
+ *
+ *  Copyright © 2026 The Xfce Development Team
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _XVD_STATS_H
+#define _XVD_STATS_H
+
+#include "xvd_data_types.h"
+
+
+/**
+ * Resets the counters, the daemon starts disconnected.
+ */
+void      xvd_stats_init          (XvdInstance *i);
+
+/**
+ * Accounts for the time spent without a usable PulseAudio context.
+ */
+void      xvd_stats_set_connected (XvdInstance *i,
+                                   gboolean     connected);
+
+/**
+ * Returns the counters as a floating a{st} dictionary.
+ */
+GVariant *xvd_stats_to_variant    (XvdInstance *i);
+
+/**
+ * Returns a human readable dump of an a{st} dictionary, to be freed.
+ */
+gchar    *xvd_stats_format        (GVariant    *stats);
+
+/**
+ * Writes the counters to the log.
+ */
+void      xvd_stats_log           (XvdInstance *i);
+
+#endif
@@ -0,0 +1,134 @@
+/*
+ *  xfce4-volumed-pulse - Volume management daemon for XFCE 4 (Pulseaudio variant)
+ *
+ *  Copyright © 2026 The Xfce Development Team
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+
+#include "xvd_streams.h"
+
+
+static void
+xvd_stream_free (gpointer data)
+{
+  XvdStream *stream = (XvdStream *) data;
+
+  g_free (stream->app_name);
+  g_free (stream);
+}
+
+
+GHashTable *
+xvd_streams_new (void)
+{
+  return g_hash_table_new_full (g_direct_hash,
+                                g_direct_equal,
+                                NULL,
+                                xvd_stream_free);
+}
+
+
+XvdStream *
+xvd_streams_update (GHashTable               *streams,
+                    const pa_sink_input_info *info)
+{
+  XvdStream   *stream;
+  const gchar *name;
+  const gchar *pid;
+
+  stream = g_hash_table_lookup (streams, GUINT_TO_POINTER (info->index));
+  if (!stream)
+    {
+      stream = g_new0 (XvdStream, 1);
+      stream->index = info->index;
+      g_hash_table_insert (streams, GUINT_TO_POINTER (info->index), stream);
+    }
+
+  /* the properties don't change once set, don't copy them every time */
+  if (!stream->app_name)
+    {
+      name = pa_proplist_gets (info->proplist, PA_PROP_APPLICATION_NAME);
+      stream->app_name = g_strdup (name ? name : info->name);
+      pid = pa_proplist_gets (info->proplist, PA_PROP_APPLICATION_PROCESS_ID);
+      stream->pid = pid ? atoi (pid) : 0;
+    }
+
+  stream->volume = info->volume;
+  stream->has_volume = info->has_volume && info->volume_writable;
+  stream->corked = info->corked;
+  if (!stream->corked)
+    stream->last_active = g_get_monotonic_time ();
+
+  return stream;
+}
+
+
+void
+xvd_streams_remove (GHashTable *streams,
+                    guint32     index)
+{
+  g_hash_table_remove (streams, GUINT_TO_POINTER (index));
+}
+
+
+/**
+ * Picks the stream that played last, of process @pid if not 0.
+ */
+static XvdStream *
+xvd_streams_pick (GHashTable *streams,
+                  gint        pid)
+{
+  GHashTableIter iter;
+  gpointer       value;
+  XvdStream     *best = NULL;
+
+  g_hash_table_iter_init (&iter, streams);
+  while (g_hash_table_iter_next (&iter, NULL, &value))
+    {
+      XvdStream *stream = (XvdStream *) value;
+
+      if (!stream->has_volume || (pid != 0 && stream->pid != pid))
+        continue;
+
+      if (best == NULL
+          || (best->corked && !stream->corked)
+          || (best->corked == stream->corked
+              && (stream->last_active > best->last_active
+                  || (stream->last_active == best->last_active
+                      && stream->index > best->index))))
+        best = stream;
+    }
+
+  return best;
+}
+
+
+XvdStream *
+xvd_streams_most_recent (GHashTable *streams)
+{
+  return xvd_streams_pick (streams, 0);
+}
+
+
+XvdStream *
+xvd_streams_find_pid (GHashTable *streams,
+                      gint        pid)
+{
+  g_return_val_if_fail (pid > 0, NULL);
+
+  return xvd_streams_pick (streams, pid);
+}
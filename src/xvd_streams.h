@@ -0,0 +1,72 @@
+/*
+ *  xfce4-volumed-pulse - Volume management daemon for XFCE 4 (Pulseaudio variant)
+ *
+ *  Copyright © 2026 The Xfce Development Team
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _XVD_STREAMS_H
+#define _XVD_STREAMS_H
+
+#include <pulse/introspect.h>
+
+#include "xvd_data_types.h"
+
+
+/**
+ * What we know about a sink input (an application playing sound), kept up
+ * to date from the subscription events so that stream keys never have to
+ * query the server.
+ */
+typedef struct {
+  guint32    index;
+  gchar     *app_name;
+  gint       pid;         /* 0 if the client didn't say */
+  pa_cvolume volume;
+  gboolean   has_volume;  /* whether the volume can be changed at all */
+  gboolean   corked;
+  gint64     last_active; /* monotonic time it was last seen playing */
+} XvdStream;
+
+
+/**
+ * Creates an empty table of streams, by index.
+ */
+GHashTable *xvd_streams_new         (void);
+
+/**
+ * Adds or refreshes a stream from its infos.
+ */
+XvdStream  *xvd_streams_update      (GHashTable               *streams,
+                                     const pa_sink_input_info *info);
+
+/**
+ * Forgets a stream, if known.
+ */
+void        xvd_streams_remove      (GHashTable               *streams,
+                                     guint32                   index);
+
+/**
+ * Returns the stream that played last, uncorked ones first, or NULL.
+ */
+XvdStream  *xvd_streams_most_recent (GHashTable               *streams);
+
+/**
+ * Same as xvd_streams_most_recent(), among the streams of process @pid.
+ */
+XvdStream  *xvd_streams_find_pid    (GHashTable               *streams,
+                                     gint                      pid);
+
+#endif
@@ -0,0 +1,134 @@
+/*
+ *  xfce4-volumed-pulse - Volume management daemon for XFCE 4 (Pulseaudio variant)
+ *
+ *  Copyright © 2026 The Xfce Development Team
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "xvd_trace.h"
+
+/* records kept, a power of two */
+#define XVD_TRACE_SIZE    4096
+
+/* "XVDT", then the version of the records */
+#define XVD_TRACE_MAGIC   0x54445658
+#define XVD_TRACE_VERSION 1
+
+#define XVD_TRACE_FILE    "xfce4-volumed-pulse.trace"
+
+
+typedef struct {
+  gint64  time;   /* monotonic, in microseconds */
+  guint32 event;
+  guint32 index;
+  gint64  value;
+} XvdTraceRecord;
+
+typedef struct {
+  guint32 magic;
+  guint32 version;
+  guint32 size;   /* records in the ring */
+  guint32 next;   /* records ever written, the oldest is at next % size */
+} XvdTraceHeader;
+
+
+static XvdTraceRecord xvd_trace_ring[XVD_TRACE_SIZE];
+static gint           xvd_trace_next = 0;
+static gchar          xvd_trace_path[4096] = "";
+
+static const int      xvd_trace_crash_signals[] = { SIGSEGV, SIGBUS, SIGFPE, SIGILL, SIGABRT };
+
+
+void
+xvd_trace_add (XvdTraceEvent event,
+               guint32       index,
+               gint64        value)
+{
+  /* each writer owns its slot, a reader may see a torn record at worst */
+  guint           n = (guint) g_atomic_int_add (&xvd_trace_next, 1);
+  XvdTraceRecord *record = &xvd_trace_ring[n & (XVD_TRACE_SIZE - 1)];
+
+  record->time = g_get_monotonic_time ();
+  record->event = event;
+  record->index = index;
+  record->value = value;
+}
+
+
+gboolean
+xvd_trace_dump (void)
+{
+  XvdTraceHeader header;
+  gint           fd;
+  gboolean       ret;
+
+  if (xvd_trace_path[0] == '\0')
+    return FALSE;
+
+  header.magic = XVD_TRACE_MAGIC;
+  header.version = XVD_TRACE_VERSION;
+  header.size = XVD_TRACE_SIZE;
+  header.next = (guint32) g_atomic_int_get (&xvd_trace_next);
+
+  fd = open (xvd_trace_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+  if (fd < 0)
+    return FALSE;
+
+  ret = write (fd, &header, sizeof (header)) == sizeof (header)
+        && write (fd, xvd_trace_ring, sizeof (xvd_trace_ring)) == sizeof (xvd_trace_ring);
+  close (fd);
+
+  return ret;
+}
+
+
+static void
+xvd_trace_crash (int sig)
+{
+  xvd_trace_dump ();
+
+  /* SA_RESETHAND put the default action back, let it run */
+  raise (sig);
+}
+
+
+void
+xvd_trace_init (void)
+{
+  struct sigaction action;
+  gchar           *path;
+  guint            n;
+
+  /* computed now, the crash handler can't allocate */
+  path = g_build_filename (g_get_user_runtime_dir (), XVD_TRACE_FILE, NULL);
+  g_strlcpy (xvd_trace_path, path, sizeof (xvd_trace_path));
+  g_free (path);
+
+  memset (&action, 0, sizeof (action));
+  action.sa_handler = xvd_trace_crash;
+  action.sa_flags = SA_RESETHAND;
+  sigemptyset (&action.sa_mask);
+
+  for (n = 0; n < G_N_ELEMENTS (xvd_trace_crash_signals); n++)
+    if (sigaction (xvd_trace_crash_signals[n], &action, NULL) < 0)
+      g_warning ("xvd_trace_init: can't catch signal %d: %s",
+                 xvd_trace_crash_signals[n], g_strerror (errno));
+}
@@ -0,0 +1,82 @@
+/*
+ *  xfce4-volumed-pulse - Volume management daemon for XFCE 4 (Pulseaudio variant)
+ *
+ *  Copyright © 2026 The Xfce Development Team
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _XVD_TRACE_H
+#define _XVD_TRACE_H
+
+#include "xvd_data_types.h"
+
+
+/**
+ * What a trace record is about, and what its index and value mean.
+ */
+typedef enum _XvdTraceEvent
+{
+  XVD_TRACE_KEY_RAISE,          /* value: X time of the press */
+  XVD_TRACE_KEY_LOWER,
+  XVD_TRACE_KEY_STREAM_RAISE,
+  XVD_TRACE_KEY_STREAM_LOWER,
+  XVD_TRACE_KEY_MUTE,
+  XVD_TRACE_KEY_MIC_MUTE,
+  XVD_TRACE_KEY_MUTE_ALL,
+  XVD_TRACE_KEY_PTT_DOWN,
+  XVD_TRACE_KEY_PTT_UP,
+  XVD_TRACE_DEFERRED_VOLUME,    /* value: deferred percents so far */
+  XVD_TRACE_DEFERRED_MUTE,      /* value: deferred toggles so far */
+  XVD_TRACE_NO_STREAM,
+  XVD_TRACE_SERVER_EVENT,       /* index: object, value: event type */
+  XVD_TRACE_SINK_INFO,          /* index: sink, value: volume, -1 if muted */
+  XVD_TRACE_SOURCE_INFO,        /* index: source, value: mute */
+  XVD_TRACE_OP_SUBMIT,          /* index: XvdOpType, value: submitted */
+  XVD_TRACE_OP_DONE,            /* index: XvdOpType, value: success */
+  XVD_TRACE_WORK,               /* index: XvdWork */
+  XVD_TRACE_FOCUS,              /* index: pid, value: active window */
+  XVD_TRACE_NOTIFY,             /* index: server id, value: sent, 0 if it
+                                   failed, -1 if still on screen */
+  XVD_TRACE_N
+} XvdTraceEvent;
+
+
+/**
+ * Adds a record to the trace, see XvdTraceEvent for @index and @value.
+ * Safe from any thread, never allocates.
+ */
+#define XVD_TRACE(event, index, value) \
+  xvd_trace_add (XVD_TRACE_##event, (guint32) (index), (gint64) (value))
+
+
+/**
+ * Prepares the dump file name and dumps the trace on crashes.
+ */
+void     xvd_trace_init (void);
+
+/**
+ * Use XVD_TRACE() instead.
+ */
+void     xvd_trace_add  (XvdTraceEvent event,
+                         guint32       index,
+                         gint64        value);
+
+/**
+ * Writes the trace to $XDG_RUNTIME_DIR/xfce4-volumed-pulse.trace. Only
+ * uses async-signal-safe calls.
+ */
+gboolean xvd_trace_dump (void);
+
+#endif
@@ -0,0 +1,335 @@
+/*
+ *  xfce4-volumed-pulse - Volume management daemon for XFCE 4 (Pulseaudio variant)
+ *
+ *  Copyright © 2026 The Xfce Development Team
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+#include <unistd.h>
+
+#include "xvd_watchdog.h"
+
+/* time (in s) the daemon is given to connect before counting wakeups */
+#define XVD_WATCHDOG_SETTLE_TIME 3
+
+
+/* shared between the main loop and the watchdog thread */
+static gpointer   xvd_watchdog_current_tag = NULL;
+static gint       xvd_watchdog_busy = 0;
+static gint       xvd_watchdog_iteration = 0;
+static gint       xvd_watchdog_sleeping = 0;
+static gint       xvd_watchdog_io_wakeups = 0;
+static gint       xvd_watchdog_dispatch_start = 0;    /* ms, wraps */
+static gint       xvd_watchdog_stalled_iteration = -1;
+static gint       xvd_watchdog_stall_ms = -1;
+
+/* owned by the main thread */
+static GThread   *xvd_watchdog_main_thread = NULL;
+static GPollFunc  xvd_watchdog_orig_poll = NULL;
+static guint      xvd_watchdog_poll_users = 0;
+static GThread   *xvd_watchdog_thread = NULL;
+
+/* wakeup counting, owned by the main thread */
+static guint      xvd_watchdog_window = 0;
+static gint       xvd_watchdog_base = 0;
+static gint       xvd_watchdog_io_base = 0;
+static gint64     xvd_watchdog_sleeps_base = 0;
+static gint       xvd_watchdog_wakeups = -1;
+
+/* protected by xvd_watchdog_lock */
+static GMutex     xvd_watchdog_lock;
+static GCond      xvd_watchdog_cond;
+static gboolean   xvd_watchdog_running = FALSE;
+static gint64     xvd_watchdog_threshold = 0;
+
+
+/**
+ * Returns the monotonic time in ms, truncated: only differences of it
+ * make sense.
+ */
+static inline gint
+xvd_watchdog_now_ms (void)
+{
+  return (gint) (guint) (g_get_monotonic_time () / 1000);
+}
+
+
+/**
+ * Poll function of the default context, delimits the dispatch phases.
+ */
+static gint
+xvd_watchdog_poll (GPollFD *ufds,
+                   guint    nfds,
+                   gint     timeout)
+{
+  gint ret;
+
+  /* the dispatch phase the watchdog reported is over, time it */
+  if (g_atomic_int_get (&xvd_watchdog_stalled_iteration) == g_atomic_int_get (&xvd_watchdog_iteration))
+    g_atomic_int_set (&xvd_watchdog_stall_ms,
+                      (gint) ((guint) xvd_watchdog_now_ms ()
+                              - (guint) g_atomic_int_get (&xvd_watchdog_dispatch_start)));
+
+  g_atomic_pointer_set (&xvd_watchdog_current_tag, NULL);
+  g_atomic_int_set (&xvd_watchdog_busy, 0);
+
+  ret = xvd_watchdog_orig_poll (ufds, nfds, timeout);
+
+  /* the dispatch phase starts now, not when the watchdog notices */
+  g_atomic_int_set (&xvd_watchdog_dispatch_start, xvd_watchdog_now_ms ());
+  g_atomic_int_inc (&xvd_watchdog_iteration);
+  if (ret > 0)
+    g_atomic_int_inc (&xvd_watchdog_io_wakeups);
+  g_atomic_int_set (&xvd_watchdog_busy, 1);
+
+  /* the watchdog thread sleeps for good while the loop is idle */
+  if (g_atomic_int_get (&xvd_watchdog_sleeping))
+    {
+      g_mutex_lock (&xvd_watchdog_lock);
+      g_cond_signal (&xvd_watchdog_cond);
+      g_mutex_unlock (&xvd_watchdog_lock);
+    }
+
+  return ret;
+}
+
+
+/**
+ * Puts xvd_watchdog_poll() in place for one more user.
+ */
+static void
+xvd_watchdog_hook_poll (void)
+{
+  if (xvd_watchdog_poll_users++ > 0)
+    return;
+
+  xvd_watchdog_main_thread = g_thread_self ();
+  xvd_watchdog_orig_poll = g_main_context_get_poll_func (NULL);
+  g_main_context_set_poll_func (NULL, xvd_watchdog_poll);
+}
+
+
+static void
+xvd_watchdog_unhook_poll (void)
+{
+  if (xvd_watchdog_poll_users == 0 || --xvd_watchdog_poll_users > 0)
+    return;
+
+  g_main_context_set_poll_func (NULL, xvd_watchdog_orig_poll);
+  xvd_watchdog_main_thread = NULL;
+}
+
+
+static gpointer
+xvd_watchdog_run (gpointer data)
+{
+  XvdInstance *i = (XvdInstance *) data;
+  const gchar *tag = NULL;
+  gint64       threshold_ms = xvd_watchdog_threshold / 1000;
+
+  g_mutex_lock (&xvd_watchdog_lock);
+  while (xvd_watchdog_running)
+    {
+      gint64 elapsed;
+      gint   iteration, stall_ms;
+
+      /* nothing can stall while the loop waits in poll, don't wake up
+         until it returns */
+      g_atomic_int_set (&xvd_watchdog_sleeping, 1);
+      while (xvd_watchdog_running && !g_atomic_int_get (&xvd_watchdog_busy))
+        g_cond_wait (&xvd_watchdog_cond, &xvd_watchdog_lock);
+      g_atomic_int_set (&xvd_watchdog_sleeping, 0);
+
+      /* check once the dispatch phase in progress has run for the
+         threshold, counted from its start in the poll function */
+      iteration = g_atomic_int_get (&xvd_watchdog_iteration);
+      elapsed = (guint) xvd_watchdog_now_ms () - (guint) g_atomic_int_get (&xvd_watchdog_dispatch_start);
+      if (elapsed < threshold_ms)
+        g_cond_wait_until (&xvd_watchdog_cond,
+                           &xvd_watchdog_lock,
+                           g_get_monotonic_time () + (threshold_ms - elapsed) * 1000);
+      if (!xvd_watchdog_running)
+        break;
+
+      if (!g_atomic_int_get (&xvd_watchdog_busy)
+          || g_atomic_int_get (&xvd_watchdog_iteration) != iteration)
+        continue;
+
+      tag = g_atomic_pointer_get (&xvd_watchdog_current_tag);
+      g_atomic_int_inc (&i->stats.stalls);
+      g_atomic_int_set (&xvd_watchdog_stall_ms, -1);
+      g_atomic_int_set (&xvd_watchdog_stalled_iteration, iteration);
+      g_warning ("xvd_watchdog_run: main loop is blocked in %s",
+                 tag ? tag : "an unknown source");
+
+      /* the poll function times the stall when the loop gets back to it,
+         unless it did before seeing the flag */
+      while (xvd_watchdog_running
+             && g_atomic_int_get (&xvd_watchdog_iteration) == iteration
+             && g_atomic_int_get (&xvd_watchdog_stall_ms) < 0)
+        g_cond_wait_until (&xvd_watchdog_cond,
+                           &xvd_watchdog_lock,
+                           g_get_monotonic_time () + xvd_watchdog_threshold / 4);
+      g_atomic_int_set (&xvd_watchdog_stalled_iteration, -1);
+
+      stall_ms = g_atomic_int_get (&xvd_watchdog_stall_ms);
+      if (stall_ms >= 0)
+        g_warning ("xvd_watchdog_run: main loop was blocked for %d ms in %s",
+                   stall_ms, tag ? tag : "an unknown source");
+    }
+  g_mutex_unlock (&xvd_watchdog_lock);
+
+  return NULL;
+}
+
+
+void
+xvd_watchdog_start (XvdInstance *i,
+                    guint        threshold_ms)
+{
+  if (xvd_watchdog_thread || threshold_ms == 0)
+    return;
+
+  xvd_watchdog_hook_poll ();
+
+  xvd_watchdog_threshold = (gint64) threshold_ms * 1000;
+  xvd_watchdog_running = TRUE;
+  xvd_watchdog_thread = g_thread_new ("xvd-watchdog", xvd_watchdog_run, i);
+}
+
+
+void
+xvd_watchdog_stop (XvdInstance *i)
+{
+  if (!xvd_watchdog_thread)
+    return;
+
+  g_mutex_lock (&xvd_watchdog_lock);
+  xvd_watchdog_running = FALSE;
+  g_cond_signal (&xvd_watchdog_cond);
+  g_mutex_unlock (&xvd_watchdog_lock);
+
+  g_thread_join (xvd_watchdog_thread);
+  xvd_watchdog_thread = NULL;
+
+  xvd_watchdog_unhook_poll ();
+}
+
+
+/**
+ * Returns how many times the threads other than the main one went to
+ * sleep so far, each of their wakeups ends that way. The PulseAudio
+ * thread is one of them with --pa-thread.
+ */
+static gint64
+xvd_watchdog_thread_sleeps (void)
+{
+  GDir        *dir;
+  const gchar *name;
+  gchar       *main_tid;
+  gint64       sleeps = 0;
+
+  dir = g_dir_open ("/proc/self/task", 0, NULL);
+  if (!dir)
+    return 0;
+
+  main_tid = g_strdup_printf ("%d", (gint) getpid ());
+  while ((name = g_dir_read_name (dir)))
+    {
+      gchar *path, *contents = NULL;
+      gchar *line;
+
+      if (strcmp (name, main_tid) == 0)
+        continue;
+
+      path = g_build_filename ("/proc/self/task", name, "status", NULL);
+      if (g_file_get_contents (path, &contents, NULL, NULL)
+          && (line = strstr (contents, "\nvoluntary_ctxt_switches:")))
+        sleeps += g_ascii_strtoll (line + strlen ("\nvoluntary_ctxt_switches:"), NULL, 10);
+      g_free (contents);
+      g_free (path);
+    }
+  g_free (main_tid);
+  g_dir_close (dir);
+
+  return sleeps;
+}
+
+
+static gboolean
+xvd_watchdog_count_end (gpointer data)
+{
+  XvdInstance *i = (XvdInstance *) data;
+  gint         loop, io, threads;
+
+  XVD_DISPATCH_TAG ();
+
+  /* the poll return that brought us here is not the daemon's */
+  loop = g_atomic_int_get (&xvd_watchdog_iteration) - xvd_watchdog_base - 1;
+  io = g_atomic_int_get (&xvd_watchdog_io_wakeups) - xvd_watchdog_io_base;
+  threads = MAX (xvd_watchdog_thread_sleeps () - xvd_watchdog_sleeps_base, 0);
+  xvd_watchdog_wakeups = loop + threads;
+  xvd_watchdog_unhook_poll ();
+
+  g_print ("%d wakeups (%d with I/O) of the main loop and %d of the other threads in %u s of idle time\n",
+           loop, io, threads, xvd_watchdog_window);
+
+  g_main_loop_quit (i->loop);
+  return G_SOURCE_REMOVE;
+}
+
+
+static gboolean
+xvd_watchdog_count_start (gpointer data)
+{
+  XVD_DISPATCH_TAG ();
+
+  xvd_watchdog_base = g_atomic_int_get (&xvd_watchdog_iteration);
+  xvd_watchdog_io_base = g_atomic_int_get (&xvd_watchdog_io_wakeups);
+  xvd_watchdog_sleeps_base = xvd_watchdog_thread_sleeps ();
+  g_timeout_add_seconds (xvd_watchdog_window, xvd_watchdog_count_end, data);
+
+  return G_SOURCE_REMOVE;
+}
+
+
+void
+xvd_watchdog_count_wakeups (XvdInstance *i,
+                            guint        seconds)
+{
+  if (seconds == 0)
+    return;
+
+  xvd_watchdog_hook_poll ();
+  xvd_watchdog_window = seconds;
+  g_timeout_add_seconds (XVD_WATCHDOG_SETTLE_TIME, xvd_watchdog_count_start, i);
+}
+
+
+gint
+xvd_watchdog_get_wakeups (void)
+{
+  return xvd_watchdog_wakeups;
+}
+
+
+void
+xvd_watchdog_tag (const gchar *tag)
+{
+  /* callbacks of the PulseAudio thread don't block the main loop */
+  if (xvd_watchdog_main_thread != NULL && g_thread_self () == xvd_watchdog_main_thread)
+    g_atomic_pointer_set (&xvd_watchdog_current_tag, (gpointer) tag);
+}
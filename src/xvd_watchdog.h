@@ -0,0 +1,64 @@
+/*
+ *  xfce4-volumed-pulse - Volume management daemon for XFCE 4 (Pulseaudio variant)
+ *
+ *  Copyright © 2026 The Xfce Development Team
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _XVD_WATCHDOG_H
+#define _XVD_WATCHDOG_H
+
+#include "xvd_data_types.h"
+
+
+/**
+ * Records the callback currently dispatched by the main loop, so that a stall
+ * can be attributed to it. The tag is cleared when the loop goes back to poll.
+ */
+#define XVD_DISPATCH_TAG() xvd_watchdog_tag (G_STRFUNC)
+
+
+/**
+ * Starts watching the default main context, a stall is reported when it
+ * doesn't get back to poll within @threshold_ms.
+ */
+void xvd_watchdog_start (XvdInstance *i,
+                         guint        threshold_ms);
+
+/**
+ * Stops the watchdog thread, if any.
+ */
+void xvd_watchdog_stop  (XvdInstance *i);
+
+/**
+ * Counts the wakeups of the default main context, and of the other
+ * threads, over @seconds once the daemon had time to connect, prints them
+ * and quits the main loop.
+ */
+void xvd_watchdog_count_wakeups (XvdInstance *i,
+                                 guint        seconds);
+
+/**
+ * Returns the wakeups counted by xvd_watchdog_count_wakeups(), or -1 if
+ * the count never ended.
+ */
+gint xvd_watchdog_get_wakeups   (void);
+
+/**
+ * Sets the dispatch tag, use XVD_DISPATCH_TAG() instead.
+ */
+void xvd_watchdog_tag   (const gchar *tag);
+
+#endif
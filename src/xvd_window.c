@@ -0,0 +1,240 @@
+/*
+ *  xfce4-volumed-pulse - Volume management daemon for XFCE 4 (Pulseaudio variant)
+ *
+ *  Copyright © 2026 The Xfce Development Team
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <gdk/gdk.h>
+#include <gdk/gdkx.h>
+#include <X11/Xatom.h>
+
+#include "xvd_trace.h"
+#include "xvd_window.h"
+#include "xvd_watchdog.h"
+
+
+static Atom xvd_net_active_window = None;
+static Atom xvd_net_wm_pid = None;
+static Atom xvd_net_wm_state = None;
+static Atom xvd_net_wm_state_fullscreen = None;
+
+/* the active window, whose _NET_WM_STATE changes we receive */
+static Window xvd_watched_window = None;
+
+
+/**
+ * Reads a single 32-bit property of @window, returns FALSE if unset.
+ */
+static gboolean
+xvd_window_get_cardinal (Display *xdisplay,
+                         Window   window,
+                         Atom     property,
+                         Atom     type,
+                         gulong  *value)
+{
+  Atom           actual_type;
+  int            actual_format;
+  unsigned long  n_items, bytes_after;
+  unsigned char *data = NULL;
+  gboolean       ret = FALSE;
+
+  if (XGetWindowProperty (xdisplay, window, property, 0, 1, False, type,
+                          &actual_type, &actual_format, &n_items, &bytes_after,
+                          &data) == Success
+      && actual_type == type && actual_format == 32 && n_items == 1)
+    {
+      *value = *(unsigned long *) data;
+      ret = TRUE;
+    }
+
+  if (data)
+    XFree (data);
+
+  return ret;
+}
+
+
+/**
+ * Returns whether the _NET_WM_STATE of @window holds the fullscreen atom.
+ */
+static gboolean
+xvd_window_get_fullscreen (Display *xdisplay,
+                           Window   window)
+{
+  Atom           actual_type;
+  int            actual_format;
+  unsigned long  n_items, bytes_after, n;
+  unsigned char *data = NULL;
+  gboolean       ret = FALSE;
+
+  if (XGetWindowProperty (xdisplay, window, xvd_net_wm_state, 0, 32, False, XA_ATOM,
+                          &actual_type, &actual_format, &n_items, &bytes_after,
+                          &data) == Success
+      && actual_type == XA_ATOM && actual_format == 32)
+    {
+      for (n = 0; n < n_items && !ret; n++)
+        ret = (((Atom *) data)[n] == xvd_net_wm_state_fullscreen);
+    }
+
+  if (data)
+    XFree (data);
+
+  return ret;
+}
+
+
+/**
+ * Caches whether the active window is fullscreen, the notifications
+ * then check it without talking to the X server.
+ */
+static void
+xvd_window_refresh_fullscreen (XvdInstance *i)
+{
+  GdkDisplay *display = gdk_display_get_default ();
+  gboolean    fullscreen = FALSE;
+
+  if (xvd_watched_window != None)
+    {
+      gdk_x11_display_error_trap_push (display);
+      fullscreen = xvd_window_get_fullscreen (gdk_x11_display_get_xdisplay (display),
+                                              xvd_watched_window);
+      gdk_x11_display_error_trap_pop_ignored (display);
+    }
+
+  g_atomic_int_set (&i->focused_fullscreen, fullscreen);
+}
+
+
+/**
+ * Moves the PropertyNotify watch from the previous active window to
+ * @window, so that entering and leaving fullscreen is followed too.
+ */
+static void
+xvd_window_watch (Window window)
+{
+  GdkDisplay *display = gdk_display_get_default ();
+  Display    *xdisplay = gdk_x11_display_get_xdisplay (display);
+
+  if (window == xvd_watched_window)
+    return;
+
+  /* either window may be gone by now */
+  gdk_x11_display_error_trap_push (display);
+  if (xvd_watched_window != None)
+    XSelectInput (xdisplay, xvd_watched_window, NoEventMask);
+  if (window != None)
+    XSelectInput (xdisplay, window, PropertyChangeMask);
+  gdk_x11_display_error_trap_pop_ignored (display);
+
+  xvd_watched_window = window;
+}
+
+
+/**
+ * Caches the PID of the active window, the stream keys then look it up
+ * without talking to the X server.
+ */
+static void
+xvd_window_refresh (XvdInstance *i)
+{
+  GdkDisplay *display = gdk_display_get_default ();
+  Display    *xdisplay = gdk_x11_display_get_xdisplay (display);
+  gulong      active = None;
+  gulong      pid = 0;
+
+  /* the window may be gone by the time we ask */
+  gdk_x11_display_error_trap_push (display);
+  if (xvd_window_get_cardinal (xdisplay, gdk_x11_get_default_root_xwindow (),
+                               xvd_net_active_window, XA_WINDOW, &active)
+      && active != None)
+    xvd_window_get_cardinal (xdisplay, active, xvd_net_wm_pid, XA_CARDINAL, &pid);
+  gdk_x11_display_error_trap_pop_ignored (display);
+
+  g_atomic_int_set (&i->focused_pid, (gint) pid);
+  XVD_TRACE (FOCUS, pid, active);
+
+  xvd_window_watch ((Window) active);
+  xvd_window_refresh_fullscreen (i);
+}
+
+
+static GdkFilterReturn
+xvd_window_filter (GdkXEvent *gdk_xevent,
+                   GdkEvent  *event,
+                   gpointer   userdata)
+{
+  XvdInstance *i = (XvdInstance *) userdata;
+  XEvent      *xevent = (XEvent *) gdk_xevent;
+
+  if (xevent->type != PropertyNotify)
+    return GDK_FILTER_CONTINUE;
+
+  if (xevent->xproperty.atom == xvd_net_active_window
+      && xevent->xproperty.window == gdk_x11_get_default_root_xwindow ())
+    {
+      XVD_DISPATCH_TAG ();
+      xvd_window_refresh (i);
+    }
+  else if (xevent->xproperty.atom == xvd_net_wm_state
+           && xevent->xproperty.window == xvd_watched_window)
+    {
+      XVD_DISPATCH_TAG ();
+      xvd_window_refresh_fullscreen (i);
+    }
+
+  return GDK_FILTER_CONTINUE;
+}
+
+
+void
+xvd_window_init (XvdInstance *i)
+{
+  GdkDisplay *display = gdk_display_get_default ();
+  GdkWindow  *root;
+
+  if (!display || !GDK_IS_X11_DISPLAY (display))
+    {
+      g_debug ("xvd_window_init: not on X11, stream keys won't follow the focus");
+      return;
+    }
+
+  xvd_net_active_window = gdk_x11_get_xatom_by_name_for_display (display, "_NET_ACTIVE_WINDOW");
+  xvd_net_wm_pid = gdk_x11_get_xatom_by_name_for_display (display, "_NET_WM_PID");
+  xvd_net_wm_state = gdk_x11_get_xatom_by_name_for_display (display, "_NET_WM_STATE");
+  xvd_net_wm_state_fullscreen = gdk_x11_get_xatom_by_name_for_display (display, "_NET_WM_STATE_FULLSCREEN");
+
+  root = gdk_get_default_root_window ();
+  gdk_window_set_events (root, gdk_window_get_events (root) | GDK_PROPERTY_CHANGE_MASK);
+
+  /* the events of the active window have no GdkWindow, filter them all */
+  gdk_window_add_filter (NULL, xvd_window_filter, i);
+
+  xvd_window_refresh (i);
+}
+
+
+void
+xvd_window_shutdown (XvdInstance *i)
+{
+  if (xvd_net_active_window == None)
+    return;
+
+  gdk_window_remove_filter (NULL, xvd_window_filter, i);
+  xvd_window_watch (None);
+  xvd_net_active_window = None;
+  g_atomic_int_set (&i->focused_pid, 0);
+  g_atomic_int_set (&i->focused_fullscreen, FALSE);
+}
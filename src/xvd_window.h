@@ -0,0 +1,38 @@
+/*
+ *  xfce4-volumed-pulse - Volume management daemon for XFCE 4 (Pulseaudio variant)
+ *
+ *  Copyright © 2026 The Xfce Development Team
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _XVD_WINDOW_H
+#define _XVD_WINDOW_H
+
+#include "xvd_data_types.h"
+
+
+/**
+ * Starts following the active window, its PID is kept in focused_pid as
+ * the window manager announces focus changes, and whether it is fullscreen
+ * in focused_fullscreen. Does nothing outside X11.
+ */
+void xvd_window_init     (XvdInstance *i);
+
+/**
+ * Stops following the active window.
+ */
+void xvd_window_shutdown (XvdInstance *i);
+
+#endif
@@ -0,0 +1,94 @@
+/*
+ *  xfce4-volumed-pulse - Volume management daemon for XFCE 4 (Pulseaudio variant)
+ *
+ *  Copyright © 2026 The Xfce Development Team
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "xvd_trace.h"
+#include "xvd_work.h"
+#include "xvd_watchdog.h"
+
+
+typedef struct {
+  XvdInstance *inst;
+  XvdWorkFunc  func;
+  guint        source_id;
+} XvdWorkSlot;
+
+/* OSD first, then everything that can wait */
+static const gint xvd_work_priorities[XVD_WORK_N] =
+{
+  G_PRIORITY_DEFAULT_IDLE, /* XVD_WORK_NOTIFY_VOLUME */
+  G_PRIORITY_DEFAULT_IDLE, /* XVD_WORK_NOTIFY_MIC */
+  G_PRIORITY_DEFAULT_IDLE, /* XVD_WORK_NOTIFY_STREAM */
+  G_PRIORITY_DEFAULT_IDLE, /* XVD_WORK_NOTIFY_LEVEL */
+  G_PRIORITY_DEFAULT_IDLE, /* XVD_WORK_NOTIFY_DEVICE */
+  G_PRIORITY_DEFAULT_IDLE, /* XVD_WORK_NOTIFY_MUTE_ALL */
+  G_PRIORITY_LOW,          /* XVD_WORK_SETTINGS */
+  G_PRIORITY_LOW,          /* XVD_WORK_SAVE_STATE */
+  G_PRIORITY_LOW,          /* XVD_WORK_STATS */
+};
+
+static XvdWorkSlot xvd_work_slots[XVD_WORK_N];
+
+
+static gboolean
+xvd_work_dispatch (gpointer data)
+{
+  XvdWorkSlot *slot = (XvdWorkSlot *) data;
+
+  XVD_DISPATCH_TAG ();
+
+  slot->source_id = 0;
+  XVD_TRACE (WORK, slot - xvd_work_slots, 0);
+  slot->func (slot->inst);
+
+  return G_SOURCE_REMOVE;
+}
+
+
+void
+xvd_work_queue (XvdInstance *i,
+                XvdWork      work,
+                XvdWorkFunc  func)
+{
+  XvdWorkSlot *slot = &xvd_work_slots[work];
+
+  slot->inst = i;
+  slot->func = func;
+
+  if (slot->source_id == 0)
+    slot->source_id = g_idle_add_full (xvd_work_priorities[work],
+                                       xvd_work_dispatch,
+                                       slot,
+                                       NULL);
+}
+
+
+void
+xvd_work_cancel_all (XvdInstance *i)
+{
+  guint n;
+
+  for (n = 0; n < XVD_WORK_N; n++)
+    {
+      if (xvd_work_slots[n].source_id != 0)
+        {
+          g_source_remove (xvd_work_slots[n].source_id);
+          xvd_work_slots[n].source_id = 0;
+        }
+    }
+}
@@ -0,0 +1,61 @@
+/*
+ *  xfce4-volumed-pulse - Volume management daemon for XFCE 4 (Pulseaudio variant)
+ *
+ *  Copyright © 2026 The Xfce Development Team
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _XVD_WORK_H
+#define _XVD_WORK_H
+
+#include "xvd_data_types.h"
+
+
+/**
+ * Deferred jobs. Key presses are turned into PulseAudio operations right
+ * away, everything else is queued here below the priority of X and
+ * PulseAudio events, so it never delays the next volume change.
+ */
+typedef enum _XvdWork
+{
+  XVD_WORK_NOTIFY_VOLUME,
+  XVD_WORK_NOTIFY_MIC,
+  XVD_WORK_NOTIFY_STREAM,
+  XVD_WORK_NOTIFY_LEVEL,
+  XVD_WORK_NOTIFY_DEVICE,
+  XVD_WORK_NOTIFY_MUTE_ALL,
+  XVD_WORK_SETTINGS,
+  XVD_WORK_SAVE_STATE,
+  XVD_WORK_STATS,
+  XVD_WORK_N
+} XvdWork;
+
+typedef void (*XvdWorkFunc) (XvdInstance *i);
+
+
+/**
+ * Schedules @func for @work. A job already pending for @work is replaced,
+ * so bursts collapse into a single run based on the latest state.
+ */
+void xvd_work_queue      (XvdInstance *i,
+                          XvdWork      work,
+                          XvdWorkFunc  func);
+
+/**
+ * Drops all pending jobs.
+ */
+void xvd_work_cancel_all (XvdInstance *i);
+
+#endif
@@ -18,7 +18,11 @@
  *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include "xvd_keys.h"
+#include "xvd_pulse.h"
 #include "xvd_xfconf.h"
+#include "xvd_watchdog.h"
+#include "xvd_work.h"
 
 static void
 _xvd_xfconf_reinit_vol_step(XvdInstance *Inst)
@@ -27,6 +31,41 @@ _xvd_xfconf_reinit_vol_step(XvdInstance *Inst)
 		g_debug ("Xfconf reinit: volume step is now %u\n", Inst->vol_step);
 }
 
+/**
+ * Reads the switches the PulseAudio side looks at, and the fullscreen
+ * policy of the popups.
+ */
+static void
+_xvd_xfconf_get_policies(XvdInstance *Inst)
+{
+	gboolean show_level_meter = xfconf_channel_get_bool (Inst->settings, XFCONF_SHOW_LEVEL_METER_PROP, FALSE);
+	guint    hotplug_policy = xfconf_channel_get_uint (Inst->settings, XFCONF_HOTPLUG_POLICY_PROP,
+													   HOTPLUG_POLICY_NONE);
+	gboolean mute_all_sources = xfconf_channel_get_bool (Inst->settings, XFCONF_MUTE_ALL_SOURCES_PROP, FALSE);
+
+	/* the PulseAudio thread reads them */
+	xvd_pulse_lock (Inst);
+	Inst->show_level_meter = show_level_meter;
+	Inst->hotplug_policy = hotplug_policy;
+	Inst->mute_all_sources = mute_all_sources;
+	xvd_pulse_unlock (Inst);
+
+	Inst->fullscreen_notifications = xfconf_channel_get_uint (Inst->settings, XFCONF_FULLSCREEN_NOTIFICATIONS_PROP,
+															  FULLSCREEN_NOTIFICATIONS_ALL);
+}
+
+static void
+_xvd_xfconf_reload(XvdInstance *Inst)
+{
+	_xvd_xfconf_reinit_vol_step(Inst);
+	xvd_xfconf_get_vol_step_accel (Inst);
+	xvd_xfconf_get_vol_ramp (Inst);
+	xvd_xfconf_get_sink_groups (Inst);
+	Inst->icon_style = xfconf_channel_get_uint (Inst->settings, XFCONF_ICON_STYLE_PROP,
+												ICONS_STYLE_NORMAL);
+	_xvd_xfconf_get_policies (Inst);
+}
+
 static void
 _xvd_xfconf_handle_changes(XfconfChannel  *re_channel,
 						   const gchar    *re_property_name,
@@ -34,14 +73,27 @@ _xvd_xfconf_handle_changes(XfconfChannel  *re_channel,
 						   gpointer  	  *ptr)
 {
 	XvdInstance *Inst = (XvdInstance *)ptr;
+
+	XVD_DISPATCH_TAG ();
 	g_debug ("Xfconf event on %s\n", re_property_name);
 
-	if (g_strcmp0 (re_property_name, XFCONF_MIXER_VOL_STEP_PROP) == 0) {
-		_xvd_xfconf_reinit_vol_step(Inst);
-	}
-	else if (g_strcmp0 (re_property_name, XFCONF_ICON_STYLE_PROP) == 0) {
-		Inst->icon_style = xfconf_channel_get_uint (Inst->settings, XFCONF_ICON_STYLE_PROP,
-													ICONS_STYLE_NORMAL);
+	/* settings are picked up once the pending volume work is done */
+	if (g_strcmp0 (re_property_name, XFCONF_MIXER_VOL_STEP_PROP) == 0
+		|| g_strcmp0 (re_property_name, XFCONF_VOL_STEP_ACCEL_PROP) == 0
+		|| g_strcmp0 (re_property_name, XFCONF_VOL_STEP_ACCEL_DELAY_PROP) == 0
+		|| g_strcmp0 (re_property_name, XFCONF_VOL_STEP_ACCEL_RAMP_PROP) == 0
+		|| g_strcmp0 (re_property_name, XFCONF_VOL_RAMP_DURATION_PROP) == 0
+		|| g_strcmp0 (re_property_name, XFCONF_SHOW_LEVEL_METER_PROP) == 0
+		|| g_strcmp0 (re_property_name, XFCONF_HOTPLUG_POLICY_PROP) == 0
+		|| g_strcmp0 (re_property_name, XFCONF_SINK_GROUPS_PROP) == 0
+		|| g_strcmp0 (re_property_name, XFCONF_MUTE_ALL_SOURCES_PROP) == 0
+		|| g_strcmp0 (re_property_name, XFCONF_FULLSCREEN_NOTIFICATIONS_PROP) == 0
+		|| g_strcmp0 (re_property_name, XFCONF_ICON_STYLE_PROP) == 0) {
+		xvd_work_queue (Inst, XVD_WORK_SETTINGS, _xvd_xfconf_reload);
+	} else if (g_strcmp0 (re_property_name, XFCONF_MUTE_ALL_KEY_PROP) == 0) {
+		xvd_keys_bind_mute_all (Inst);
+	} else if (g_strcmp0 (re_property_name, XFCONF_PUSH_TO_TALK_KEY_PROP) == 0) {
+		xvd_keys_bind_push_to_talk (Inst);
 	}
 }
 
@@ -70,6 +122,8 @@ xvd_xfconf_init(XvdInstance *Inst)
 		Inst->icon_style = xfconf_channel_get_uint (Inst->settings, XFCONF_ICON_STYLE_PROP,
 									  ICONS_STYLE_NORMAL);
 
+	_xvd_xfconf_get_policies (Inst);
+
 	if (!xfconf_channel_has_property (Inst->settings, XFCONF_MIXER_VOL_STEP_PROP)) {
 		if (!xfconf_channel_set_uint (Inst->settings, XFCONF_MIXER_VOL_STEP_PROP,
 									  VOL_STEP_DEFAULT_VAL))
@@ -84,18 +138,88 @@ xvd_xfconf_init(XvdInstance *Inst)
 void
 xvd_xfconf_get_vol_step(XvdInstance *Inst)
 {
-	Inst->vol_step = xfconf_channel_get_uint (Inst->settings, XFCONF_MIXER_VOL_STEP_PROP, VOL_STEP_DEFAULT_VAL);
-	if (Inst->vol_step > 100) {
+	guint step = xfconf_channel_get_uint (Inst->settings, XFCONF_MIXER_VOL_STEP_PROP, VOL_STEP_DEFAULT_VAL);
+
+	if (step > 100) {
 		g_debug ("%s\n", "The volume step xfconf property is out of range, setting back to default");
-		Inst->vol_step = VOL_STEP_DEFAULT_VAL;
+		step = VOL_STEP_DEFAULT_VAL;
 		xfconf_channel_set_uint (Inst->settings, XFCONF_MIXER_VOL_STEP_PROP, VOL_STEP_DEFAULT_VAL);
 	}
-	g_debug("%s %u\n", "Xfconf volume step:", Inst->vol_step);
+
+	xvd_pulse_lock (Inst);
+	Inst->vol_step = step;
+	xvd_pulse_unlock (Inst);
+	g_debug("%s %u\n", "Xfconf volume step:", step);
+}
+
+void
+xvd_xfconf_get_vol_step_accel(XvdInstance *Inst)
+{
+	guint accel = xfconf_channel_get_uint (Inst->settings, XFCONF_VOL_STEP_ACCEL_PROP,
+										   VOL_STEP_ACCEL_DEFAULT_VAL);
+	guint delay = xfconf_channel_get_uint (Inst->settings, XFCONF_VOL_STEP_ACCEL_DELAY_PROP,
+										   VOL_STEP_ACCEL_DELAY_DEFAULT_VAL);
+	guint ramp = xfconf_channel_get_uint (Inst->settings, XFCONF_VOL_STEP_ACCEL_RAMP_PROP,
+										  VOL_STEP_ACCEL_RAMP_DEFAULT_VAL);
+
+	xvd_pulse_lock (Inst);
+	Inst->vol_step_accel = MAX (accel, 1);
+	Inst->vol_step_accel_delay = delay;
+	Inst->vol_step_accel_ramp = MAX (ramp, 1);
+	xvd_pulse_unlock (Inst);
+	g_debug("Xfconf volume step acceleration: x%u after %u ms, over %u ms\n", MAX (accel, 1),
+			delay, MAX (ramp, 1));
+}
+
+void
+xvd_xfconf_get_vol_ramp(XvdInstance *Inst)
+{
+	guint duration = xfconf_channel_get_uint (Inst->settings, XFCONF_VOL_RAMP_DURATION_PROP,
+											  VOL_RAMP_DURATION_DEFAULT_VAL);
+
+	/* a ramp running in the PulseAudio thread reads it */
+	xvd_pulse_lock (Inst);
+	Inst->vol_ramp_duration = duration;
+	xvd_pulse_unlock (Inst);
+	g_debug("%s %u\n", "Xfconf volume ramp duration:", duration);
+}
+
+void
+xvd_xfconf_get_sink_groups(XvdInstance *Inst)
+{
+	gchar     **groups = xfconf_channel_get_string_list (Inst->settings, XFCONF_SINK_GROUPS_PROP);
+	GPtrArray  *parsed = g_ptr_array_new_with_free_func ((GDestroyNotify) g_strfreev);
+	GPtrArray  *old;
+	guint       n, m;
+
+	/* each entry lists the sink names of a group, separated by commas */
+	for (n = 0; groups && groups[n]; n++) {
+		gchar **names = g_strsplit (groups[n], ",", -1);
+
+		for (m = 0; names[m]; m++)
+			g_strstrip (names[m]);
+		g_ptr_array_add (parsed, names);
+	}
+	g_strfreev (groups);
+
+	/* the PulseAudio thread reads them */
+	xvd_pulse_lock (Inst);
+	old = Inst->sink_groups;
+	Inst->sink_groups = parsed;
+	xvd_pulse_unlock (Inst);
+
+	if (old)
+		g_ptr_array_unref (old);
+	g_debug("%s %u\n", "Xfconf sink groups:", parsed->len);
 }
 
 void
 xvd_xfconf_shutdown(XvdInstance *Inst)
 {
+	if (Inst->sink_groups) {
+		g_ptr_array_unref (Inst->sink_groups);
+		Inst->sink_groups = NULL;
+	}
 	if(Inst->settings)
 		g_object_unref(Inst->settings);
 	xfconf_shutdown ();
@@ -30,6 +30,15 @@ xvd_xfconf_init(XvdInstance *Inst);
 void   
 xvd_xfconf_get_vol_step(XvdInstance *Inst);
 
+void
+xvd_xfconf_get_vol_step_accel(XvdInstance *Inst);
+
+void
+xvd_xfconf_get_vol_ramp(XvdInstance *Inst);
+
+void
+xvd_xfconf_get_sink_groups(XvdInstance *Inst);
+
 void 
 xvd_xfconf_shutdown(XvdInstance *Inst);
 
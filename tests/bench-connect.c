@@ -0,0 +1,159 @@
+/*
+ *  xfce4-volumed-pulse - Volume management daemon for XFCE 4 (Pulseaudio variant)
+ *
+ *  Copyright © 2026 The Xfce Development Team
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * The time from connecting to a usable sink, and the requests it takes,
+ * against a replayed server with and without a default sink, then
+ * against the PulseAudio server of the session if there is one.
+ */
+
+#include <gio/gio.h>
+#include <libnotify/notify.h>
+#include <pulse/pulseaudio.h>
+
+#include "xvd_notify.h"
+#include "xvd_pulse.h"
+#include "xvd_record.h"
+
+#include "xvd-fake-notifyd.h"
+#include "xvd-test-util.h"
+
+
+#define BENCH_CONNECTS          200
+#define BENCH_SESSION_CONNECTS  20
+
+/* the defaults, then the lists of sinks, sources, streams and cards */
+#define BENCH_CONNECT_REQUESTS  6
+
+#define SINK                    0
+
+static const gchar *caps_gauge[] = { "body", LAYOUT_ICON_ONLY, SYNCHRONOUS, NULL };
+
+
+/**
+ * Writes a recording of a server with a single sink, the default one if
+ * @with_default, returns its path.
+ */
+static gchar *
+write_recording (gboolean with_default)
+{
+  gchar *path = xvd_test_recording_new ("bench-connect", with_default ? SINK : PA_INVALID_INDEX,
+                                        PA_INVALID_INDEX);
+
+  xvd_test_record_sink (SINK, "alsa_output.bench", 50, 50, FALSE, NULL);
+  xvd_record_stop ();
+
+  return path;
+}
+
+
+/**
+ * Connects, waits for a usable sink and for the answers to everything
+ * asked on the way, and disconnects. Returns the requests made.
+ */
+static guint64
+connect_once (XvdInstance *i)
+{
+  guint64 introspections = i->stats.introspections;
+
+  g_assert_true (xvd_open_pulse (i));
+  while (i->sink_index == PA_INVALID_INDEX)
+    g_main_context_iteration (NULL, TRUE);
+
+  /* the rest of the answers are already queued */
+  while (g_main_context_iteration (NULL, FALSE))
+    ;
+  introspections = i->stats.introspections - introspections;
+
+  xvd_close_pulse (i);
+  i->sink_index = PA_INVALID_INDEX;
+  i->source_index = PA_INVALID_INDEX;
+
+  return introspections;
+}
+
+
+static void
+bench_replay (XvdInstance *i,
+              gboolean     with_default,
+              const gchar *what)
+{
+  gint64  times[BENCH_CONNECTS];
+  gchar  *path;
+  guint   n;
+
+  path = write_recording (with_default);
+
+  for (n = 0; n < BENCH_CONNECTS; n++)
+    {
+      g_assert_true (xvd_replay_start (i, path, FALSE));
+      /* the list asked for at once answers the missing default too */
+      g_assert_cmpuint (connect_once (i), ==, BENCH_CONNECT_REQUESTS);
+      times[n] = i->stats.connect_latency;
+    }
+  xvd_test_report (what, times, BENCH_CONNECTS);
+
+  xvd_test_recording_free (path);
+}
+
+
+static void
+bench_session (XvdInstance *i)
+{
+  gint64 times[BENCH_SESSION_CONNECTS];
+  guint  n;
+
+  for (n = 0; n < BENCH_SESSION_CONNECTS; n++)
+    {
+      connect_once (i);
+      times[n] = i->stats.connect_latency;
+    }
+  xvd_test_report ("connect to sink, session server", times, BENCH_SESSION_CONNECTS);
+}
+
+
+gint
+main (gint    argc,
+      gchar **argv)
+{
+  GTestDBus      *bus;
+  XvdFakeNotifyd *server;
+  XvdInstance    *i;
+
+  bus = g_test_dbus_new (G_TEST_DBUS_NONE);
+  g_test_dbus_up (bus);
+  server = xvd_fake_notifyd_new (g_test_dbus_get_bus_address (bus), caps_gauge);
+
+  i = xvd_test_instance_new ("bench-connect", server);
+
+  bench_replay (i, TRUE, "connect to sink");
+  bench_replay (i, FALSE, "connect to sink, no default");
+
+  if (xvd_test_have_pulse ())
+    bench_session (i);
+  else
+    g_print ("no PulseAudio server, session server skipped\n");
+
+  xvd_test_instance_free (i);
+  xvd_fake_notifyd_free (server);
+
+  g_test_dbus_stop (bus);
+  g_object_unref (bus);
+  return 0;
+}
@@ -0,0 +1,232 @@
+/*
+ *  xfce4-volumed-pulse - Volume management daemon for XFCE 4 (Pulseaudio variant)
+ *
+ *  Copyright © 2026 The Xfce Development Team
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * The time from a key press to the server's answer to the volume change,
+ * against a replayed server, alone and under a storm of notifications.
+ * The keys come from a thread through a pipe, like X events through the
+ * display socket, and are dispatched at the priority GDK gives them.
+ * The 95th percentile under the storm must stay under XVD_BENCH_KEY_ACK_MS
+ * milliseconds, 10 by default.
+ */
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <gio/gio.h>
+#include <glib-unix.h>
+#include <libnotify/notify.h>
+
+#include "xvd_notify.h"
+#include "xvd_pulse.h"
+#include "xvd_record.h"
+#include "xvd_work.h"
+
+#include "xvd-fake-notifyd.h"
+#include "xvd-test-util.h"
+
+
+#define BENCH_KEYS         200
+#define BENCH_KEY_GAP_MS   10
+#define BENCH_STORM_MS     1
+#define BENCH_SLOW_MS      5
+#define BENCH_KEY_ACK_MS   10
+
+#define SINK               0
+
+static const gchar *caps_gauge[] = { "body", LAYOUT_ICON_ONLY, SYNCHRONOUS, NULL };
+
+
+typedef struct
+{
+  XvdInstance *inst;
+  gint         pipe[2];
+  gint         keys;         /* left to send */
+  gint         in_flight;    /* a key not answered yet */
+  gint64       press_time;
+  gboolean     pressed;      /* seen by the main loop */
+  gint64       times[BENCH_KEYS];
+  guint        n_times;
+} Bench;
+
+
+/**
+ * The keyboard: a press every BENCH_KEY_GAP_MS, once the last one was
+ * answered.
+ */
+static gpointer
+keyboard_thread (gpointer userdata)
+{
+  Bench *b = userdata;
+
+  while (g_atomic_int_get (&b->keys) > 0)
+    {
+      g_usleep (BENCH_KEY_GAP_MS * 1000);
+      if (g_atomic_int_get (&b->in_flight))
+        continue;
+
+      g_atomic_int_add (&b->keys, -1);
+      b->press_time = g_get_monotonic_time ();
+      g_atomic_int_set (&b->in_flight, TRUE);
+      if (write (b->pipe[1], "k", 1) != 1)
+        g_error ("keyboard_thread: can't write the key");
+    }
+
+  return NULL;
+}
+
+
+static gboolean
+on_key (gint         fd,
+        GIOCondition condition,
+        gpointer     userdata)
+{
+  Bench *b = userdata;
+  gchar  c;
+
+  if (read (fd, &c, 1) == 1)
+    {
+      /* up and down in turn, never stuck at 100% */
+      xvd_update_volume (b->inst, (b->n_times % 2) ? XVD_DOWN : XVD_UP, 1);
+      b->pressed = TRUE;
+    }
+
+  return G_SOURCE_CONTINUE;
+}
+
+
+/**
+ * Another client changing the volume all the time, each change calling
+ * for a popup.
+ */
+static gboolean
+on_storm (gpointer userdata)
+{
+  XvdInstance *i = userdata;
+  static guint percent = 0;
+
+  percent = (percent + 7) % 100;
+  pa_cvolume_set (&i->osd.volume, 2, (pa_volume_t) ((guint64) PA_VOLUME_NORM * percent / 100));
+  xvd_work_queue (i, XVD_WORK_NOTIFY_VOLUME, xvd_test_notify_volume);
+
+  return G_SOURCE_CONTINUE;
+}
+
+
+/**
+ * Presses BENCH_KEYS keys, returns the 95th percentile of the time to
+ * the answer, in microseconds.
+ */
+static gint64
+bench_keys (XvdInstance    *i,
+            XvdFakeNotifyd *server,
+            gboolean        storm,
+            const gchar    *what)
+{
+  Bench    b = { 0 };
+  GThread *keyboard;
+  guint    key_source, storm_source = 0;
+  gint64   p95;
+
+  b.inst = i;
+  b.keys = BENCH_KEYS;
+  g_assert_true (g_unix_open_pipe (b.pipe, FD_CLOEXEC, NULL));
+
+  /* GDK_PRIORITY_EVENTS */
+  key_source = g_unix_fd_add_full (G_PRIORITY_DEFAULT, b.pipe[0], G_IO_IN, on_key, &b, NULL);
+  if (storm)
+    storm_source = g_timeout_add (BENCH_STORM_MS, on_storm, i);
+  xvd_fake_notifyd_reset (server);
+
+  keyboard = g_thread_new ("keyboard", keyboard_thread, &b);
+  while (b.n_times < BENCH_KEYS)
+    {
+      g_main_context_iteration (NULL, TRUE);
+
+      if (b.pressed && !i->pending[XVD_OP_SINK_VOLUME].op)
+        {
+          b.times[b.n_times++] = g_get_monotonic_time () - b.press_time;
+          b.pressed = FALSE;
+          g_atomic_int_set (&b.in_flight, FALSE);
+        }
+    }
+  g_thread_join (keyboard);
+
+  g_source_remove (key_source);
+  if (storm_source)
+    g_source_remove (storm_source);
+  xvd_work_cancel_all (i);
+  close (b.pipe[0]);
+  close (b.pipe[1]);
+
+  p95 = xvd_test_report (what, b.times, BENCH_KEYS);
+  g_print ("%-36s %u Notify calls\n", "", xvd_fake_notifyd_count (server));
+
+  return p95;
+}
+
+
+gint
+main (gint    argc,
+      gchar **argv)
+{
+  GTestDBus      *bus;
+  XvdFakeNotifyd *server;
+  XvdInstance    *i;
+  gchar          *path;
+  const gchar    *max;
+  gint64          threshold, storm, storm_slow;
+
+  max = g_getenv ("XVD_BENCH_KEY_ACK_MS");
+  threshold = (max ? g_ascii_strtoll (max, NULL, 10) : BENCH_KEY_ACK_MS) * 1000;
+
+  bus = g_test_dbus_new (G_TEST_DBUS_NONE);
+  g_test_dbus_up (bus);
+  server = xvd_fake_notifyd_new (g_test_dbus_get_bus_address (bus), caps_gauge);
+
+  path = xvd_test_recording_new ("bench-key-ack", SINK, PA_INVALID_INDEX);
+  xvd_test_record_sink (SINK, "alsa_output.bench", 50, 50, FALSE, NULL);
+  xvd_record_stop ();
+
+  i = xvd_test_instance_new ("bench-key-ack", server);
+  xvd_test_replay (i, path);
+
+  bench_keys (i, server, FALSE, "key to ack");
+  storm = bench_keys (i, server, TRUE, "key to ack, notification storm");
+  xvd_fake_notifyd_set_delay (server, BENCH_SLOW_MS);
+  storm_slow = bench_keys (i, server, TRUE, "key to ack, storm, server 5 ms late");
+  xvd_fake_notifyd_set_delay (server, 0);
+
+  xvd_close_pulse (i);
+  xvd_test_instance_free (i);
+  xvd_fake_notifyd_free (server);
+  xvd_test_recording_free (path);
+
+  g_test_dbus_stop (bus);
+  g_object_unref (bus);
+
+  /* a popup may be on its way when the key comes, no more than one */
+  if (MAX (storm, storm_slow) > threshold)
+    {
+      g_printerr ("p95 key to ack under a storm is %" G_GINT64_FORMAT " us, more than %" G_GINT64_FORMAT " us\n",
+                  MAX (storm, storm_slow), threshold);
+      return 1;
+    }
+  return 0;
+}
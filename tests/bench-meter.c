@@ -0,0 +1,179 @@
+/*
+ *  xfce4-volumed-pulse - Volume management daemon for XFCE 4 (Pulseaudio variant)
+ *
+ *  Copyright © 2026 The Xfce Development Team
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * What the level meter costs the main loop, against the PulseAudio server
+ * of the session and a fake notification server: the CPU time while
+ * connected and idle, then while metering, which must stay under
+ * XVD_BENCH_METER_CPU percent (1 by default). The level updates must not
+ * come more often than the daemon allows. Skipped without a server.
+ */
+
+#include <stdlib.h>
+#include <time.h>
+
+#include <gio/gio.h>
+#include <libnotify/notify.h>
+#include <pulse/pulseaudio.h>
+
+#include "xvd_notify.h"
+#include "xvd_pulse.h"
+
+#include "xvd-fake-notifyd.h"
+#include "xvd-test-util.h"
+
+
+#define BENCH_SECONDS       10
+/* the meter stops 3 s after the last popup */
+#define BENCH_POPUP_MS      2000
+#define BENCH_METER_CPU     1.0
+/* level updates per second at most, as XVD_METER_UPDATE_USEC allows */
+#define BENCH_METER_UPDATES 5
+
+/* meson's exit code for a skipped test */
+#define EXIT_SKIP 77
+
+static const gchar *caps_gauge[] = { "body", LAYOUT_ICON_ONLY, SYNCHRONOUS, NULL };
+
+
+/**
+ * Returns the CPU time of the calling thread, the one running the main
+ * loop, in microseconds. The fake server runs in a thread of its own.
+ */
+static gint64
+cpu_time (void)
+{
+  struct timespec ts;
+
+  clock_gettime (CLOCK_THREAD_CPUTIME_ID, &ts);
+  return (gint64) ts.tv_sec * G_USEC_PER_SEC + ts.tv_nsec / 1000;
+}
+
+
+static gboolean
+on_popup (gpointer userdata)
+{
+  xvd_pulse_start_meter ((XvdInstance *) userdata);
+  return G_SOURCE_CONTINUE;
+}
+
+
+static gboolean
+on_done (gpointer userdata)
+{
+  g_main_loop_quit ((GMainLoop *) userdata);
+  return G_SOURCE_REMOVE;
+}
+
+
+/**
+ * Runs the main loop for BENCH_SECONDS, keeping the meter on if @meter,
+ * and returns the CPU time it took, in percent.
+ */
+static gdouble
+run (XvdInstance *i,
+     gboolean     meter)
+{
+  gint64 start = cpu_time ();
+  guint  popup = 0;
+
+  if (meter)
+    {
+      xvd_pulse_start_meter (i);
+      popup = g_timeout_add (BENCH_POPUP_MS, on_popup, i);
+    }
+  g_timeout_add_seconds (BENCH_SECONDS, on_done, i->loop);
+  g_main_loop_run (i->loop);
+
+  if (popup)
+    g_source_remove (popup);
+
+  return (gdouble) (cpu_time () - start) * 100 / (BENCH_SECONDS * G_USEC_PER_SEC);
+}
+
+
+gint
+main (gint    argc,
+      gchar **argv)
+{
+  GTestDBus      *bus;
+  XvdFakeNotifyd *server;
+  XvdInstance    *i;
+  const gchar    *max;
+  gdouble         idle, metering, threshold;
+  guint           popups;
+
+  if (!xvd_test_have_pulse ())
+    {
+      g_print ("no PulseAudio server, skipped\n");
+      return EXIT_SKIP;
+    }
+
+  max = g_getenv ("XVD_BENCH_METER_CPU");
+  threshold = max ? g_ascii_strtod (max, NULL) : BENCH_METER_CPU;
+
+  bus = g_test_dbus_new (G_TEST_DBUS_NONE);
+  g_test_dbus_up (bus);
+  server = xvd_fake_notifyd_new (g_test_dbus_get_bus_address (bus), caps_gauge);
+
+  i = xvd_test_instance_new ("bench-meter", server);
+  i->show_level_meter = TRUE;
+
+  g_assert_true (xvd_open_pulse (i));
+  while (i->sink_index == PA_INVALID_INDEX || !i->sink_monitor)
+    g_main_context_iteration (NULL, TRUE);
+
+  idle = run (i, FALSE);
+  xvd_fake_notifyd_reset (server);
+
+  metering = run (i, TRUE);
+  g_assert_nonnull (i->meter_stream);
+  popups = xvd_fake_notifyd_count (server);
+
+  /* torn down with the popup, nothing left running */
+  xvd_pulse_stop_meter (i);
+  while (g_main_context_iteration (NULL, FALSE))
+    ;
+  g_assert_null (i->meter_stream);
+
+  g_print ("%-28s %5.2f%% CPU\n", "connected, idle", idle);
+  g_print ("%-28s %5.2f%% CPU, %u level updates in %u s\n", "metering",
+           metering, popups, BENCH_SECONDS);
+
+  xvd_close_pulse (i);
+  xvd_test_instance_free (i);
+  xvd_fake_notifyd_free (server);
+
+  g_test_dbus_stop (bus);
+  g_object_unref (bus);
+
+  if (metering > threshold)
+    {
+      g_printerr ("metering takes %.2f%% CPU, more than %.2f%%\n", metering, threshold);
+      return 1;
+    }
+  /* the first update comes at once */
+  if (popups > BENCH_SECONDS * BENCH_METER_UPDATES + 1)
+    {
+      g_printerr ("%u level updates in %u s, more than %u per second\n",
+                  popups, BENCH_SECONDS, BENCH_METER_UPDATES);
+      return 1;
+    }
+  return 0;
+}
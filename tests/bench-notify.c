@@ -0,0 +1,143 @@
+/*
+ *  xfce4-volumed-pulse - Volume management daemon for XFCE 4 (Pulseaudio variant)
+ *
+ *  Copyright © 2026 The Xfce Development Team
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * What a popup costs the main loop, against a fake server answering at
+ * once and one answering late, and how many Notify calls key bursts make.
+ */
+
+#include <gio/gio.h>
+#include <libnotify/notify.h>
+
+#include "xvd_notify.h"
+#include "xvd_pulse.h"
+#include "xvd_work.h"
+
+#include "xvd-fake-notifyd.h"
+#include "xvd-test-util.h"
+
+
+#define BENCH_SHOWS        200
+#define BENCH_BURSTS       100
+#define BENCH_BURST_STEPS  10
+#define BENCH_SLOW_MS      20
+
+static const gchar *caps_gauge[] = { "body", LAYOUT_ICON_ONLY, SYNCHRONOUS, NULL };
+
+
+static void
+set_volume (XvdInstance *i,
+            guint        percent)
+{
+  pa_cvolume_set (&i->osd.volume, 2, (pa_volume_t) ((guint64) PA_VOLUME_NORM * percent / 100));
+}
+
+
+static void
+bench_show (XvdInstance    *i,
+            XvdFakeNotifyd *server,
+            const gchar    *what)
+{
+  gint64 times[BENCH_SHOWS];
+  guint  n;
+
+  for (n = 0; n < BENCH_SHOWS; n++)
+    {
+      gint64 start = g_get_monotonic_time ();
+
+      /* a new value every time, nothing is left out */
+      set_volume (i, n % 100);
+      xvd_notify_volume_notification (i);
+      times[n] = g_get_monotonic_time () - start;
+    }
+  xvd_test_report (what, times, BENCH_SHOWS);
+
+  g_assert_cmpuint (xvd_fake_notifyd_count (server), ==, BENCH_SHOWS);
+  xvd_fake_notifyd_reset (server);
+}
+
+
+static void
+bench_bursts (XvdInstance    *i,
+              XvdFakeNotifyd *server)
+{
+  gint64 times[BENCH_BURSTS];
+  guint  burst, step;
+
+  for (burst = 0; burst < BENCH_BURSTS; burst++)
+    {
+      gint64 start = g_get_monotonic_time ();
+
+      /* as many key steps as the main loop sees between two idles */
+      for (step = 0; step < BENCH_BURST_STEPS; step++)
+        {
+          set_volume (i, (burst * BENCH_BURST_STEPS + step) % 100);
+          xvd_work_queue (i, XVD_WORK_NOTIFY_VOLUME, xvd_test_notify_volume);
+        }
+      while (g_main_context_iteration (NULL, FALSE))
+        ;
+      times[burst] = g_get_monotonic_time () - start;
+    }
+  xvd_test_report ("burst of 10 steps", times, BENCH_BURSTS);
+
+  g_print ("%-36s %u Notify calls for %u steps\n", "bursts",
+           xvd_fake_notifyd_count (server), BENCH_BURSTS * BENCH_BURST_STEPS);
+  g_assert_cmpuint (xvd_fake_notifyd_count (server), ==, BENCH_BURSTS);
+  xvd_fake_notifyd_reset (server);
+
+  /* the same state again, as the server echo of our own change */
+  for (burst = 0; burst < BENCH_BURSTS; burst++)
+    {
+      xvd_work_queue (i, XVD_WORK_NOTIFY_VOLUME, xvd_test_notify_volume);
+      while (g_main_context_iteration (NULL, FALSE))
+        ;
+    }
+  g_print ("%-36s %u Notify calls for %u bursts\n", "unchanged bursts",
+           xvd_fake_notifyd_count (server), BENCH_BURSTS);
+  g_assert_cmpuint (xvd_fake_notifyd_count (server), ==, 0);
+}
+
+
+gint
+main (gint    argc,
+      gchar **argv)
+{
+  GTestDBus      *bus;
+  XvdFakeNotifyd *server;
+  XvdInstance    *i;
+
+  bus = g_test_dbus_new (G_TEST_DBUS_NONE);
+  g_test_dbus_up (bus);
+  server = xvd_fake_notifyd_new (g_test_dbus_get_bus_address (bus), caps_gauge);
+
+  i = xvd_test_instance_new ("bench-notify", server);
+
+  bench_show (i, server, "show");
+  xvd_fake_notifyd_set_delay (server, BENCH_SLOW_MS);
+  bench_show (i, server, "show, server 20 ms late");
+  xvd_fake_notifyd_set_delay (server, 0);
+  bench_bursts (i, server);
+
+  xvd_test_instance_free (i);
+  xvd_fake_notifyd_free (server);
+
+  g_test_dbus_stop (bus);
+  g_object_unref (bus);
+  return 0;
+}
@@ -0,0 +1,203 @@
+/*
+ *  xfce4-volumed-pulse - Volume management daemon for XFCE 4 (Pulseaudio variant)
+ *
+ *  Copyright © 2026 The Xfce Development Team
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Replays a recorded server again and again, with the popups going to a
+ * fake notification server, and checks that the memory in use stops
+ * growing once warmed up.
+ *
+ * XVD_SOAK_ITERATIONS sets the number of replays, XVD_SOAK_RSS_SLACK the
+ * growth allowed in KiB, 0 to leave the memory to valgrind.
+ */
+
+#include <stdio.h>
+#include <unistd.h>
+
+#include <gio/gio.h>
+#include <libnotify/notify.h>
+
+#include "xvd_notify.h"
+#include "xvd_pulse.h"
+#include "xvd_record.h"
+
+#include "xvd-fake-notifyd.h"
+#include "xvd-test-util.h"
+
+
+#define SOAK_ITERATIONS  20
+#define SOAK_WARMUP      3
+#define SOAK_EVENTS      2000
+#define SOAK_RSS_SLACK   2048
+
+#define SOAK_SINK        0
+#define SOAK_SOURCE      1
+#define SOAK_MONITOR     2
+#define SOAK_STREAMS     100
+
+static const gchar *caps_gauge[] = { "body", LAYOUT_ICON_ONLY, SYNCHRONOUS, NULL };
+
+
+static guint
+env_uint (const gchar *name,
+          guint        fallback)
+{
+  const gchar *value = g_getenv (name);
+
+  return value ? (guint) g_ascii_strtoull (value, NULL, 10) : fallback;
+}
+
+
+/**
+ * Returns the resident set size, in KiB.
+ */
+static gsize
+rss_kib (void)
+{
+  gchar *contents = NULL;
+  gsize  pages = 0;
+
+  if (g_file_get_contents ("/proc/self/statm", &contents, NULL, NULL))
+    sscanf (contents, "%*s %" G_GSIZE_FORMAT, &pages);
+  g_free (contents);
+
+  return pages * (gsize) sysconf (_SC_PAGESIZE) / 1024;
+}
+
+
+/**
+ * Writes a recording of volume and mute changes, a microphone muted and
+ * unmuted, and streams coming and going, returns its path.
+ */
+static gchar *
+write_recording (void)
+{
+  pa_proplist *sink_props, *stream_props;
+  gchar       *path;
+  guint        n;
+
+  sink_props = pa_proplist_new ();
+  pa_proplist_sets (sink_props, PA_PROP_DEVICE_BUS, "pci");
+  stream_props = pa_proplist_new ();
+  pa_proplist_sets (stream_props, PA_PROP_APPLICATION_NAME, "soak");
+  pa_proplist_sets (stream_props, PA_PROP_APPLICATION_PROCESS_ID, "1");
+
+  path = xvd_test_recording_new ("soak-replay", SOAK_SINK, SOAK_SOURCE);
+  xvd_test_record_sink (SOAK_SINK, "alsa_output.soak", 50, 50, FALSE, sink_props);
+  xvd_test_record_source (SOAK_SOURCE, "alsa_input.soak", FALSE, PA_INVALID_INDEX);
+  xvd_test_record_source (SOAK_MONITOR, "alsa_output.soak.monitor", FALSE, SOAK_SINK);
+
+  for (n = 0; n < SOAK_EVENTS; n++)
+    {
+      guint32 stream = SOAK_STREAMS + n / 10;
+
+      switch (n % 10)
+        {
+          case 0:
+            xvd_record_event (PA_SUBSCRIPTION_EVENT_SINK_INPUT | PA_SUBSCRIPTION_EVENT_NEW, stream);
+            xvd_test_record_stream (stream, 100, stream_props);
+          break;
+          case 5:
+            xvd_record_event (PA_SUBSCRIPTION_EVENT_SOURCE | PA_SUBSCRIPTION_EVENT_CHANGE, SOAK_SOURCE);
+            xvd_test_record_source (SOAK_SOURCE, "alsa_input.soak", (n / 10) % 2, PA_INVALID_INDEX);
+          break;
+          case 9:
+            xvd_record_event (PA_SUBSCRIPTION_EVENT_SINK_INPUT | PA_SUBSCRIPTION_EVENT_REMOVE, stream);
+          break;
+          default:
+            xvd_record_event (PA_SUBSCRIPTION_EVENT_SINK | PA_SUBSCRIPTION_EVENT_CHANGE, SOAK_SINK);
+            xvd_test_record_sink (SOAK_SINK, "alsa_output.soak", n % 100, n % 100, n % 7 == 0, sink_props);
+          break;
+        }
+    }
+
+  xvd_record_stop ();
+  pa_proplist_free (sink_props);
+  pa_proplist_free (stream_props);
+
+  return path;
+}
+
+
+/**
+ * Replays @path once, as a daemon reconnecting to its server would.
+ */
+static void
+replay (XvdInstance *i,
+        const gchar *path)
+{
+  g_assert_true (xvd_replay_start (i, path, FALSE));
+  g_assert_true (xvd_open_pulse (i));
+
+  /* quits once the last event is answered */
+  g_main_loop_run (i->loop);
+
+  xvd_close_pulse (i);
+  i->sink_index = PA_INVALID_INDEX;
+  i->source_index = PA_INVALID_INDEX;
+
+  /* the popups still queued */
+  while (g_main_context_iteration (NULL, FALSE))
+    ;
+}
+
+
+gint
+main (gint    argc,
+      gchar **argv)
+{
+  GTestDBus      *bus;
+  XvdFakeNotifyd *server;
+  XvdInstance    *i;
+  gchar          *path;
+  guint           iterations, slack, n;
+  gsize           rss = 0;
+
+  iterations = MAX (env_uint ("XVD_SOAK_ITERATIONS", SOAK_ITERATIONS), SOAK_WARMUP + 1);
+  slack = env_uint ("XVD_SOAK_RSS_SLACK", SOAK_RSS_SLACK);
+
+  bus = g_test_dbus_new (G_TEST_DBUS_NONE);
+  g_test_dbus_up (bus);
+  server = xvd_fake_notifyd_new (g_test_dbus_get_bus_address (bus), caps_gauge);
+
+  path = write_recording ();
+  i = xvd_test_instance_new ("soak-replay", server);
+
+  for (n = 0; n < iterations; n++)
+    {
+      replay (i, path);
+      g_assert_cmpuint (xvd_fake_notifyd_count (server), >, 0);
+      xvd_fake_notifyd_reset (server);
+
+      if (n + 1 == SOAK_WARMUP)
+        rss = rss_kib ();
+    }
+
+  g_print ("rss: %" G_GSIZE_FORMAT " KiB after %u replays, %" G_GSIZE_FORMAT " KiB after %u\n",
+           rss, SOAK_WARMUP, rss_kib (), iterations);
+  if (slack > 0)
+    g_assert_cmpuint (rss_kib (), <=, rss + slack);
+
+  xvd_test_instance_free (i);
+  xvd_fake_notifyd_free (server);
+  xvd_test_recording_free (path);
+
+  g_test_dbus_stop (bus);
+  g_object_unref (bus);
+  return 0;
+}
@@ -0,0 +1,187 @@
+/*
+ *  xfce4-volumed-pulse - Volume management daemon for XFCE 4 (Pulseaudio variant)
+ *
+ *  Copyright © 2026 The Xfce Development Team
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * A sink group against a replayed server: a volume step goes to every
+ * member, each one keeping the balance the server last reported for it.
+ */
+
+#include <gio/gio.h>
+#include <libnotify/notify.h>
+
+#include "xvd_devices.h"
+#include "xvd_notify.h"
+#include "xvd_pulse.h"
+#include "xvd_record.h"
+
+#include "xvd-fake-notifyd.h"
+#include "xvd-test-util.h"
+
+
+#define SINK      0
+#define MEMBER    1
+
+static const gchar *caps_gauge[] = { "body", LAYOUT_ICON_ONLY, SYNCHRONOUS, NULL };
+
+static GTestDBus *test_bus = NULL;
+
+
+typedef struct
+{
+  XvdFakeNotifyd *server;
+  XvdInstance    *inst;
+  gchar          *path;
+  GArray         *writes;   /* of pa_cvolume, to the member */
+} Fixture;
+
+
+static void
+on_write (guint32           facility,
+          guint32           index,
+          const pa_cvolume *volume,
+          gint              mute,
+          gpointer          userdata)
+{
+  Fixture *f = userdata;
+
+  if (facility == PA_SUBSCRIPTION_EVENT_SINK && index == MEMBER && volume)
+    g_array_append_val (f->writes, *volume);
+}
+
+
+static void
+set_percent (pa_cvolume *volume,
+             guint       left,
+             guint       right)
+{
+  pa_cvolume_init (volume);
+  volume->channels = 2;
+  volume->values[0] = (pa_volume_t) ((guint64) PA_VOLUME_NORM * left / 100);
+  volume->values[1] = (pa_volume_t) ((guint64) PA_VOLUME_NORM * right / 100);
+}
+
+
+/**
+ * Writes a recording of a default sink at 50% and a member of its group
+ * at 40%, whose balance is then moved to the right by another client.
+ */
+static gchar *
+write_recording (void)
+{
+  gchar *path = xvd_test_recording_new ("test-groups", SINK, PA_INVALID_INDEX);
+
+  xvd_test_record_sink (SINK, "alsa_output.hdmi", 50, 50, FALSE, NULL);
+  xvd_test_record_sink (MEMBER, "alsa_output.usb", 40, 40, FALSE, NULL);
+
+  xvd_record_event (PA_SUBSCRIPTION_EVENT_SINK | PA_SUBSCRIPTION_EVENT_CHANGE, MEMBER);
+  xvd_test_record_sink (MEMBER, "alsa_output.usb", 20, 40, FALSE, NULL);
+  xvd_record_stop ();
+
+  return path;
+}
+
+
+static void
+fixture_set_up (Fixture       *f,
+                gconstpointer  data)
+{
+  XvdInstance *i;
+  gchar      **group;
+
+  f->server = xvd_fake_notifyd_new (g_test_dbus_get_bus_address (test_bus), caps_gauge);
+  f->writes = g_array_new (FALSE, FALSE, sizeof (pa_cvolume));
+
+  f->path = write_recording ();
+  f->inst = i = xvd_test_instance_new ("test-groups", f->server);
+
+  i->sink_groups = g_ptr_array_new_with_free_func ((GDestroyNotify) g_strfreev);
+  group = g_strsplit ("alsa_output.hdmi,alsa_output.usb", ",", -1);
+  g_ptr_array_add (i->sink_groups, group);
+
+  xvd_replay_set_write_func (on_write, f);
+  xvd_test_replay (i, f->path);
+}
+
+
+static void
+fixture_tear_down (Fixture       *f,
+                   gconstpointer  data)
+{
+  xvd_replay_set_write_func (NULL, NULL);
+  xvd_close_pulse (f->inst);
+  g_ptr_array_unref (f->inst->sink_groups);
+  xvd_test_instance_free (f->inst);
+  xvd_fake_notifyd_free (f->server);
+  xvd_test_recording_free (f->path);
+  g_array_free (f->writes, TRUE);
+}
+
+
+static void
+test_member_balance (Fixture       *f,
+                     gconstpointer  data)
+{
+  XvdInstance *i = f->inst;
+  pa_cvolume   moved, *w;
+
+  /* the change made by the other client reaches the cached member */
+  set_percent (&moved, 20, 40);
+  for (;;)
+    {
+      XvdSink *member = g_hash_table_lookup (i->sinks, GUINT_TO_POINTER (MEMBER));
+
+      if (member && pa_cvolume_equal (&member->volume, &moved))
+        break;
+      g_main_context_iteration (NULL, TRUE);
+    }
+
+  xvd_update_volume (i, XVD_UP, 10);
+  while (i->pending[XVD_OP_SINK_VOLUME].op || i->group_acks > 0)
+    g_main_context_iteration (NULL, TRUE);
+
+  /* the member follows the step at the balance it was moved to */
+  g_assert_cmpuint (f->writes->len, ==, 1);
+  w = &g_array_index (f->writes, pa_cvolume, 0);
+  g_assert_cmpuint (w->channels, ==, 2);
+  g_assert_cmpuint (w->values[0], <, w->values[1]);
+  g_assert_cmpuint (xvd_get_readable_volume (&i->volume), ==, 60);
+  g_assert_cmpuint (pa_cvolume_max (w), ==, pa_cvolume_max (&i->volume));
+}
+
+
+gint
+main (gint    argc,
+      gchar **argv)
+{
+  gint rc;
+
+  g_test_init (&argc, &argv, NULL);
+
+  test_bus = g_test_dbus_new (G_TEST_DBUS_NONE);
+  g_test_dbus_up (test_bus);
+
+  g_test_add ("/groups/member-balance", Fixture, NULL,
+              fixture_set_up, test_member_balance, fixture_tear_down);
+
+  rc = g_test_run ();
+
+  g_test_dbus_stop (test_bus);
+  g_object_unref (test_bus);
+  return rc;
+}
@@ -0,0 +1,502 @@
+/*
+ *  xfce4-volumed-pulse - Volume management daemon for XFCE 4 (Pulseaudio variant)
+ *
+ *  Copyright © 2026 The Xfce Development Team
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * The keys, pressed through XTest on a private Xvfb, against a replayed
+ * server: the stream keys change the stream of the focused application,
+ * the push-to-talk key unmutes the microphone while held, also once it is
+ * bound to another key, and the time from the synthetic key event to the
+ * server write is measured. Skipped
+ * without Xvfb or XTest.
+ */
+
+#include <signal.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <gio/gio.h>
+#include <gtk/gtk.h>
+#include <gdk/gdkx.h>
+#include <libnotify/notify.h>
+#include <X11/Xatom.h>
+#include <X11/keysym.h>
+#include <X11/XF86keysym.h>
+#include <X11/extensions/XTest.h>
+
+#include "xvd_keys.h"
+#include "xvd_notify.h"
+#include "xvd_pulse.h"
+#include "xvd_record.h"
+#include "xvd_window.h"
+
+#include "xvd-fake-notifyd.h"
+#include "xvd-test-util.h"
+
+
+#define SINK            0
+#define SOURCE          1
+#define STREAM_FOCUSED  10
+#define STREAM_OTHER    11
+#define PID_FOCUSED     4242
+#define PID_OTHER       4343
+
+#define PTT_KEY         "F12"
+#define PTT_OTHER_KEY   "F11"
+#define PTT_PRESSES     20
+/* from the key event to the server write */
+#define PTT_LATENCY_MAX (10 * G_TIME_SPAN_MILLISECOND)
+
+#define WAIT_TIMEOUT_MS 5000
+/* how long a key that does nothing is given to do it */
+#define QUIET_MS        200
+
+/* meson's exit code for a skipped test */
+#define EXIT_SKIP 77
+
+static const gchar *caps_gauge[] = { "body", LAYOUT_ICON_ONLY, SYNCHRONOUS, NULL };
+
+
+/* a write the server got */
+typedef struct
+{
+  guint32 facility;
+  guint32 index;
+  gint    volume;   /* percent, -1 for a mute change */
+  gint    mute;     /* -1 for a volume change */
+  gint64  time;
+} Write;
+
+static XvdInstance *inst = NULL;
+static GArray      *writes = NULL;
+
+/* the connection the keys and the windows of the applications come from */
+static Display     *xdisplay = NULL;
+static KeyCode      control_code, raise_code, ptt_code, ptt_other_code;
+
+
+static void
+on_write (guint32           facility,
+          guint32           index,
+          const pa_cvolume *volume,
+          gint              mute,
+          gpointer          userdata)
+{
+  Write w;
+
+  w.facility = facility;
+  w.index = index;
+  w.volume = volume ? xvd_get_readable_volume (volume) : -1;
+  w.mute = mute;
+  w.time = g_get_monotonic_time ();
+  g_array_append_val (writes, w);
+}
+
+
+static gboolean
+on_timeout (gpointer userdata)
+{
+  *(gboolean *) userdata = TRUE;
+  return G_SOURCE_REMOVE;
+}
+
+
+/* runs the main loop until @cond holds, fails after WAIT_TIMEOUT_MS */
+#define WAIT_FOR(cond) \
+  G_STMT_START { \
+    gboolean timed_out = FALSE; \
+    guint    timeout = g_timeout_add (WAIT_TIMEOUT_MS, on_timeout, &timed_out); \
+    while (!(cond) && !timed_out) \
+      g_main_context_iteration (NULL, TRUE); \
+    if (!timed_out) \
+      g_source_remove (timeout); \
+    g_assert_true (cond); \
+  } G_STMT_END
+
+
+/**
+ * Returns the first write to @facility, NULL if none.
+ */
+static Write *
+find_write (guint32 facility)
+{
+  guint n;
+
+  for (n = 0; n < writes->len; n++)
+    if (g_array_index (writes, Write, n).facility == facility)
+      return &g_array_index (writes, Write, n);
+
+  return NULL;
+}
+
+
+/**
+ * Starts Xvfb on a free display and points DISPLAY at it. Returns NULL
+ * if it can't run.
+ */
+static GSubprocess *
+start_xvfb (void)
+{
+  GSubprocess      *xvfb;
+  GDataInputStream *output;
+  gchar            *number, *display;
+  GError           *error = NULL;
+
+  /* it tells the display it picked on its standard output */
+  xvfb = g_subprocess_new (G_SUBPROCESS_FLAGS_STDOUT_PIPE | G_SUBPROCESS_FLAGS_STDERR_SILENCE,
+                           &error, "Xvfb", "-displayfd", "1", "-nolisten", "tcp",
+                           "-noreset", "-screen", "0", "640x480x24", NULL);
+  if (!xvfb)
+    {
+      g_print ("can't run Xvfb: %s\n", error->message);
+      g_error_free (error);
+      return NULL;
+    }
+
+  output = g_data_input_stream_new (g_subprocess_get_stdout_pipe (xvfb));
+  number = g_data_input_stream_read_line (output, NULL, NULL, NULL);
+  g_object_unref (output);
+  if (!number)
+    {
+      g_print ("Xvfb didn't start\n");
+      g_object_unref (xvfb);
+      return NULL;
+    }
+
+  display = g_strconcat (":", number, NULL);
+  g_setenv ("DISPLAY", display, TRUE);
+  g_free (display);
+  g_free (number);
+
+  return xvfb;
+}
+
+
+/**
+ * Returns the keycode of @keysym, given to a free keycode if the keymap
+ * has none. Done before GDK connects, so that it reads the final keymap.
+ */
+static KeyCode
+keycode_for (KeySym keysym)
+{
+  KeyCode  code = XKeysymToKeycode (xdisplay, keysym);
+  KeySym  *map;
+  gint     min, max, per, n, k;
+
+  if (code)
+    return code;
+
+  XDisplayKeycodes (xdisplay, &min, &max);
+  map = XGetKeyboardMapping (xdisplay, min, max - min + 1, &per);
+  for (n = max; n >= min && !code; n--)
+    {
+      for (k = 0; k < per && map[(n - min) * per + k] == NoSymbol; k++)
+        ;
+      if (k == per)
+        {
+          XChangeKeyboardMapping (xdisplay, n, 1, &keysym, 1);
+          code = n;
+        }
+    }
+  XFree (map);
+  XSync (xdisplay, False);
+
+  return code;
+}
+
+
+static void
+key (KeyCode  code,
+     gboolean press)
+{
+  XTestFakeKeyEvent (xdisplay, code, press, CurrentTime);
+  XFlush (xdisplay);
+}
+
+
+/**
+ * Makes a window of process @pid the active one, as a window manager
+ * would, and waits for the daemon to notice.
+ */
+static void
+focus_pid (gint pid)
+{
+  Window window;
+  gulong value = pid;
+
+  window = XCreateSimpleWindow (xdisplay, DefaultRootWindow (xdisplay), 0, 0, 10, 10, 0, 0, 0);
+  XChangeProperty (xdisplay, window, XInternAtom (xdisplay, "_NET_WM_PID", False),
+                   XA_CARDINAL, 32, PropModeReplace, (guchar *) &value, 1);
+  value = window;
+  XChangeProperty (xdisplay, DefaultRootWindow (xdisplay),
+                   XInternAtom (xdisplay, "_NET_ACTIVE_WINDOW", False),
+                   XA_WINDOW, 32, PropModeReplace, (guchar *) &value, 1);
+  XFlush (xdisplay);
+
+  WAIT_FOR (g_atomic_int_get (&inst->focused_pid) == pid);
+}
+
+
+/**
+ * Writes a recording of a server with a sink, a microphone muted, and a
+ * stream at 50% for each of two applications. The other one played last.
+ * Returns its path.
+ */
+static gchar *
+write_recording (void)
+{
+  pa_proplist *props = pa_proplist_new ();
+  gchar       *path, pid[16];
+
+  path = xvd_test_recording_new ("test-keys-x11", SINK, SOURCE);
+  xvd_test_record_sink (SINK, "alsa_output.test", 50, 50, FALSE, NULL);
+  xvd_test_record_source (SOURCE, "alsa_input.test", TRUE, PA_INVALID_INDEX);
+
+  pa_proplist_sets (props, PA_PROP_APPLICATION_NAME, "focused");
+  g_snprintf (pid, sizeof (pid), "%d", PID_FOCUSED);
+  pa_proplist_sets (props, PA_PROP_APPLICATION_PROCESS_ID, pid);
+  xvd_test_record_stream (STREAM_FOCUSED, 50, props);
+
+  pa_proplist_sets (props, PA_PROP_APPLICATION_NAME, "other");
+  g_snprintf (pid, sizeof (pid), "%d", PID_OTHER);
+  pa_proplist_sets (props, PA_PROP_APPLICATION_PROCESS_ID, pid);
+  xvd_test_record_stream (STREAM_OTHER, 50, props);
+
+  xvd_record_stop ();
+  pa_proplist_free (props);
+
+  return path;
+}
+
+
+/**
+ * Presses <Ctrl>XF86AudioRaiseVolume, returns the stream the server got
+ * a volume for.
+ */
+static guint32
+raise_stream (void)
+{
+  Write *w;
+
+  g_array_set_size (writes, 0);
+  key (control_code, TRUE);
+  key (raise_code, TRUE);
+  key (raise_code, FALSE);
+  key (control_code, FALSE);
+
+  WAIT_FOR (find_write (PA_SUBSCRIPTION_EVENT_SINK_INPUT) != NULL);
+  w = find_write (PA_SUBSCRIPTION_EVENT_SINK_INPUT);
+  g_assert_cmpint (w->mute, ==, -1);
+  g_assert_null (find_write (PA_SUBSCRIPTION_EVENT_SINK));
+
+  /* the answer, before the next key */
+  while (inst->pending[XVD_OP_STREAM_VOLUME].op)
+    g_main_context_iteration (NULL, TRUE);
+
+  return w->index;
+}
+
+
+static void
+test_stream_focused (void)
+{
+  focus_pid (PID_FOCUSED);
+  g_assert_cmpuint (raise_stream (), ==, STREAM_FOCUSED);
+
+  focus_pid (PID_OTHER);
+  g_assert_cmpuint (raise_stream (), ==, STREAM_OTHER);
+}
+
+
+static void
+test_stream_unfocused (void)
+{
+  /* an application without a stream, the one that played last gets it */
+  focus_pid (getpid ());
+  g_assert_cmpuint (raise_stream (), ==, STREAM_OTHER);
+}
+
+
+static gint
+compare_span (gconstpointer a,
+              gconstpointer b)
+{
+  GTimeSpan x = *(const GTimeSpan *) a, y = *(const GTimeSpan *) b;
+
+  return (x > y) - (x < y);
+}
+
+
+/**
+ * Sends a press or a release of the push-to-talk key @code, returns the
+ * time until the server got the microphone mute it means.
+ */
+static GTimeSpan
+push_to_talk (KeyCode  code,
+              gboolean press)
+{
+  Write  *w;
+  gint64  start;
+
+  g_array_set_size (writes, 0);
+  start = g_get_monotonic_time ();
+  key (code, press);
+
+  WAIT_FOR (find_write (PA_SUBSCRIPTION_EVENT_SOURCE) != NULL);
+  w = find_write (PA_SUBSCRIPTION_EVENT_SOURCE);
+  g_assert_cmpuint (w->index, ==, SOURCE);
+  g_assert_cmpint (w->mute, ==, !press);
+
+  return w->time - start;
+}
+
+
+static void
+test_push_to_talk (void)
+{
+  GTimeSpan latency[2 * PTT_PRESSES];
+  guint     n;
+
+  xvd_keys_set_push_to_talk (inst, PTT_KEY);
+  gdk_display_sync (gdk_display_get_default ());
+
+  for (n = 0; n < PTT_PRESSES; n++)
+    {
+      latency[2 * n] = push_to_talk (ptt_code, TRUE);
+      g_assert_false (inst->mic_mute);
+      latency[2 * n + 1] = push_to_talk (ptt_code, FALSE);
+      g_assert_true (inst->mic_mute);
+    }
+
+  qsort (latency, G_N_ELEMENTS (latency), sizeof (GTimeSpan), compare_span);
+  g_test_message ("push-to-talk: key to write %" G_GINT64_FORMAT " us median, %"
+                  G_GINT64_FORMAT " us max", latency[G_N_ELEMENTS (latency) / 2],
+                  latency[G_N_ELEMENTS (latency) - 1]);
+  g_assert_cmpint (latency[G_N_ELEMENTS (latency) / 2], <, PTT_LATENCY_MAX);
+}
+
+
+static void
+test_push_to_talk_rebind (void)
+{
+  gboolean quiet = FALSE;
+
+  xvd_keys_set_push_to_talk (inst, PTT_OTHER_KEY);
+  gdk_display_sync (gdk_display_get_default ());
+
+  /* the old key is let go of */
+  g_array_set_size (writes, 0);
+  key (ptt_code, TRUE);
+  key (ptt_code, FALSE);
+  g_timeout_add (QUIET_MS, on_timeout, &quiet);
+  while (!quiet)
+    g_main_context_iteration (NULL, TRUE);
+  g_assert_null (find_write (PA_SUBSCRIPTION_EVENT_SOURCE));
+
+  push_to_talk (ptt_other_code, TRUE);
+  g_assert_false (inst->mic_mute);
+  push_to_talk (ptt_other_code, FALSE);
+  g_assert_true (inst->mic_mute);
+}
+
+
+gint
+main (gint    argc,
+      gchar **argv)
+{
+  GTestDBus      *bus;
+  XvdFakeNotifyd *server;
+  GSubprocess    *xvfb;
+  gchar          *path;
+  gint            event, error, major, minor, rc;
+
+  g_test_init (&argc, &argv, NULL);
+
+  path = g_find_program_in_path ("Xvfb");
+  if (!path)
+    {
+      g_print ("no Xvfb, skipped\n");
+      return EXIT_SKIP;
+    }
+  g_free (path);
+  xvfb = start_xvfb ();
+  if (!xvfb)
+    return EXIT_SKIP;
+
+  xdisplay = XOpenDisplay (NULL);
+  if (!xdisplay || !XTestQueryExtension (xdisplay, &event, &error, &major, &minor))
+    {
+      g_print ("no XTest, skipped\n");
+      g_subprocess_send_signal (xvfb, SIGTERM);
+      return EXIT_SKIP;
+    }
+  control_code = keycode_for (XK_Control_L);
+  raise_code = keycode_for (XF86XK_AudioRaiseVolume);
+  ptt_code = keycode_for (XStringToKeysym (PTT_KEY));
+  ptt_other_code = keycode_for (XStringToKeysym (PTT_OTHER_KEY));
+
+  g_setenv ("GDK_BACKEND", "x11", TRUE);
+  g_assert_true (gtk_init_check (&argc, &argv));
+
+  bus = g_test_dbus_new (G_TEST_DBUS_NONE);
+  g_test_dbus_up (bus);
+  server = xvd_fake_notifyd_new (g_test_dbus_get_bus_address (bus), caps_gauge);
+
+  path = write_recording ();
+  writes = g_array_new (FALSE, FALSE, sizeof (Write));
+
+  inst = xvd_test_instance_new ("test-keys-x11", server);
+  inst->vol_step = 5;
+  inst->vol_step_accel = 1;
+
+  xvd_keys_init (inst);
+  xvd_window_init (inst);
+  gdk_display_sync (gdk_display_get_default ());
+
+  g_assert_true (xvd_replay_start (inst, path, FALSE));
+  xvd_replay_set_write_func (on_write, NULL);
+  g_assert_true (xvd_open_pulse (inst));
+  WAIT_FOR (inst->source_index != PA_INVALID_INDEX
+            && g_hash_table_size (inst->streams) == 2);
+
+  g_test_add_func ("/keys/stream/focused", test_stream_focused);
+  g_test_add_func ("/keys/stream/unfocused", test_stream_unfocused);
+  g_test_add_func ("/keys/push-to-talk", test_push_to_talk);
+  g_test_add_func ("/keys/push-to-talk/rebind", test_push_to_talk_rebind);
+
+  rc = g_test_run ();
+
+  xvd_replay_set_write_func (NULL, NULL);
+  xvd_close_pulse (inst);
+  xvd_window_shutdown (inst);
+  xvd_keys_release (inst);
+  xvd_test_instance_free (inst);
+  g_array_free (writes, TRUE);
+  xvd_fake_notifyd_free (server);
+  xvd_test_recording_free (path);
+
+  g_test_dbus_down (bus);
+  g_object_unref (bus);
+
+  XCloseDisplay (xdisplay);
+  g_subprocess_send_signal (xvfb, SIGTERM);
+  g_subprocess_wait (xvfb, NULL, NULL);
+  g_object_unref (xvfb);
+
+  return rc;
+}
@@ -0,0 +1,422 @@
+/*
+ *  xfce4-volumed-pulse - Volume management daemon for XFCE 4 (Pulseaudio variant)
+ *
+ *  Copyright © 2026 The Xfce Development Team
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * The notifications against a fake server on a private bus: what the
+ * server capabilities turn on, how many Notify calls a burst costs, and
+ * which ones are left out because the popup still shows the same.
+ */
+
+#include <gio/gio.h>
+#include <libnotify/notify.h>
+
+#include "xvd_notify.h"
+#include "xvd_pulse.h"
+#include "xvd_work.h"
+
+#include "xvd-fake-notifyd.h"
+#include "xvd-test-util.h"
+
+
+static const gchar *caps_gauge[] = { "body", LAYOUT_ICON_ONLY, SYNCHRONOUS, NULL };
+static const gchar *caps_plain[] = { "body", "actions", NULL };
+
+static GTestDBus *test_bus = NULL;
+
+
+typedef struct
+{
+  XvdFakeNotifyd *server;
+  XvdInstance    *inst;
+} Fixture;
+
+
+static void
+set_volume (XvdInstance *i,
+            guint        percent,
+            gboolean     mute)
+{
+  pa_cvolume_set (&i->osd.volume, 2, (pa_volume_t) ((guint64) PA_VOLUME_NORM * percent / 100));
+  i->osd.mute = mute;
+}
+
+
+static void
+fixture_set_up (Fixture       *f,
+                gconstpointer  caps)
+{
+  if (caps)
+    f->server = xvd_fake_notifyd_new (g_test_dbus_get_bus_address (test_bus), caps);
+  f->inst = xvd_test_instance_new ("test-notify", f->server);
+  set_volume (f->inst, 50, FALSE);
+}
+
+
+static void
+fixture_tear_down (Fixture       *f,
+                   gconstpointer  caps)
+{
+  xvd_test_instance_free (f->inst);
+  xvd_fake_notifyd_free (f->server);
+}
+
+
+static gint
+hint_int (XvdFakeNotification *n,
+          const gchar         *name)
+{
+  GVariant *hint = xvd_fake_notification_hint (n, name);
+  gint      value;
+
+  if (!hint)
+    return G_MININT;
+
+  if (g_variant_is_of_type (hint, G_VARIANT_TYPE_BOOLEAN))
+    value = g_variant_get_boolean (hint);
+  else if (g_variant_is_of_type (hint, G_VARIANT_TYPE_INT32))
+    value = g_variant_get_int32 (hint);
+  else
+    value = 0;
+  g_variant_unref (hint);
+  return value;
+}
+
+
+static gboolean
+has_hint (XvdFakeNotification *n,
+          const gchar         *name)
+{
+  GVariant *hint = xvd_fake_notification_hint (n, name);
+
+  if (!hint)
+    return FALSE;
+  g_variant_unref (hint);
+  return TRUE;
+}
+
+
+static void
+test_caps_gauge (Fixture       *f,
+                 gconstpointer  caps)
+{
+  XvdFakeNotification *n;
+
+  g_assert_true (f->inst->gauge_notifications);
+
+  xvd_notify_volume_notification (f->inst);
+  g_assert_cmpuint (xvd_fake_notifyd_count (f->server), ==, 1);
+
+  n = xvd_fake_notifyd_get (f->server, 0);
+  g_assert_cmpstr (n->icon, ==, ICON_AUDIO_VOLUME_MEDIUM);
+  g_assert_cmpint (hint_int (n, "value"), ==, 50);
+  g_assert_true (has_hint (n, SYNCHRONOUS));
+  g_assert_cmpint (hint_int (n, "transient"), ==, TRUE);
+  xvd_fake_notification_free (n);
+}
+
+
+static void
+test_caps_plain (Fixture       *f,
+                 gconstpointer  caps)
+{
+  XvdFakeNotification *n;
+
+  g_assert_false (f->inst->gauge_notifications);
+
+  xvd_notify_volume_notification (f->inst);
+  n = xvd_fake_notifyd_get (f->server, 0);
+  g_assert_nonnull (n);
+  g_assert_cmpstr (n->summary, ==, "Volume is at 50%");
+  g_assert_false (has_hint (n, "value"));
+  g_assert_false (has_hint (n, SYNCHRONOUS));
+  g_assert_cmpint (hint_int (n, "transient"), ==, TRUE);
+  xvd_fake_notification_free (n);
+
+  xvd_notify_mic_notification (f->inst);
+  n = xvd_fake_notifyd_get (f->server, 1);
+  g_assert_false (has_hint (n, LAYOUT_ICON_ONLY));
+  xvd_fake_notification_free (n);
+}
+
+
+static void
+test_caps_late_server (Fixture       *f,
+                       gconstpointer  caps)
+{
+  XvdFakeNotification *n;
+
+  /* nobody answered at startup: gauges, as before servers had caps */
+  g_assert_true (f->inst->gauge_notifications);
+  g_assert_false (f->inst->notify_caps_known);
+
+  /* the server shows up later, without gauges: asked once it took the name */
+  f->server = xvd_fake_notifyd_new (g_test_dbus_get_bus_address (test_bus), caps_plain);
+  while (!f->inst->notify_caps_known)
+    g_main_context_iteration (NULL, TRUE);
+  g_assert_false (f->inst->gauge_notifications);
+
+  xvd_notify_volume_notification (f->inst);
+  g_assert_cmpuint (xvd_fake_notifyd_count (f->server), ==, 1);
+  n = xvd_fake_notifyd_get (f->server, 0);
+  g_assert_false (has_hint (n, "value"));
+  g_assert_false (has_hint (n, SYNCHRONOUS));
+  xvd_fake_notification_free (n);
+
+  /* another server replaces it, with gauges: asked again */
+  xvd_fake_notifyd_free (f->server);
+  while (f->inst->notify_caps_known)
+    g_main_context_iteration (NULL, TRUE);
+  f->server = xvd_fake_notifyd_new (g_test_dbus_get_bus_address (test_bus), caps_gauge);
+  while (!f->inst->notify_caps_known)
+    g_main_context_iteration (NULL, TRUE);
+  g_assert_true (f->inst->gauge_notifications);
+
+  xvd_notify_volume_notification (f->inst);
+  n = xvd_fake_notifyd_get (f->server, 0);
+  g_assert_cmpint (hint_int (n, "value"), ==, 50);
+  g_assert_true (has_hint (n, SYNCHRONOUS));
+  xvd_fake_notification_free (n);
+}
+
+
+static void
+test_overshoot (Fixture       *f,
+                gconstpointer  caps)
+{
+  XvdFakeNotification *n;
+  gboolean             gauge = f->inst->gauge_notifications;
+
+  set_volume (f->inst, 100, FALSE);
+  xvd_notify_overshoot_notification (f->inst);
+  n = xvd_fake_notifyd_get (f->server, 0);
+  if (gauge)
+    g_assert_cmpint (hint_int (n, "value"), ==, 101);
+  else
+    g_assert_cmpstr (n->summary, ==, "Volume is at 100%");
+  g_assert_cmpstr (n->icon, ==, ICON_AUDIO_VOLUME_HIGH);
+  xvd_fake_notification_free (n);
+
+  set_volume (f->inst, 0, FALSE);
+  xvd_notify_undershoot_notification (f->inst);
+  n = xvd_fake_notifyd_get (f->server, 1);
+  if (gauge)
+    g_assert_cmpint (hint_int (n, "value"), ==, -1);
+  else
+    g_assert_cmpstr (n->summary, ==, "Volume is at 0%");
+  g_assert_cmpstr (n->icon, ==, ICON_AUDIO_VOLUME_OFF);
+  xvd_fake_notification_free (n);
+}
+
+
+static void
+test_mic_icon_only (Fixture       *f,
+                    gconstpointer  caps)
+{
+  XvdFakeNotification *n;
+
+  f->inst->osd.mic_mute = TRUE;
+  xvd_notify_mic_notification (f->inst);
+  n = xvd_fake_notifyd_get (f->server, 0);
+  g_assert_cmpstr (n->summary, ==, "Microphone is muted");
+  g_assert_cmpstr (n->icon, ==, ICON_MICROPHONE_MUTED);
+  g_assert_cmpint (hint_int (n, LAYOUT_ICON_ONLY), ==, 1);
+  g_assert_false (has_hint (n, "value"));
+  xvd_fake_notification_free (n);
+
+  /* the mute-all popup has a title to show */
+  f->inst->osd.mute = TRUE;
+  xvd_notify_mute_all_notification (f->inst);
+  n = xvd_fake_notifyd_get (f->server, 1);
+  g_assert_cmpstr (n->summary, ==, "Sound and microphone are muted");
+  g_assert_false (has_hint (n, LAYOUT_ICON_ONLY));
+  xvd_fake_notification_free (n);
+}
+
+
+static void
+run_pending (void)
+{
+  while (g_main_context_iteration (NULL, FALSE))
+    ;
+}
+
+
+static void
+test_burst (Fixture       *f,
+            gconstpointer  caps)
+{
+  XvdFakeNotification *n;
+  guint                step;
+
+  /* a held key: every step queues the popup, one Notify goes out */
+  for (step = 1; step <= 20; step++)
+    {
+      set_volume (f->inst, 50 + step, FALSE);
+      xvd_work_queue (f->inst, XVD_WORK_NOTIFY_VOLUME, xvd_test_notify_volume);
+    }
+  run_pending ();
+
+  g_assert_cmpuint (xvd_fake_notifyd_count (f->server), ==, 1);
+  n = xvd_fake_notifyd_get (f->server, 0);
+  g_assert_cmpint (hint_int (n, "value"), ==, 70);
+  xvd_fake_notification_free (n);
+
+  /* the next burst replaces the popup on screen */
+  for (step = 1; step <= 20; step++)
+    {
+      set_volume (f->inst, 70 - step, FALSE);
+      xvd_work_queue (f->inst, XVD_WORK_NOTIFY_VOLUME, xvd_test_notify_volume);
+    }
+  run_pending ();
+
+  g_assert_cmpuint (xvd_fake_notifyd_count (f->server), ==, 2);
+  n = xvd_fake_notifyd_get (f->server, 1);
+  g_assert_cmpint (hint_int (n, "value"), ==, 50);
+  g_assert_cmpuint (n->replaces_id, ==, n->id);
+  xvd_fake_notification_free (n);
+
+  g_assert_cmpuint (f->inst->stats.notifications_sent, ==, 2);
+  g_assert_cmpuint (f->inst->stats.notifications_failed, ==, 0);
+}
+
+
+static gboolean
+timed_out (gpointer data)
+{
+  *(gboolean *) data = TRUE;
+  return G_SOURCE_REMOVE;
+}
+
+
+/**
+ * Runs the main loop until @popup is known to be closed, or 5 s passed.
+ */
+static gboolean
+wait_closed (XvdPopup *popup)
+{
+  gboolean timeout = FALSE;
+  guint    id = g_timeout_add (5000, timed_out, &timeout);
+
+  while (popup->until != 0 && !timeout)
+    g_main_context_iteration (NULL, TRUE);
+
+  if (!timeout)
+    g_source_remove (id);
+  return popup->until == 0;
+}
+
+
+static void
+show_all (XvdInstance *i)
+{
+  xvd_notify_volume_notification (i);
+  xvd_notify_mic_notification (i);
+  xvd_notify_device_notification (i);
+  xvd_notify_mute_all_notification (i);
+}
+
+
+static void
+test_saved (Fixture       *f,
+            gconstpointer  caps)
+{
+  g_strlcpy (f->inst->osd.device_name, "USB headset", sizeof (f->inst->osd.device_name));
+
+  show_all (f->inst);
+  g_assert_cmpuint (xvd_fake_notifyd_count (f->server), ==, 4);
+
+  /* the echo of our own change: every popup still shows it */
+  show_all (f->inst);
+  g_assert_cmpuint (xvd_fake_notifyd_count (f->server), ==, 4);
+  g_assert_cmpuint (f->inst->stats.notifications_sent, ==, 4);
+  g_assert_cmpuint (f->inst->stats.notifications_saved, ==, 4);
+
+  /* a change goes out on its own popup only */
+  f->inst->osd.mic_mute = TRUE;
+  show_all (f->inst);
+  g_assert_cmpuint (xvd_fake_notifyd_count (f->server), ==, 5);
+  g_assert_cmpuint (f->inst->stats.notifications_saved, ==, 7);
+}
+
+
+static void
+test_closed (Fixture       *f,
+             gconstpointer  caps)
+{
+  XvdPopup *popups[] = { &f->inst->popup, &f->inst->popup_mic,
+                         &f->inst->popup_device, &f->inst->popup_mute_all };
+  guint     n, count;
+
+  show_all (f->inst);
+  count = xvd_fake_notifyd_count (f->server);
+  g_assert_cmpuint (count, ==, 4);
+
+  for (n = 0; n < G_N_ELEMENTS (popups); n++)
+    {
+      XvdFakeNotification *sent = xvd_fake_notifyd_get (f->server, n);
+
+      g_assert_cmpint (popups[n]->until, >, 0);
+      xvd_fake_notifyd_close (f->server, sent->id);
+      g_assert_true (wait_closed (popups[n]));
+      xvd_fake_notification_free (sent);
+
+      /* the others are still on screen */
+      if (n + 1 < G_N_ELEMENTS (popups))
+        g_assert_cmpint (popups[n + 1]->until, >, 0);
+    }
+
+  /* nothing on screen any more, the same state is sent again */
+  show_all (f->inst);
+  g_assert_cmpuint (xvd_fake_notifyd_count (f->server), ==, count + 4);
+}
+
+
+gint
+main (gint    argc,
+      gchar **argv)
+{
+  gint rc;
+
+  g_test_init (&argc, &argv, NULL);
+
+  test_bus = g_test_dbus_new (G_TEST_DBUS_NONE);
+  g_test_dbus_up (test_bus);
+
+#define ADD(path, caps, func) \
+  g_test_add (path, Fixture, caps, fixture_set_up, func, fixture_tear_down)
+
+  ADD ("/notify/caps/gauge", caps_gauge, test_caps_gauge);
+  ADD ("/notify/caps/plain", caps_plain, test_caps_plain);
+  ADD ("/notify/caps/late-server", NULL, test_caps_late_server);
+  ADD ("/notify/overshoot/gauge", caps_gauge, test_overshoot);
+  ADD ("/notify/overshoot/plain", caps_plain, test_overshoot);
+  ADD ("/notify/mic/icon-only", caps_gauge, test_mic_icon_only);
+  ADD ("/notify/burst", caps_gauge, test_burst);
+  ADD ("/notify/saved", caps_gauge, test_saved);
+  ADD ("/notify/closed", caps_gauge, test_closed);
+
+#undef ADD
+
+  rc = g_test_run ();
+
+  /* libnotify may keep its connection to the bus, don't wait for it */
+  g_test_dbus_stop (test_bus);
+  g_object_unref (test_bus);
+  return rc;
+}
@@ -0,0 +1,256 @@
+/*
+ *  xfce4-volumed-pulse - Volume management daemon for XFCE 4 (Pulseaudio variant)
+ *
+ *  Copyright © 2026 The Xfce Development Team
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * The volume ramps against a replayed server: the writes it gets, in the
+ * order it applies them, and how many.
+ */
+
+#include <gio/gio.h>
+#include <libnotify/notify.h>
+
+#include "xvd_notify.h"
+#include "xvd_pulse.h"
+#include "xvd_record.h"
+
+#include "xvd-fake-notifyd.h"
+#include "xvd-test-util.h"
+
+
+#define RAMP_MS   100
+#define SINK      0
+
+static const gchar *caps_gauge[] = { "body", LAYOUT_ICON_ONLY, SYNCHRONOUS, NULL };
+
+static GTestDBus *test_bus = NULL;
+
+
+/* a write the server got */
+typedef struct
+{
+  gint volume;    /* percent, -1 for a mute change */
+  gint mute;      /* -1 for a volume change */
+} Write;
+
+typedef struct
+{
+  XvdFakeNotifyd *server;
+  XvdInstance    *inst;
+  gchar          *path;
+  GArray         *writes;
+} Fixture;
+
+
+static void
+on_write (guint32           facility,
+          guint32           index,
+          const pa_cvolume *volume,
+          gint              mute,
+          gpointer          userdata)
+{
+  Fixture *f = userdata;
+  Write    w;
+
+  if (facility != PA_SUBSCRIPTION_EVENT_SINK || index != SINK)
+    return;
+
+  w.volume = volume ? xvd_get_readable_volume (volume) : -1;
+  w.mute = mute;
+  g_array_append_val (f->writes, w);
+}
+
+
+static void
+fixture_set_up (Fixture       *f,
+                gconstpointer  data)
+{
+  XvdInstance *i;
+
+  f->server = xvd_fake_notifyd_new (g_test_dbus_get_bus_address (test_bus), caps_gauge);
+  f->writes = g_array_new (FALSE, FALSE, sizeof (Write));
+
+  /* a single sink, muted at 50% */
+  f->path = xvd_test_recording_new ("test-ramp", SINK, PA_INVALID_INDEX);
+  xvd_test_record_sink (SINK, "alsa_output.test", 50, 50, TRUE, NULL);
+  xvd_record_stop ();
+
+  f->inst = i = xvd_test_instance_new ("test-ramp", f->server);
+  i->vol_ramp_duration = RAMP_MS;
+
+  xvd_replay_set_write_func (on_write, f);
+  xvd_test_replay (i, f->path);
+}
+
+
+static void
+fixture_tear_down (Fixture       *f,
+                   gconstpointer  data)
+{
+  xvd_replay_set_write_func (NULL, NULL);
+  xvd_close_pulse (f->inst);
+  xvd_test_instance_free (f->inst);
+  xvd_fake_notifyd_free (f->server);
+  xvd_test_recording_free (f->path);
+  g_array_free (f->writes, TRUE);
+}
+
+
+/**
+ * Runs the main loop until the ramp is over and the server answered all
+ * the writes.
+ */
+static void
+settle (XvdInstance *i)
+{
+  while (i->ramp_event
+         || i->pending[XVD_OP_SINK_VOLUME].op
+         || i->pending[XVD_OP_SINK_MUTE].op)
+    g_main_context_iteration (NULL, TRUE);
+}
+
+
+/**
+ * Checks that the unmute came after a silent volume, with no louder one
+ * in between, and that the ramp ends at @percent. Returns the number of
+ * volume writes.
+ */
+static guint
+check_unmute (Fixture *f,
+              gint     percent)
+{
+  gint  silent = -1, unmute = -1, n;
+  guint volumes = 0, mutes = 0;
+
+  for (n = 0; n < (gint) f->writes->len; n++)
+    {
+      Write *w = &g_array_index (f->writes, Write, n);
+
+      if (w->mute >= 0)
+        {
+          g_assert_cmpint (w->mute, ==, FALSE);
+          unmute = n;
+          mutes++;
+          continue;
+        }
+
+      volumes++;
+      if (w->volume == 0 && unmute < 0)
+        silent = n;
+      /* nothing louder goes out between the silence and the unmute */
+      else if (silent >= 0 && unmute < 0)
+        g_assert_not_reached ();
+    }
+
+  g_assert_cmpint (silent, >=, 0);
+  g_assert_cmpint (unmute, >, silent);
+  g_assert_cmpuint (mutes, ==, 1);
+  g_assert_cmpint (g_array_index (f->writes, Write, f->writes->len - 1).volume, ==, percent);
+  g_assert_false (f->inst->mute);
+
+  return volumes;
+}
+
+
+/**
+ * The maximum number of volume writes for a ramp: the silence, a frame
+ * every 1/60 s at most, and the last one.
+ */
+static guint
+max_ramp_writes (void)
+{
+  return 1 + RAMP_MS * 60 / 1000 + 1;
+}
+
+
+static void
+test_unmute (Fixture       *f,
+             gconstpointer  data)
+{
+  xvd_toggle_mute (f->inst);
+  settle (f->inst);
+
+  g_assert_cmpuint (check_unmute (f, 50), <=, max_ramp_writes ());
+}
+
+
+static void
+test_unmute_behind_volume (Fixture       *f,
+                           gconstpointer  data)
+{
+  /* a step still on its way to the server when the unmute comes */
+  f->inst->vol_ramp_duration = 0;
+  xvd_update_volume (f->inst, XVD_UP, 5);
+  f->inst->vol_ramp_duration = RAMP_MS;
+  g_assert_nonnull (f->inst->pending[XVD_OP_SINK_VOLUME].op);
+
+  xvd_toggle_mute (f->inst);
+  settle (f->inst);
+
+  /* the step is given up, the silence replaces it */
+  g_assert_cmpuint (check_unmute (f, 55), <=, max_ramp_writes ());
+}
+
+
+static void
+test_mute (Fixture       *f,
+           gconstpointer  data)
+{
+  Write *w;
+
+  /* unmuted first, then muted again: the mute goes out alone */
+  xvd_toggle_mute (f->inst);
+  settle (f->inst);
+  g_array_set_size (f->writes, 0);
+
+  xvd_toggle_mute (f->inst);
+  settle (f->inst);
+
+  g_assert_cmpuint (f->writes->len, ==, 1);
+  w = &g_array_index (f->writes, Write, 0);
+  g_assert_cmpint (w->mute, ==, TRUE);
+  g_assert_true (f->inst->mute);
+}
+
+
+gint
+main (gint    argc,
+      gchar **argv)
+{
+  gint rc;
+
+  g_test_init (&argc, &argv, NULL);
+
+  test_bus = g_test_dbus_new (G_TEST_DBUS_NONE);
+  g_test_dbus_up (test_bus);
+
+#define ADD(path, func) \
+  g_test_add (path, Fixture, NULL, fixture_set_up, func, fixture_tear_down)
+
+  ADD ("/ramp/unmute", test_unmute);
+  ADD ("/ramp/unmute/behind-volume", test_unmute_behind_volume);
+  ADD ("/ramp/mute", test_mute);
+
+#undef ADD
+
+  rc = g_test_run ();
+
+  g_test_dbus_stop (test_bus);
+  g_object_unref (test_bus);
+  return rc;
+}
@@ -0,0 +1,122 @@
+/*
+ *  xfce4-volumed-pulse - Volume management daemon for XFCE 4 (Pulseaudio variant)
+ *
+ *  Copyright © 2026 The Xfce Development Team
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Runs the daemon given as first argument with --count-wakeups, and the
+ * other arguments, on a private session bus: an idle daemon must not wake
+ * up. Skipped without an X display or a PulseAudio server to talk to.
+ */
+
+#include <gio/gio.h>
+#include <pulse/pulseaudio.h>
+
+
+#define WAKEUPS_SECONDS "5"
+
+/* meson's exit code for a skipped test */
+#define EXIT_SKIP 77
+
+
+/**
+ * Returns whether a PulseAudio server answers, without starting one.
+ */
+static gboolean
+have_pulse (void)
+{
+  pa_mainloop       *loop = pa_mainloop_new ();
+  pa_context        *context;
+  pa_context_state_t state = PA_CONTEXT_UNCONNECTED;
+
+  context = pa_context_new (pa_mainloop_get_api (loop), "test-wakeups");
+  if (pa_context_connect (context, NULL, PA_CONTEXT_NOAUTOSPAWN, NULL) >= 0)
+    do
+      {
+        if (pa_mainloop_iterate (loop, TRUE, NULL) < 0)
+          break;
+        state = pa_context_get_state (context);
+      }
+    while (PA_CONTEXT_IS_GOOD (state) && state != PA_CONTEXT_READY);
+
+  pa_context_disconnect (context);
+  pa_context_unref (context);
+  pa_mainloop_free (loop);
+
+  return state == PA_CONTEXT_READY;
+}
+
+
+gint
+main (gint    argc,
+      gchar **argv)
+{
+  GTestDBus *bus;
+  GPtrArray *args;
+  GError    *error = NULL;
+  gint       status = 0, n;
+
+  if (argc < 2)
+    {
+      g_printerr ("usage: %s DAEMON [ARGS...]\n", argv[0]);
+      return 1;
+    }
+
+  if (!g_getenv ("DISPLAY"))
+    {
+      g_print ("no X display, skipped\n");
+      return EXIT_SKIP;
+    }
+  if (!have_pulse ())
+    {
+      g_print ("no PulseAudio server, skipped\n");
+      return EXIT_SKIP;
+    }
+
+  /* alone on its bus, a running daemon can't make it quit */
+  bus = g_test_dbus_new (G_TEST_DBUS_NONE);
+  g_test_dbus_up (bus);
+
+  args = g_ptr_array_new ();
+  g_ptr_array_add (args, argv[1]);
+  g_ptr_array_add (args, "--no-daemon");
+  g_ptr_array_add (args, "--count-wakeups");
+  g_ptr_array_add (args, WAKEUPS_SECONDS);
+  for (n = 2; n < argc; n++)
+    g_ptr_array_add (args, argv[n]);
+  g_ptr_array_add (args, NULL);
+
+  /* it prints what it counted */
+  if (!g_spawn_sync (NULL, (gchar **) args->pdata, NULL, G_SPAWN_CHILD_INHERITS_STDIN,
+                     NULL, NULL, NULL, NULL, &status, &error))
+    {
+      g_printerr ("can't run %s: %s\n", argv[1], error->message);
+      g_error_free (error);
+      status = 1;
+    }
+  else if (!g_spawn_check_exit_status (status, &error))
+    {
+      g_printerr ("%s: %s\n", argv[1], error->message);
+      g_error_free (error);
+      status = 1;
+    }
+  g_ptr_array_free (args, TRUE);
+
+  g_test_dbus_down (bus);
+  g_object_unref (bus);
+  return status == 0 ? 0 : 1;
+}
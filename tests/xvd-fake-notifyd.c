@@ -0,0 +1,384 @@
+/*
+ *  xfce4-volumed-pulse - Volume management daemon for XFCE 4 (Pulseaudio variant)
+ *
+ *  Copyright © 2026 The Xfce Development Team
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "xvd-fake-notifyd.h"
+
+
+#define XVD_FAKE_NOTIFYD_NAME "org.freedesktop.Notifications"
+#define XVD_FAKE_NOTIFYD_PATH "/org/freedesktop/Notifications"
+
+static const gchar xvd_fake_notifyd_xml[] =
+  "<node>"
+  "  <interface name='org.freedesktop.Notifications'>"
+  "    <method name='GetCapabilities'>"
+  "      <arg type='as' name='caps' direction='out'/>"
+  "    </method>"
+  "    <method name='Notify'>"
+  "      <arg type='s' name='app_name' direction='in'/>"
+  "      <arg type='u' name='replaces_id' direction='in'/>"
+  "      <arg type='s' name='app_icon' direction='in'/>"
+  "      <arg type='s' name='summary' direction='in'/>"
+  "      <arg type='s' name='body' direction='in'/>"
+  "      <arg type='as' name='actions' direction='in'/>"
+  "      <arg type='a{sv}' name='hints' direction='in'/>"
+  "      <arg type='i' name='expire_timeout' direction='in'/>"
+  "      <arg type='u' name='id' direction='out'/>"
+  "    </method>"
+  "    <method name='CloseNotification'>"
+  "      <arg type='u' name='id' direction='in'/>"
+  "    </method>"
+  "    <method name='GetServerInformation'>"
+  "      <arg type='s' name='name' direction='out'/>"
+  "      <arg type='s' name='vendor' direction='out'/>"
+  "      <arg type='s' name='version' direction='out'/>"
+  "      <arg type='s' name='spec_version' direction='out'/>"
+  "    </method>"
+  "    <signal name='NotificationClosed'>"
+  "      <arg type='u' name='id'/>"
+  "      <arg type='u' name='reason'/>"
+  "    </signal>"
+  "  </interface>"
+  "</node>";
+
+struct _XvdFakeNotifyd
+{
+  gchar           *address;
+  gchar          **caps;
+  GThread         *thread;
+  GMainContext    *context;
+  GMainLoop       *loop;
+  GDBusConnection *connection;
+
+  GMutex           lock;
+  GCond            cond;
+  gboolean         ready;
+  guint            delay_ms;
+  guint32          last_id;
+  GPtrArray       *calls;
+};
+
+
+void
+xvd_fake_notification_free (XvdFakeNotification *notification)
+{
+  if (!notification)
+    return;
+
+  g_free (notification->summary);
+  g_free (notification->icon);
+  g_variant_unref (notification->hints);
+  g_free (notification);
+}
+
+
+static XvdFakeNotification *
+xvd_fake_notification_copy (const XvdFakeNotification *notification)
+{
+  XvdFakeNotification *copy = g_new0 (XvdFakeNotification, 1);
+
+  *copy = *notification;
+  copy->summary = g_strdup (notification->summary);
+  copy->icon = g_strdup (notification->icon);
+  copy->hints = g_variant_ref (notification->hints);
+  return copy;
+}
+
+
+GVariant *
+xvd_fake_notification_hint (XvdFakeNotification *notification,
+                            const gchar         *name)
+{
+  return g_variant_lookup_value (notification->hints, name, NULL);
+}
+
+
+/**
+ * Answers a Notify call once the configured delay has passed.
+ */
+static gboolean
+xvd_fake_notifyd_reply (gpointer data)
+{
+  GDBusMethodInvocation *invocation = data;
+  guint32                id = GPOINTER_TO_UINT (g_object_get_data (G_OBJECT (invocation), "id"));
+
+  g_dbus_method_invocation_return_value (invocation, g_variant_new ("(u)", id));
+  return G_SOURCE_REMOVE;
+}
+
+
+static void
+xvd_fake_notifyd_method_call (GDBusConnection       *connection,
+                              const gchar           *sender,
+                              const gchar           *path,
+                              const gchar           *interface,
+                              const gchar           *method,
+                              GVariant              *parameters,
+                              GDBusMethodInvocation *invocation,
+                              gpointer               user_data)
+{
+  XvdFakeNotifyd      *fake = user_data;
+  XvdFakeNotification *notification;
+  const gchar         *summary, *icon;
+  guint                delay_ms;
+
+  if (g_strcmp0 (method, "GetCapabilities") == 0)
+    {
+      g_dbus_method_invocation_return_value (invocation,
+                                             g_variant_new ("(^as)", fake->caps));
+    }
+  else if (g_strcmp0 (method, "Notify") == 0)
+    {
+      notification = g_new0 (XvdFakeNotification, 1);
+      notification->time = g_get_monotonic_time ();
+      g_variant_get (parameters, "(&su&s&s&s^a&s@a{sv}i)",
+                     NULL, &notification->replaces_id, &icon, &summary,
+                     NULL, NULL, &notification->hints, NULL);
+      notification->summary = g_strdup (summary);
+      notification->icon = g_strdup (icon);
+
+      g_mutex_lock (&fake->lock);
+      notification->id = (notification->replaces_id != 0)
+                         ? notification->replaces_id : ++fake->last_id;
+      g_ptr_array_add (fake->calls, notification);
+      delay_ms = fake->delay_ms;
+      g_cond_broadcast (&fake->cond);
+      g_mutex_unlock (&fake->lock);
+
+      g_object_set_data (G_OBJECT (invocation), "id", GUINT_TO_POINTER (notification->id));
+      if (delay_ms == 0)
+        {
+          xvd_fake_notifyd_reply (invocation);
+        }
+      else
+        {
+          GSource *source = g_timeout_source_new (delay_ms);
+
+          g_source_set_callback (source, xvd_fake_notifyd_reply, invocation, NULL);
+          g_source_attach (source, fake->context);
+          g_source_unref (source);
+        }
+    }
+  else if (g_strcmp0 (method, "CloseNotification") == 0)
+    {
+      guint32 id;
+
+      g_variant_get (parameters, "(u)", &id);
+      g_dbus_method_invocation_return_value (invocation, NULL);
+      /* 3: closed by a call to CloseNotification */
+      g_dbus_connection_emit_signal (connection, NULL, XVD_FAKE_NOTIFYD_PATH,
+                                     XVD_FAKE_NOTIFYD_NAME, "NotificationClosed",
+                                     g_variant_new ("(uu)", id, 3), NULL);
+    }
+  else if (g_strcmp0 (method, "GetServerInformation") == 0)
+    {
+      g_dbus_method_invocation_return_value (invocation,
+                                             g_variant_new ("(ssss)", "xvd-fake-notifyd",
+                                                            "Xfce", "1.0", "1.2"));
+    }
+}
+
+
+static const GDBusInterfaceVTable xvd_fake_notifyd_vtable =
+{
+  xvd_fake_notifyd_method_call,
+  NULL,
+  NULL,
+};
+
+
+static void
+xvd_fake_notifyd_name_acquired (GDBusConnection *connection,
+                                const gchar     *name,
+                                gpointer         user_data)
+{
+  XvdFakeNotifyd *fake = user_data;
+
+  g_mutex_lock (&fake->lock);
+  fake->ready = TRUE;
+  g_cond_broadcast (&fake->cond);
+  g_mutex_unlock (&fake->lock);
+}
+
+
+static void
+xvd_fake_notifyd_name_lost (GDBusConnection *connection,
+                            const gchar     *name,
+                            gpointer         user_data)
+{
+  g_error ("xvd_fake_notifyd_name_lost: %s is taken", name);
+}
+
+
+static gpointer
+xvd_fake_notifyd_thread (gpointer data)
+{
+  XvdFakeNotifyd *fake = data;
+  GDBusNodeInfo  *info;
+  GError         *error = NULL;
+  guint           object_id, owner_id;
+
+  g_main_context_push_thread_default (fake->context);
+
+  fake->connection = g_dbus_connection_new_for_address_sync (fake->address,
+                                                             G_DBUS_CONNECTION_FLAGS_AUTHENTICATION_CLIENT
+                                                             | G_DBUS_CONNECTION_FLAGS_MESSAGE_BUS_CONNECTION,
+                                                             NULL, NULL, &error);
+  g_assert_no_error (error);
+
+  info = g_dbus_node_info_new_for_xml (xvd_fake_notifyd_xml, &error);
+  g_assert_no_error (error);
+  object_id = g_dbus_connection_register_object (fake->connection,
+                                                 XVD_FAKE_NOTIFYD_PATH,
+                                                 info->interfaces[0],
+                                                 &xvd_fake_notifyd_vtable,
+                                                 fake, NULL, &error);
+  g_assert_no_error (error);
+  g_dbus_node_info_unref (info);
+
+  owner_id = g_bus_own_name_on_connection (fake->connection,
+                                           XVD_FAKE_NOTIFYD_NAME,
+                                           G_BUS_NAME_OWNER_FLAGS_DO_NOT_QUEUE,
+                                           xvd_fake_notifyd_name_acquired,
+                                           xvd_fake_notifyd_name_lost,
+                                           fake, NULL);
+
+  g_main_loop_run (fake->loop);
+
+  g_bus_unown_name (owner_id);
+  g_dbus_connection_unregister_object (fake->connection, object_id);
+  g_dbus_connection_flush_sync (fake->connection, NULL, NULL);
+  g_dbus_connection_close_sync (fake->connection, NULL, NULL);
+  g_clear_object (&fake->connection);
+
+  /* let the pending replies and the closures go */
+  while (g_main_context_iteration (fake->context, FALSE))
+    ;
+  g_main_context_pop_thread_default (fake->context);
+  return NULL;
+}
+
+
+XvdFakeNotifyd *
+xvd_fake_notifyd_new (const gchar         *address,
+                      const gchar * const *caps)
+{
+  XvdFakeNotifyd *fake = g_new0 (XvdFakeNotifyd, 1);
+
+  fake->address = g_strdup (address);
+  fake->caps = g_strdupv ((gchar **) caps);
+  fake->context = g_main_context_new ();
+  fake->loop = g_main_loop_new (fake->context, FALSE);
+  fake->calls = g_ptr_array_new_with_free_func ((GDestroyNotify) xvd_fake_notification_free);
+  g_mutex_init (&fake->lock);
+  g_cond_init (&fake->cond);
+
+  fake->thread = g_thread_new ("fake-notifyd", xvd_fake_notifyd_thread, fake);
+
+  g_mutex_lock (&fake->lock);
+  while (!fake->ready)
+    g_cond_wait (&fake->cond, &fake->lock);
+  g_mutex_unlock (&fake->lock);
+
+  return fake;
+}
+
+
+static gboolean
+xvd_fake_notifyd_quit (gpointer data)
+{
+  g_main_loop_quit (data);
+  return G_SOURCE_REMOVE;
+}
+
+
+void
+xvd_fake_notifyd_free (XvdFakeNotifyd *fake)
+{
+  if (!fake)
+    return;
+
+  g_main_context_invoke (fake->context, xvd_fake_notifyd_quit, fake->loop);
+  g_thread_join (fake->thread);
+
+  g_ptr_array_unref (fake->calls);
+  g_main_loop_unref (fake->loop);
+  g_main_context_unref (fake->context);
+  g_mutex_clear (&fake->lock);
+  g_cond_clear (&fake->cond);
+  g_strfreev (fake->caps);
+  g_free (fake->address);
+  g_free (fake);
+}
+
+
+void
+xvd_fake_notifyd_set_delay (XvdFakeNotifyd *fake,
+                            guint           delay_ms)
+{
+  g_mutex_lock (&fake->lock);
+  fake->delay_ms = delay_ms;
+  g_mutex_unlock (&fake->lock);
+}
+
+
+guint
+xvd_fake_notifyd_count (XvdFakeNotifyd *fake)
+{
+  guint count;
+
+  g_mutex_lock (&fake->lock);
+  count = fake->calls->len;
+  g_mutex_unlock (&fake->lock);
+  return count;
+}
+
+
+XvdFakeNotification *
+xvd_fake_notifyd_get (XvdFakeNotifyd *fake,
+                      guint           n)
+{
+  XvdFakeNotification *notification = NULL;
+
+  g_mutex_lock (&fake->lock);
+  if (n < fake->calls->len)
+    notification = xvd_fake_notification_copy (g_ptr_array_index (fake->calls, n));
+  g_mutex_unlock (&fake->lock);
+  return notification;
+}
+
+
+void
+xvd_fake_notifyd_reset (XvdFakeNotifyd *fake)
+{
+  g_mutex_lock (&fake->lock);
+  g_ptr_array_set_size (fake->calls, 0);
+  g_mutex_unlock (&fake->lock);
+}
+
+
+void
+xvd_fake_notifyd_close (XvdFakeNotifyd *fake,
+                        guint32         id)
+{
+  /* 1: the notification expired */
+  g_dbus_connection_emit_signal (fake->connection, NULL, XVD_FAKE_NOTIFYD_PATH,
+                                 XVD_FAKE_NOTIFYD_NAME, "NotificationClosed",
+                                 g_variant_new ("(uu)", id, 1), NULL);
+  g_dbus_connection_flush_sync (fake->connection, NULL, NULL);
+}
@@ -0,0 +1,96 @@
+/*
+ *  xfce4-volumed-pulse - Volume management daemon for XFCE 4 (Pulseaudio variant)
+ *
+ *  Copyright © 2026 The Xfce Development Team
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _XVD_FAKE_NOTIFYD_H
+#define _XVD_FAKE_NOTIFYD_H
+
+#include <gio/gio.h>
+
+
+/**
+ * An org.freedesktop.Notifications server recording what it is sent. It
+ * runs in a thread of its own, with its own connection, since libnotify
+ * blocks the caller until the server answers.
+ */
+typedef struct _XvdFakeNotifyd XvdFakeNotifyd;
+
+/**
+ * A Notify call, as the server saw it.
+ */
+typedef struct
+{
+  gint64    time;         /* monotonic, when the call came in */
+  guint32   id;           /* the id answered */
+  guint32   replaces_id;
+  gchar    *summary;
+  gchar    *icon;
+  GVariant *hints;        /* a{sv} */
+} XvdFakeNotification;
+
+
+/**
+ * Starts a server answering @caps to GetCapabilities on the bus at
+ * @address, returns once it owns the name.
+ */
+XvdFakeNotifyd      *xvd_fake_notifyd_new          (const gchar         *address,
+                                                    const gchar * const *caps);
+
+/**
+ * Releases the name and stops the server.
+ */
+void                 xvd_fake_notifyd_free         (XvdFakeNotifyd      *fake);
+
+/**
+ * Delays the answers to Notify by @delay_ms, like a busy server.
+ */
+void                 xvd_fake_notifyd_set_delay    (XvdFakeNotifyd      *fake,
+                                                    guint                delay_ms);
+
+/**
+ * Returns the number of Notify calls so far.
+ */
+guint                xvd_fake_notifyd_count        (XvdFakeNotifyd      *fake);
+
+/**
+ * Returns a copy of the @n-th Notify call, free it with
+ * xvd_fake_notification_free().
+ */
+XvdFakeNotification *xvd_fake_notifyd_get          (XvdFakeNotifyd      *fake,
+                                                    guint                n);
+
+/**
+ * Forgets the calls so far.
+ */
+void                 xvd_fake_notifyd_reset        (XvdFakeNotifyd      *fake);
+
+/**
+ * Emits NotificationClosed for @id, as when the popup times out.
+ */
+void                 xvd_fake_notifyd_close        (XvdFakeNotifyd      *fake,
+                                                    guint32              id);
+
+/**
+ * Returns the hint @name of @notification, or NULL.
+ */
+GVariant            *xvd_fake_notification_hint    (XvdFakeNotification *notification,
+                                                    const gchar         *name);
+
+void                 xvd_fake_notification_free    (XvdFakeNotification *notification);
+
+#endif
@@ -0,0 +1,228 @@
+/*
+ *  xfce4-volumed-pulse - Volume management daemon for XFCE 4 (Pulseaudio variant)
+ *
+ *  Copyright © 2026 The Xfce Development Team
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+
+#include <glib/gstdio.h>
+
+#include "xvd_instance.h"
+#include "xvd_notify.h"
+#include "xvd_pulse.h"
+#include "xvd_record.h"
+#include "xvd_stats.h"
+#include "xvd_work.h"
+
+#include "xvd-test-util.h"
+
+
+XvdInstance *
+xvd_test_instance_new (const gchar    *appname,
+                       XvdFakeNotifyd *server)
+{
+  XvdInstance *i = g_new0 (XvdInstance, 1);
+
+  xvd_instance_init (i);
+  i->loop = g_main_loop_new (NULL, FALSE);
+  xvd_notify_init (i, appname);
+
+  while (server && !i->notify_caps_known)
+    g_main_context_iteration (NULL, TRUE);
+
+  return i;
+}
+
+
+void
+xvd_test_instance_free (XvdInstance *i)
+{
+  xvd_work_cancel_all (i);
+  xvd_notify_uninit (i);
+  g_main_loop_unref (i->loop);
+  g_free (i);
+}
+
+
+void
+xvd_test_notify_volume (XvdInstance *i)
+{
+  xvd_notify_volume_notification (i);
+}
+
+
+static gint
+compare_gint64 (gconstpointer a,
+                gconstpointer b)
+{
+  gint64 x = *(const gint64 *) a, y = *(const gint64 *) b;
+
+  return (x > y) - (x < y);
+}
+
+
+gint64
+xvd_test_report (const gchar *what,
+                 gint64      *times,
+                 guint        n)
+{
+  qsort (times, n, sizeof (gint64), compare_gint64);
+  g_print ("%-36s median %6" G_GINT64_FORMAT " us, p95 %6" G_GINT64_FORMAT " us\n",
+           what, times[n / 2], times[n * 95 / 100]);
+
+  return times[n * 95 / 100];
+}
+
+
+gboolean
+xvd_test_have_pulse (void)
+{
+  pa_mainloop       *loop = pa_mainloop_new ();
+  pa_context        *context;
+  pa_context_state_t state = PA_CONTEXT_UNCONNECTED;
+
+  context = pa_context_new (pa_mainloop_get_api (loop), g_get_prgname ());
+  if (pa_context_connect (context, NULL, PA_CONTEXT_NOAUTOSPAWN, NULL) >= 0)
+    do
+      {
+        if (pa_mainloop_iterate (loop, TRUE, NULL) < 0)
+          break;
+        state = pa_context_get_state (context);
+      }
+    while (PA_CONTEXT_IS_GOOD (state) && state != PA_CONTEXT_READY);
+
+  pa_context_disconnect (context);
+  pa_context_unref (context);
+  pa_mainloop_free (loop);
+
+  return state == PA_CONTEXT_READY;
+}
+
+
+gchar *
+xvd_test_recording_new (const gchar *prefix,
+                        guint32      default_sink,
+                        guint32      default_source)
+{
+  gchar *template = g_strconcat (prefix, "-XXXXXX", NULL);
+  gchar *path = g_build_filename (g_get_tmp_dir (), template, NULL);
+
+  g_free (template);
+  g_close (g_mkstemp (path), NULL);
+
+  g_assert_true (xvd_record_start (path));
+  xvd_record_default_sink (default_sink);
+  xvd_record_default_source (default_source);
+
+  return path;
+}
+
+
+static void
+xvd_test_set_percent (pa_cvolume *volume,
+                      guint       left,
+                      guint       right)
+{
+  pa_cvolume_init (volume);
+  volume->channels = 2;
+  volume->values[0] = (pa_volume_t) ((guint64) PA_VOLUME_NORM * left / 100);
+  volume->values[1] = (pa_volume_t) ((guint64) PA_VOLUME_NORM * right / 100);
+}
+
+
+void
+xvd_test_record_sink (guint32      index,
+                      const gchar *name,
+                      guint        left,
+                      guint        right,
+                      gboolean     mute,
+                      pa_proplist *props)
+{
+  pa_sink_info  info = { 0 };
+  pa_proplist  *empty = NULL;
+  gchar        *monitor = g_strconcat (name, ".monitor", NULL);
+
+  if (!props)
+    props = empty = pa_proplist_new ();
+
+  info.index = index;
+  info.name = name;
+  info.description = name;
+  xvd_test_set_percent (&info.volume, left, right);
+  info.mute = mute;
+  info.monitor_source_name = monitor;
+  info.card = PA_INVALID_INDEX;
+  info.proplist = props;
+  xvd_record_sink (&info);
+
+  g_free (monitor);
+  if (empty)
+    pa_proplist_free (empty);
+}
+
+
+void
+xvd_test_record_source (guint32      index,
+                        const gchar *name,
+                        gboolean     mute,
+                        guint32      monitor_of_sink)
+{
+  pa_source_info info = { 0 };
+
+  info.index = index;
+  info.name = name;
+  info.mute = mute;
+  info.monitor_of_sink = monitor_of_sink;
+  xvd_record_source (&info);
+}
+
+
+void
+xvd_test_record_stream (guint32      index,
+                        guint        percent,
+                        pa_proplist *props)
+{
+  pa_sink_input_info info = { 0 };
+
+  info.index = index;
+  info.name = "playback";
+  info.proplist = props;
+  xvd_test_set_percent (&info.volume, percent, percent);
+  info.has_volume = TRUE;
+  info.volume_writable = TRUE;
+  xvd_record_sink_input (&info);
+}
+
+
+void
+xvd_test_recording_free (gchar *path)
+{
+  g_unlink (path);
+  g_free (path);
+}
+
+
+void
+xvd_test_replay (XvdInstance *i,
+                 const gchar *path)
+{
+  g_assert_true (xvd_replay_start (i, path, FALSE));
+  g_assert_true (xvd_open_pulse (i));
+
+  while (i->sink_index == PA_INVALID_INDEX)
+    g_main_context_iteration (NULL, TRUE);
+}
@@ -0,0 +1,109 @@
+/*
+ *  xfce4-volumed-pulse - Volume management daemon for XFCE 4 (Pulseaudio variant)
+ *
+ *  Copyright © 2026 The Xfce Development Team
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _XVD_TEST_UTIL_H
+#define _XVD_TEST_UTIL_H
+
+#include <pulse/pulseaudio.h>
+
+#include "xvd_data_types.h"
+
+#include "xvd-fake-notifyd.h"
+
+
+/**
+ * Returns an instance as the daemon starts it, with a main loop and the
+ * notifications of @appname. With a @server, returns once it told its
+ * capabilities.
+ */
+XvdInstance *xvd_test_instance_new     (const gchar    *appname,
+                                        XvdFakeNotifyd *server);
+
+/**
+ * Drops the jobs left and frees @i.
+ */
+void         xvd_test_instance_free    (XvdInstance    *i);
+
+/**
+ * A job showing the volume popup, for xvd_work_queue().
+ */
+void         xvd_test_notify_volume    (XvdInstance    *i);
+
+/**
+ * Sorts @times and prints their median and 95th percentile, in
+ * microseconds. Returns the 95th percentile.
+ */
+gint64       xvd_test_report           (const gchar    *what,
+                                        gint64         *times,
+                                        guint           n);
+
+/**
+ * Returns whether a PulseAudio server answers, without starting one.
+ */
+gboolean     xvd_test_have_pulse       (void);
+
+/**
+ * Starts a recording in a new temporary file named after @prefix, with
+ * the given defaults, PA_INVALID_INDEX for none. Returns its path, to be
+ * freed with xvd_test_recording_free() once xvd_record_stop() wrote it.
+ */
+gchar       *xvd_test_recording_new    (const gchar    *prefix,
+                                        guint32         default_sink,
+                                        guint32         default_source);
+
+/**
+ * Records a sink @name at @left and @right percent, with its monitor.
+ * @props may be NULL.
+ */
+void         xvd_test_record_sink      (guint32         index,
+                                        const gchar    *name,
+                                        guint           left,
+                                        guint           right,
+                                        gboolean        mute,
+                                        pa_proplist    *props);
+
+/**
+ * Records a source @name, the monitor of @monitor_of_sink unless that is
+ * PA_INVALID_INDEX.
+ */
+void         xvd_test_record_source    (guint32         index,
+                                        const gchar    *name,
+                                        gboolean        mute,
+                                        guint32         monitor_of_sink);
+
+/**
+ * Records a stream of the application in @props, at @percent.
+ */
+void         xvd_test_record_stream    (guint32         index,
+                                        guint           percent,
+                                        pa_proplist    *props);
+
+/**
+ * Removes the recording and frees @path.
+ */
+void         xvd_test_recording_free   (gchar          *path);
+
+/**
+ * Connects @i to the server recorded in @path, returns once it has a
+ * default sink.
+ */
+void         xvd_test_replay           (XvdInstance    *i,
+                                        const gchar    *path);
+
+#endif